@@ -0,0 +1,279 @@
+#include "aot.h"
+#include "basic_block.h"
+#include "cpu_ppc.h"
+#include <dlfcn.h>
+#include <set>
+
+// Compiler & flags for generated code. They have to match the ones simulator was built with
+// ( see build/Makefile ), otherwise generated code sees a different cpu layout.
+#ifndef CONFIG_AOT_CXX
+#define CONFIG_AOT_CXX          "g++"
+#endif
+#ifndef CONFIG_AOT_CXXFLAGS
+#define CONFIG_AOT_CXXFLAGS     "-std=c++0x -O2 -I."
+#endif
+
+namespace {
+    // Direct branch target of a branch instr ( b & bc forms ).
+    // Returns false if insn is not a direct branch.
+    bool aot_branch_target(uint32_t insn, uint64_t ip, uint64_t& target){
+        int64_t disp;
+
+        switch(insn >> 26){
+            case 18 : disp = static_cast<int32_t>((insn & 0x03fffffcUL) << 6) >> 6;    break;   // b[l][a]
+            case 16 : disp = static_cast<int16_t>(insn & 0xfffcUL);                    break;   // bc[l][a]
+            default : return false;
+        }
+        target = (insn & 0x2) ? static_cast<uint64_t>(disp) : ip + disp;
+        return true;
+    }
+
+    // Quote a string as a single word for /bin/sh ( std::system() )
+    std::string aot_shell_quote(const std::string& str){
+        std::string q = "'";
+        for(size_t i=0; i<str.size(); i++){
+            q += (str[i] == '\'') ? std::string("'\\''") : std::string(1, str[i]);
+        }
+        return q + "'";
+    }
+
+    // Generated code calls back into simulator ( cpu, tlb & memory modules ). If simulator itself is
+    // a shared object loaded with local symbols ( python extension ), make them global first.
+    // NOTE : Executables need to be linked with -rdynamic.
+    void aot_export_host_symbols(){
+        static bool done = false;
+        Dl_info     info;
+
+        if(done){ return; }
+        if(dladdr(reinterpret_cast<void*>(&aot_export_host_symbols), &info) && info.dli_fname){
+            dlopen(info.dli_fname, RTLD_NOW | RTLD_NOLOAD | RTLD_GLOBAL);
+        }
+        done = true;
+    }
+}
+
+//////////////////////////////////////////////////////////////////////////////////////
+// ahead of time translator
+//////////////////////////////////////////////////////////////////////////////////////
+
+size_t ppcsimbooke::ppcsimbooke_aot::aot_translator::translate(ppcsimbooke::ppcsimbooke_aot::context& ctx, std::string sofile,
+        std::string cxx, std::string cxxflags){
+    LOG_DEBUG4(MSG_FUNC_START);
+    using namespace ppcsimbooke::ppcsimbooke_basic_block;
+
+    LASSERT_THROW_UNLIKELY(ctx.m_mem_ptr != NULL, sim_except_fatal("no memory module registered."), DEBUG4);
+
+    const std::vector<std::pair<uint64_t, uint64_t> >& secs = ctx.m_mem_ptr->code_sections();
+    LASSERT_THROW_UNLIKELY(!secs.empty(), sim_except(SIM_EXCEPT_EINVAL, "No executable sections loaded."), DEBUG4);
+
+    std::string   srcfile = sofile + ".cpp";
+    std::ofstream src(srcfile.c_str());
+    LASSERT_THROW_UNLIKELY(src.is_open(), sim_except(SIM_EXCEPT_ENOFILE, "Couldn't create " + srcfile), DEBUG4);
+
+    src << "// Generated by ppcsimbooke ahead of time translator. Don't edit." << std::endl;
+    src << "#include \"aot_rtl.h\"" << std::endl << std::endl;
+
+    // Seed with all known code addresses
+    std::vector<uint64_t>  work(ctx.m_mem_ptr->code_entries());
+    std::set<uint64_t>     seen;
+    std::ostringstream     tbl;                        // block table
+    uint8_t                buff[MAX_BB_INS_BYTES];
+    uint64_t               mask    = ctx.get_pc_mask();
+    size_t                 nblocks = 0;
+
+    for(size_t i=0; i<secs.size(); i++){ work.push_back(secs[i].first); }
+
+    while(!work.empty()){
+        uint64_t ip = work.back() & mask;
+        work.pop_back();
+
+        if((ip & (OPCODE_SIZE-1)) || !seen.insert(ip).second){ continue; }
+
+        // Only decode what's inside an executable section
+        size_t nbytes = 0;
+        for(size_t i=0; i<secs.size(); i++){
+            if(ip >= secs[i].first && ip < (secs[i].first + secs[i].second)){
+                nbytes = min(MAX_BB_INS_BYTES, static_cast<size_t>(secs[i].first + secs[i].second - ip)) & ~(OPCODE_SIZE-1);
+                break;
+            }
+        }
+        if(nbytes == 0){ continue; }
+        ctx.m_mem_ptr->read_to_buffer(ip, buff, nbytes);
+
+        // Endianness of a page is only known at run time ( WIMGE[E] of it's tlb entry ). Code is decoded as
+        // big endian, which is how e500 runs by default. Blocks on little endian pages don't match their
+        // table entry ( see aot_image::find() ) & run on other engines.
+        basic_block_decoder bb_decoder(basic_block_ip(ip, basic_block_ip::MFN_INV, 0, 0, 0, 0, true));
+        bb_decoder.fillbuff(buff, MAX_BB_INS_BYTES, nbytes);
+        // Illegal instrs ( data, padding ) can't start a block. Leave it to the interpreter.
+        try { bb_decoder.decode(); }
+        catch(sim_except_ppc& e){ continue; }
+
+        basic_block& bb = bb_decoder.bb;
+        size_t       n  = bb.transopscount;
+        if(n == 0){ continue; }
+
+        // Follow fall through & direct branch target
+        uint64_t last   = (ip + (n-1)*OPCODE_SIZE) & mask;
+        uint8_t* lastb  = buff + (n-1)*OPCODE_SIZE;
+        uint32_t insn   = (lastb[0] << 24) | (lastb[1] << 16) | (lastb[2] << 8) | lastb[3];
+        uint64_t target;
+
+        work.push_back(ip + n*OPCODE_SIZE);
+        if(aot_branch_target(insn, last, target)){ work.push_back(target); }
+
+        if(!emit_block(src, ctx, nblocks, bb)){
+            LOG_DEBUG4("No RTL for some instr in block at ", bb.bip, ". Skipped.", std::endl);
+            continue;
+        }
+
+        superstl::CRC32 crc;
+        crc.update(buff, n*OPCODE_SIZE);
+        tbl << "    { 0x" << std::hex << ip << "ULL, " << std::dec << n << ", 0x" << std::hex << static_cast<uint32_t>(crc)
+            << "U, " << std::dec << static_cast<uint32_t>(bb.bip.be) << ", aot_blk_" << nblocks << " }," << std::endl;
+        nblocks++;
+    }
+
+    // Block table ( terminated by an empty entry )
+    src << "extern \"C\" const uint64_t " AOT_SYM_ABI " = AOT_ABI();" << std::endl;
+    src << "extern \"C\" const size_t " AOT_SYM_NBLOCKS " = " << nblocks << ";" << std::endl;
+    src << "extern \"C\" const ppcsimbooke::ppcsimbooke_aot::aot_block " AOT_SYM_BLOCKS "[] = {" << std::endl;
+    src << tbl.str();
+    src << "    { 0, 0, 0, 0, NULL }" << std::endl;
+    src << "};" << std::endl;
+    src.close();
+
+    // Build it ( compiler & flags are taken as shell words, file names are quoted )
+    std::string cmd = ((cxx.empty()) ? CONFIG_AOT_CXX : cxx) + " " + ((cxxflags.empty()) ? CONFIG_AOT_CXXFLAGS : cxxflags) +
+                      " -fPIC -shared -o " + aot_shell_quote(sofile) + " " + aot_shell_quote(srcfile);
+    LASSERT_THROW_UNLIKELY(std::system(cmd.c_str()) == 0, sim_except(SIM_EXCEPT_ENOEXEC, "Couldn't build " + sofile + " ( " + cmd + " )"), DEBUG4);
+
+    std::cout << "Translated " << std::dec << nblocks << " basic blocks into " << sofile << std::endl;
+
+    LOG_DEBUG4(MSG_FUNC_END);
+    return nblocks;
+}
+
+// Emit a block as a C++ function. Operands of all instrs go into a constant table, so they are
+// known to host compiler.
+bool ppcsimbooke::ppcsimbooke_aot::aot_translator::emit_block(std::ostream& ostr, ppcsimbooke::ppcsimbooke_aot::context& ctx, size_t n,
+        const ppcsimbooke::ppcsimbooke_basic_block::basic_block& bb){
+    LOG_DEBUG4(MSG_FUNC_START);
+
+    std::ostringstream  ics;
+    std::ostringstream  body;
+    uint64_t            mask = ctx.get_pc_mask();
+
+    for(size_t i=0; i<bb.transopscount; i++){
+        const instr_call& ic   = bb.transops[i];
+        uint64_t          indx = ic.hv & 0xffffffffULL;
+        uint64_t          ip   = (bb.bip.ip + i*ppcsimbooke::ppcsimbooke_basic_block::OPCODE_SIZE) & mask;
+
+        if(indx >= ppcsimbooke::ppcsimbooke_cpu::cpu::sm_ppc_func_names.size() ||
+           ppcsimbooke::ppcsimbooke_cpu::cpu::sm_ppc_func_names[indx] == NULL){
+            LOG_DEBUG4(MSG_FUNC_END);
+            return false;
+        }
+
+        ics << "        {{ ";
+        for(int j=0; j<N_IC_ARGS; j++){
+            ics << "{0x" << std::hex << ic.arg[j].v << "ULL}" << ((j < (N_IC_ARGS-1)) ? ", " : " ");
+        }
+        ics << "}},    // " << ic.opcname << std::endl;
+
+        if(i == (bb.transopscount-1)){
+            body << "        AOT_SYNC(0x" << std::hex << ip << "ULL)" << std::endl;
+        }
+        body << "        AOT_INSTR(" << std::dec << i << ", 0x" << std::hex << ip << "ULL, "
+             << ppcsimbooke::ppcsimbooke_cpu::cpu::sm_ppc_func_names[indx] << ")" << std::endl;
+    }
+
+    ostr << "// " << bb.bip << std::endl;
+    ostr << "AOT_BLOCK_BEGIN(aot_blk_" << std::dec << n << ")" << std::endl;
+    ostr << "    static const ppcsimbooke::ppcsimbooke_aot::aot_ic ic[" << std::dec << bb.transopscount << "] = {" << std::endl;
+    ostr << ics.str();
+    ostr << "    };" << std::endl;
+    ostr << body.str();
+    ostr << "AOT_BLOCK_END" << std::endl << std::endl;
+
+    LOG_DEBUG4(MSG_FUNC_END);
+    return true;
+}
+
+//////////////////////////////////////////////////////////////////////////////////////
+// translated image
+//////////////////////////////////////////////////////////////////////////////////////
+
+void ppcsimbooke::ppcsimbooke_aot::aot_image::load(std::string sofile){
+    LOG_DEBUG4(MSG_FUNC_START);
+
+    unload();
+    aot_export_host_symbols();
+
+    // dlopen() searches library paths for a bare file name, but sofile is a path ( like in translate() )
+    std::string path   = (sofile.find('/') == std::string::npos) ? "./" + sofile : sofile;
+    void*       handle = dlopen(path.c_str(), RTLD_NOW | RTLD_LOCAL);
+    if unlikely(handle == NULL){
+        const char* err = dlerror();
+        LTHROW(sim_except(SIM_EXCEPT_ENOFILE, "Couldn't load " + sofile + " : " + ((err) ? err : "")), DEBUG4);
+    }
+
+    const uint64_t*  abi     = static_cast<const uint64_t*>(dlsym(handle, AOT_SYM_ABI));
+    const size_t*    nblocks = static_cast<const size_t*>(dlsym(handle, AOT_SYM_NBLOCKS));
+    const aot_block* blocks  = static_cast<const aot_block*>(dlsym(handle, AOT_SYM_BLOCKS));
+
+    if unlikely(abi == NULL || nblocks == NULL || blocks == NULL || *abi != AOT_ABI()){
+        dlclose(handle);
+        LTHROW(sim_except(SIM_EXCEPT_ENOEXEC, sofile + " is not a translated image for this simulator build"), DEBUG4);
+    }
+
+    m_handle = handle;
+    for(size_t i=0; i<*nblocks; i++){
+        m_blocks[blocks[i].ip] = &blocks[i];
+    }
+
+    LOG_DEBUG4("Loaded ", m_blocks.size(), " translated blocks from ", sofile, std::endl);
+    LOG_DEBUG4(MSG_FUNC_END);
+}
+
+// NOTE : Caller has to drop all blocks using code of this image first.
+void ppcsimbooke::ppcsimbooke_aot::aot_image::unload(){
+    LOG_DEBUG4(MSG_FUNC_START);
+
+    m_blocks.clear();
+    if(m_handle){
+        dlclose(m_handle);
+        m_handle = NULL;
+    }
+
+    LOG_DEBUG4(MSG_FUNC_END);
+}
+
+ppcsimbooke::ppcsimbooke_aot::aot_block_func_t
+ppcsimbooke::ppcsimbooke_aot::aot_image::find(const ppcsimbooke::ppcsimbooke_basic_block::basic_block& bb, const uint8_t* bytes) const {
+    LOG_DEBUG4(MSG_FUNC_START);
+
+    std::unordered_map<uint64_t, const aot_block*>::const_iterator it = m_blocks.find(bb.bip.ip);
+    if(it == m_blocks.end()){
+        LOG_DEBUG4(MSG_FUNC_END);
+        return NULL;
+    }
+
+    // Same instrs ?
+    const aot_block* blk = it->second;
+    if(blk->ninstrs != bb.transopscount || blk->be != static_cast<uint32_t>(bb.bip.be)){
+        LOG_DEBUG4(MSG_FUNC_END);
+        return NULL;
+    }
+
+    superstl::CRC32 crc;
+    crc.update(const_cast<uint8_t*>(bytes), blk->ninstrs*ppcsimbooke::ppcsimbooke_basic_block::OPCODE_SIZE);
+    if(static_cast<uint32_t>(crc) != blk->crc){
+        LOG_DEBUG4("Code at ", bb.bip, " was modified. Not using translated block.", std::endl);
+        LOG_DEBUG4(MSG_FUNC_END);
+        return NULL;
+    }
+
+    LOG_DEBUG4(MSG_FUNC_END);
+    return blk->func;
+}
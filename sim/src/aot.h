@@ -0,0 +1,107 @@
+#ifndef AOT_H_
+#define AOT_H_
+
+#include "config.h"
+#include "globals.h"
+
+namespace ppcsimbooke {
+    // forward declarations
+    namespace ppcsimbooke_cpu {
+        class cpu;
+    }
+    namespace ppcsimbooke_basic_block {
+        struct basic_block;
+    }
+
+    namespace ppcsimbooke_aot {
+
+        typedef ppcsimbooke_cpu::cpu context;
+
+        // native code for a basic block ( generated ahead of time ).
+        // Returns 0 on success & non zero if a guest exception was raised ( see cpu::exception_pending() ).
+        // C++ exceptions pass through. PC/NIP point to faulting instruction in both cases.
+        typedef int (*aot_block_func_t)(context *pcpu);
+
+        // Bumped whenever layout of generated images changes. Images also record sizeof(cpu), so they
+        // have to be rebuilt along with the simulator.
+        static const uint32_t AOT_ABI_VERSION = 2;
+        #define AOT_ABI()  ((static_cast<uint64_t>(ppcsimbooke::ppcsimbooke_aot::AOT_ABI_VERSION) << 32) | \
+                            sizeof(ppcsimbooke::ppcsimbooke_cpu::cpu))
+
+        // symbols exported by an image
+        #define AOT_SYM_ABI       "ppcsimbooke_aot_abi"
+        #define AOT_SYM_NBLOCKS   "ppcsimbooke_aot_nblocks"
+        #define AOT_SYM_BLOCKS    "ppcsimbooke_aot_blocks"
+
+        // Operands of a translated instr ( IC in RTL ). They are constants in generated code, so host
+        // compiler can fold them into RTL bodies.
+        struct aot_ic {
+            instr_call::instr_arg  arg[N_IC_ARGS];
+        };
+
+        // Block table entry of an image.
+        // A block is used only if the one decoded at run time starts at ip & has exactly the same
+        // instrs ( count, bytes & endianness ). Anything else ( unknown or modified code ) runs on
+        // the interpreter.
+        struct aot_block {
+            uint64_t               ip;                // address of first instr
+            uint32_t               ninstrs;           // no of instrs
+            uint32_t               crc;               // CRC32 of instr bytes
+            uint32_t               be;                // decoded as big endian
+            aot_block_func_t       func;
+        };
+
+        // RTL bodies of cpu_ppc_instr.cc as static functions ( defined by generated code, see aot_rtl.h )
+        struct aot_rtl;
+
+        //////////////////////////////////////////////////////////////////////////////////
+        // ahead of time translator
+        //////////////////////////////////////////////////////////////////////////////////
+        //
+        // Walks executable sections of the elf file loaded by memory::load_elf(), starting from entry
+        // point, function symbols & start of each section. Every block is decoded by basic_block_decoder
+        // ( so it's exactly what run time decoding gives, block IR passes included ), it's fall through &
+        // direct branch target are followed. Each block becomes a C++ function calling RTL of it's instrs,
+        // which is built into a shared object by host compiler.
+        //
+        // NOTE : Code is looked up by effective address of instrs. Sections are assumed to be
+        //        mapped 1:1, blocks which are not are just never used.
+        class aot_translator {
+            public:
+            // translate code loaded in ctx's memory into sofile ( C++ source is kept as sofile.cpp ).
+            // cxx/cxxflags default to compiler & flags simulator was built with.
+            // Returns no of blocks translated.
+            static size_t  translate(context& ctx, std::string sofile, std::string cxx = "", std::string cxxflags = "");
+
+            private:
+            // emit n'th block as function aot_blk_<n>. Returns false if some instr has no RTL.
+            static bool    emit_block(std::ostream& ostr, context& ctx, size_t n, const ppcsimbooke_basic_block::basic_block& bb);
+        };
+
+        //////////////////////////////////////////////////////////////////////////////////
+        // translated image
+        //////////////////////////////////////////////////////////////////////////////////
+        class aot_image {
+            public:
+            aot_image() : m_handle(NULL) {}
+            ~aot_image() { unload(); }
+
+            void              load(std::string sofile);
+            void              unload();
+            bool              loaded() const  { return m_handle != NULL; }
+            size_t            nblocks() const { return m_blocks.size();  }
+
+            // native code for a block decoded at run time ( NULL if there is none )
+            aot_block_func_t  find(const ppcsimbooke_basic_block::basic_block& bb, const uint8_t* bytes) const;
+
+            private:
+            aot_image(const aot_image&);
+            aot_image& operator=(const aot_image&);
+
+            void*                                           m_handle;       // dlopen() handle
+            std::unordered_map<uint64_t, const aot_block*>  m_blocks;       // blocks hashed by ip
+        };
+    }
+}
+
+#endif
@@ -0,0 +1,73 @@
+#ifndef AOT_RTL_H_
+#define AOT_RTL_H_
+
+// Included only by code generated by ahead of time translator ( see aot.h ).
+//
+// RTL bodies from cpu_ppc_instr.cc are expanded a third time, as static functions of aot_rtl
+// ( which is cpu's friend ). Each one returns non zero if it's instr raised a guest exception.
+// A translated block calls RTL of it's instrs one after another with constant operands, so host
+// compiler can inline & specialize each of them.
+//
+// PC/NIP bookkeeping is same as in direct threaded engine. PC/NIP are set up only for last instr
+// of a block & restored for an instr which raised an exception ( guest or C++ ).
+
+#include "cpu_ppc.h"
+#include "aot.h"
+
+namespace ppcsimbooke {
+    namespace ppcsimbooke_aot {
+
+        struct aot_rtl {
+#define RTL_BEGIN(opc_name, func_name)     static inline int func_name(ppcsimbooke::ppcsimbooke_cpu::cpu *pcpu,      \
+                                                                       const ppcsimbooke::ppcsimbooke_aot::aot_ic *ic) { {
+#define RTL_END                            } return 0; }
+#define RTL_EXCEPT_EXIT()                  return 1
+
+#include "cpu_ppc_instr.cc"
+
+#undef RTL_BEGIN
+#undef RTL_END
+#undef RTL_EXCEPT_EXIT
+
+            // set PC/NIP for last instruction of a block
+            static inline void sync(ppcsimbooke::ppcsimbooke_cpu::cpu *pcpu, uint64_t ip){
+                pcpu->m_cpu_regs.pc  = ip;
+                pcpu->m_cpu_regs.nip = ip + 4;
+            }
+
+            // block completed
+            static inline int done(ppcsimbooke::ppcsimbooke_cpu::cpu *pcpu){
+                pcpu->m_cpu_regs.pc  = pcpu->m_cpu_regs.nip;
+                return 0;
+            }
+
+            // instr at ip raised a guest exception. Restore precise PC/NIP & leave.
+            static inline int except(ppcsimbooke::ppcsimbooke_cpu::cpu *pcpu, uint64_t ip){
+                sync(pcpu, ip);
+                return 1;
+            }
+        };
+
+    }
+}
+
+// Building blocks of generated code.
+// ic[] is the operand table of current block & __ip the address of instr being run.
+#define AOT_BLOCK_BEGIN(name)              static int name(ppcsimbooke::ppcsimbooke_cpu::cpu *pcpu) {                 \
+                                               using ppcsimbooke::ppcsimbooke_aot::aot_rtl;                            \
+                                               uint64_t __ip = 0;                                                      \
+                                               try {
+#define AOT_INSTR(n, ip, func_name)                __ip = ip;                                                          \
+                                                   if unlikely(aot_rtl::func_name(pcpu, &ic[n])){                      \
+                                                       return aot_rtl::except(pcpu, ip);                               \
+                                                   }
+#define AOT_SYNC(ip)                               aot_rtl::sync(pcpu, ip);
+#define AOT_BLOCK_END                              return aot_rtl::done(pcpu);                                         \
+                                               }                                                                       \
+                                               catch(...){                                                             \
+                                                   aot_rtl::sync(pcpu, __ip);                                          \
+                                                   throw;                                                              \
+                                               }                                                                       \
+                                           }
+
+#endif
@@ -1,7 +1,11 @@
 #include "basic_block.h"
+#include "basic_block_ir.h"
 #include "cpu_ppc.h"
 #include <algorithm>
 
+// labels of direct threaded engine ( filled in by ppcsimbooke_cpu::run_threaded_ops() )
+ppcsimbooke::ppcsimbooke_basic_block::threaded_labels ppcsimbooke::ppcsimbooke_basic_block::threaded_lbls;
+
 /////////////////////////////////////////////////////////////////////////////////
 // basic block instruction pointer
 /////////////////////////////////////////////////////////////////////////////////
@@ -86,10 +90,24 @@ void ppcsimbooke::ppcsimbooke_basic_block::basic_block::reset(){
     transopscount = 0;
     brtype = BB_BRTYPE_INV;
     synthops = NULL;
+    threadops = NULL;
+    jitcode = NULL;
+    jitsize = 0;
+    aotcode = NULL;
     refcount = 0;
     hitcount = 0;
     lastused = 0;
     lasttarget = 0;
+    next_taken = NULL;
+    next_not_taken = NULL;
+    chain_gen = 0;
+    taken_count = 0;
+    not_taken_count = 0;
+    trace = NULL;
+    tier = BB_TIER_INTERPRETIVE;
+    tier_hits = 0;
+    side_effect_free = false;
+    exits = 0;
 
     LOG_DEBUG4(MSG_FUNC_END);
 }
@@ -136,6 +154,9 @@ ppcsimbooke::ppcsimbooke_basic_block::basic_block::~basic_block(){
 
     // freeup synthops memory
     if likely(synthops) delete[] synthops;
+    if likely(threadops) delete[] threadops;
+    if unlikely(trace) delete trace;
+    if unlikely(jitcode) ppcsimbooke::ppcsimbooke_jit::x86_64_jit::free_code(jitcode, jitsize);
 
     LOG_DEBUG4(MSG_FUNC_END);
 }
@@ -147,6 +168,10 @@ ppcsimbooke::ppcsimbooke_basic_block::basic_block* ppcsimbooke::ppcsimbooke_basi
     *bb_new = *this;   // make a copy
 
     bb_new->hashlink.reset();
+    bb_new->threadops = NULL;   // threaded code points into our own transops, so it can't be shared
+    bb_new->trace     = NULL;
+    bb_new->jitcode   = NULL;   // so does native code
+    bb_new->jitsize   = 0;
     bb_new->use(0);
 
     LOG_DEBUG4(MSG_FUNC_END);
@@ -158,6 +183,13 @@ void ppcsimbooke::ppcsimbooke_basic_block::basic_block::free(){
     LOG_DEBUG4(MSG_FUNC_START);
 
     if likely(synthops) delete[] synthops;
+    if likely(threadops) delete[] threadops;
+    if unlikely(trace) delete trace;
+    if unlikely(jitcode) ppcsimbooke::ppcsimbooke_jit::x86_64_jit::free_code(jitcode, jitsize);
+    synthops  = NULL;
+    threadops = NULL;
+    trace     = NULL;
+    jitcode   = NULL;
     delete this;    // commit suicide
 
     LOG_DEBUG4(MSG_FUNC_END);
@@ -167,8 +199,8 @@ void ppcsimbooke::ppcsimbooke_basic_block::basic_block::free(){
 void ppcsimbooke::ppcsimbooke_basic_block::basic_block::run(ppcsimbooke::ppcsimbooke_basic_block::context& ctx){
     LOG_DEBUG4(MSG_FUNC_START);
 
-    // increment reference count
-    refcount++;
+    // hold a reference while running
+    basic_block_ref ref(this);
 
     // initialize synthops if it's NULL
     if unlikely(synthops == NULL){
@@ -178,6 +210,11 @@ void ppcsimbooke::ppcsimbooke_basic_block::basic_block::run(ppcsimbooke::ppcsimb
     // Start executing all synthops
     for(size_t i=0; i<transopscount; i++){
         synthops[i](&ctx, &transops[i]);
+        // Leave at faulting instruction. Caller delivers the exception.
+        if unlikely(ctx.exception_pending()){
+            LOG_DEBUG4(MSG_FUNC_END);
+            return;
+        }
     }
 
     // update next ip's
@@ -186,8 +223,83 @@ void ppcsimbooke::ppcsimbooke_basic_block::basic_block::run(ppcsimbooke::ppcsimb
     // increment hitcount
     hitcount++;
 
-    // Decrement ref count 
-    refcount--;
+    LOG_DEBUG4(MSG_FUNC_END);
+}
+
+// Run this basic block using direct threaded engine.
+// Handler to handler transitions are single indirect jumps and PC/NIP are updated only
+// once per block ( see ppcsimbooke_cpu::run_threaded_ops() ).
+void ppcsimbooke::ppcsimbooke_basic_block::basic_block::run_direct_threaded(ppcsimbooke::ppcsimbooke_basic_block::context& ctx){
+    LOG_DEBUG4(MSG_FUNC_START);
+
+    if unlikely(transopscount == 0){
+        LOG_DEBUG4(MSG_FUNC_END);
+        return;
+    }
+
+    basic_block_ref ref(this);
+
+    // initialize threaded code if it's NULL
+    if unlikely(threadops == NULL){
+        init_threadops(ctx);
+    }
+
+    ppcsimbooke::ppcsimbooke_cpu::run_threaded_ops(&ctx, threadops);
+    if unlikely(ctx.exception_pending()){
+        LOG_DEBUG4(MSG_FUNC_END);
+        return;
+    }
+
+    update_targets(ctx);
+    hitcount++;
+
+    LOG_DEBUG4(MSG_FUNC_END);
+}
+
+// Run this basic block as native code.
+// Blocks are compiled only after JIT_HOT_THRESHOLD hits, cold ones run on direct threaded engine.
+void ppcsimbooke::ppcsimbooke_basic_block::basic_block::run_jit(ppcsimbooke::ppcsimbooke_basic_block::context& ctx){
+    LOG_DEBUG4(MSG_FUNC_START);
+
+    if unlikely(jitcode == NULL && hitcount < ppcsimbooke::ppcsimbooke_jit::JIT_HOT_THRESHOLD){
+        run_direct_threaded(ctx);
+    }else{
+        run_native(ctx);
+    }
+
+    LOG_DEBUG4(MSG_FUNC_END);
+}
+
+// Run this basic block as native code
+void ppcsimbooke::ppcsimbooke_basic_block::basic_block::run_native(ppcsimbooke::ppcsimbooke_basic_block::context& ctx){
+    LOG_DEBUG4(MSG_FUNC_START);
+
+    if unlikely(transopscount == 0){
+        LOG_DEBUG4(MSG_FUNC_END);
+        return;
+    }
+
+    if unlikely(jitcode == NULL){
+        jitcode = ppcsimbooke::ppcsimbooke_jit::x86_64_jit::compile(ctx, *this, jitsize);
+    }
+
+    int status;
+    {
+        basic_block_ref ref(this);
+        status = jitcode(&ctx);
+    }
+
+    // PC/NIP already point to faulting instruction
+    if unlikely(status){
+        if likely(ctx.exception_pending()){
+            LOG_DEBUG4(MSG_FUNC_END);
+            return;
+        }
+        ppcsimbooke::ppcsimbooke_jit::x86_64_jit::rethrow_pending();
+    }
+
+    update_targets(ctx);
+    hitcount++;
 
     LOG_DEBUG4(MSG_FUNC_END);
 }
@@ -199,18 +311,131 @@ void ppcsimbooke::ppcsimbooke_basic_block::basic_block::init_synthops(ppcsimbook
     if likely(synthops == NULL){ synthops = new opc_impl_func_t[transopscount]; }
 
     for(size_t i=0; i<transopscount; i++){
-        synthops[i] = ctx.get_opc_impl(transops[i].hv);
+        // handlers are resolved at decode time. Fall back to handler table for others.
+        synthops[i] = likely(transops[i].fptr != NULL) ? transops[i].fptr : ctx.get_opc_impl(transops[i].hv);
     }
 
     LOG_DEBUG4(MSG_FUNC_END);
 }
 
+// Find a fused pair made of instrs i & i+1. Pairs ending with a branch must end the block,
+// others must not reach it's last instr ( since a sync entry sits before that ).
+const ppcsimbooke::ppcsimbooke_basic_block::threaded_fused_op*
+ppcsimbooke::ppcsimbooke_basic_block::basic_block::find_fused(size_t i) const {
+    if((i + 1) >= transopscount){
+        return NULL;
+    }
+    // NOTE : Names are compared since handler indices differ for specialized variants.
+    bool branch = ((i + 2) == transopscount);
+
+    // Fused bodies run instrs as they were decoded
+    if(ppcsimbooke::ppcsimbooke_dis::ppcdis::is_ir_op(transops[i]) || ppcsimbooke::ppcsimbooke_dis::ppcdis::is_ir_op(transops[i+1])){
+        return NULL;
+    }
+
+    for(size_t k=0; k<threaded_lbls.fused.size(); k++){
+        const threaded_fused_op& f = threaded_lbls.fused[k];
+        if(f.branch == branch && transops[i].opcname == f.opc0 && transops[i+1].opcname == f.opc1){
+            return &f;
+        }
+    }
+    return NULL;
+}
+
+// Emit threaded code for this block. Layout is
+// [ op0, op1, ... op(n-2), <sync pc>, op(n-1) ]
+// Caller terminates it with an exit ( or guard ) entry.
+// If op(i) & op(i+1) make a fused pair, op(i) runs both of them. op(i+1) is still emitted, so
+// that every instr has it's own entry ( for precise PCs ), but nobody dispatches to it.
+size_t ppcsimbooke::ppcsimbooke_basic_block::basic_block::emit_threadops(ppcsimbooke::ppcsimbooke_basic_block::context& ctx,
+        ppcsimbooke::ppcsimbooke_basic_block::threaded_op* ops){
+    LOG_DEBUG4(MSG_FUNC_START);
+
+    uint64_t mask = ctx.get_pc_mask();
+    size_t   j    = 0;
+    bool     second = false;                   // current instr is second one of a fused pair
+
+    for(size_t i=0; i<transopscount; i++){
+        uint64_t ip = (bip.ip + i*OPCODE_SIZE) & mask;
+        const threaded_fused_op* f = (second) ? NULL : find_fused(i);
+        if(i == (transopscount-1)){
+            ops[j].lbl = threaded_lbls.sync;
+            ops[j].ic  = &transops[i];
+            ops[j].ip  = ip;
+            j++;
+        }
+        ops[j].lbl = (f) ? f->lbl : threaded_lbls.opc[transops[i].hv & 0xffffffffULL];
+        ops[j].ic  = &transops[i];
+        ops[j].ip  = ip;
+        j++;
+        second = (f != NULL);
+    }
+
+    LOG_DEBUG4(MSG_FUNC_END);
+    return j;
+}
+
+// initialize direct threaded code
+void ppcsimbooke::ppcsimbooke_basic_block::basic_block::init_threadops(ppcsimbooke::ppcsimbooke_cpu::cpu& ctx){
+    LOG_DEBUG4(MSG_FUNC_START);
+
+    if likely(threadops == NULL){ threadops = new threaded_op[transopscount + 2]; }
+
+    size_t j = emit_threadops(ctx, threadops);
+    threadops[j].lbl = threaded_lbls.exit;
+    threadops[j].ic  = NULL;
+    threadops[j].ip  = 0;
+
+    LOG_DEBUG4(MSG_FUNC_END);
+}
+
+// Run ahead of time translated code of this basic block ( see ppcsimbooke_aot )
+void ppcsimbooke::ppcsimbooke_basic_block::basic_block::run_aot(ppcsimbooke::ppcsimbooke_basic_block::context& ctx){
+    LOG_DEBUG4(MSG_FUNC_START);
+
+    if unlikely(transopscount == 0){
+        LOG_DEBUG4(MSG_FUNC_END);
+        return;
+    }
+
+    int status;
+    {
+        basic_block_ref ref(this);
+        status = aotcode(&ctx);
+    }
+
+    // PC/NIP already point to faulting instruction
+    if unlikely(status){
+        LOG_DEBUG4(MSG_FUNC_END);
+        return;
+    }
+
+    update_targets(ctx);
+    hitcount++;
+
+    LOG_DEBUG4(MSG_FUNC_END);
+}
+
 // Update targets according to final context state
 void ppcsimbooke::ppcsimbooke_basic_block::basic_block::update_targets(ppcsimbooke::ppcsimbooke_basic_block::context& ctx){
     LOG_DEBUG4(MSG_FUNC_START);
 
-    ip_taken     = ctx.get_nip();
-    ip_not_taken = (ctx.get_pc() + 4) & ctx.get_pc_mask();
+    uint64_t fall_through = (bip.ip + transopscount*OPCODE_SIZE) & ctx.get_pc_mask();
+
+    // ip_not_taken is always the fall through address. ip_taken is the last target which
+    // was different from the fall through ( drop the successor link if it changed ).
+    lasttarget   = ctx.get_pc();
+    ip_not_taken = fall_through;
+    if(lasttarget == fall_through){
+        not_taken_count++;
+    }else{
+        if(lasttarget != ip_taken){
+            ip_taken    = lasttarget;
+            next_taken  = NULL;
+            taken_count = 0;
+        }
+        taken_count++;
+    }
 
     LOG_DEBUG4(MSG_FUNC_END);
 }
@@ -267,6 +492,7 @@ ppcsimbooke::ppcsimbooke_basic_block::basic_block_decoder::basic_block_decoder
 
     bb.bip = bip;
     reset();
+    decoder.set_opc_impl_table(ppcsimbooke::ppcsimbooke_cpu::cpu::sm_ppc_func_tbl.data());
 
     LOG_DEBUG4(MSG_FUNC_END);
 }
@@ -276,6 +502,7 @@ ppcsimbooke::ppcsimbooke_basic_block::basic_block_decoder::basic_block_decoder(p
 
     bb.bip = basic_block_ip(ctx);
     reset();
+    decoder.set_opc_impl_table(ppcsimbooke::ppcsimbooke_cpu::cpu::sm_ppc_func_tbl.data());
 
     LOG_DEBUG4(MSG_FUNC_END);
 }
@@ -301,6 +528,25 @@ int ppcsimbooke::ppcsimbooke_basic_block::basic_block_decoder::fillbuff(ppcsimbo
     return valid_byte_count;
 }
 
+// Decode instrs already present in buff ( for eg. by ahead of time translator )
+int ppcsimbooke::ppcsimbooke_basic_block::basic_block_decoder::fillbuff(uint8_t *buff, int buffsize, int nvalid){
+    LOG_DEBUG4(MSG_FUNC_START);
+
+    insnbytes = buff;
+    insnbytes_buffsize = buffsize;
+    byteoffset = 0;
+    invalid = 0;
+    valid_byte_count = nvalid;
+    fault_addr = bb.bip + valid_byte_count;
+
+    // instruction buffer should be multiple of 4 bytes
+    LASSERT_THROW_UNLIKELY(!(valid_byte_count % OPCODE_SIZE),
+            sim_except(SIM_EXCEPT_EINVAL, "valid_byte_count should be multiple of " + OPCODE_SIZE), DEBUG4);
+
+    LOG_DEBUG4(MSG_FUNC_END);
+    return valid_byte_count;
+}
+
 bool ppcsimbooke::ppcsimbooke_basic_block::basic_block_decoder::invalidate(){
     LOG_DEBUG4(MSG_FUNC_START);
     LOG_DEBUG4(MSG_FUNC_END);
@@ -332,9 +578,27 @@ bool ppcsimbooke::ppcsimbooke_basic_block::basic_block_decoder::decode(){
             LOG_DEBUG4(MSG_FUNC_END);
             return true;
         }
+        // context altering instrs end a block too ( it just falls through ). Rest of the block may
+        // run in a different context & only last instr of a block sees precise PC/NIP in direct
+        // threaded code ( see ppcsimbooke_cpu::run_threaded_ops() ).
+        if unlikely(decoder.is_ctxt_alter(ic)){
+            branch_cond = BB_BRTYPE_SPLIT;
+            if(flush()){
+                split();
+            }
+            LOG_DEBUG4(MSG_FUNC_END);
+            return true;
+        }
         byteoffset += OPCODE_SIZE;
         ip_decoded += OPCODE_SIZE;           // update decoded ip
     }
+
+    // Ran out of instrs ( block is full or fetch stopped at a page boundary/fault ). Block just falls
+    // through to next instr. flush() splits on it's own if block is full.
+    branch_cond = BB_BRTYPE_SPLIT;
+    if(flush() || !transbuffcount){
+        split();
+    }
     LOG_DEBUG4(MSG_FUNC_END);
     return true;
 }
@@ -375,24 +639,364 @@ void ppcsimbooke::ppcsimbooke_basic_block::basic_block_decoder::split(){
     bb.ip_taken = ip_copied;
     bb.ip_not_taken = ip_copied;
     bb.brtype = branch_cond;
+
+    elim_dead_flags();
+
+    // Pick handlers specialized for operands of each instr
+    for(size_t i=0; i<bb.transopscount; i++){
+        decoder.specialize(bb.transops[i]);
+    }
+
+    // Block local optimizations ( see basic_block_ir )
+    basic_block_ir ir;
+    ir.optimize(bb, decoder);
+
+    // Check if block can be a polling loop ( see cpu::check_spin() )
+    bb.side_effect_free = (bb.transopscount > 0);
+    for(size_t i=0; i<bb.transopscount && bb.side_effect_free; i++){
+        bb.side_effect_free = decoder.is_side_effect_free(bb.transops[i]);
+    }
+
+    // Kind of branch ending the block ( see basic_block_cache_unit::translate() )
+    bb.exits = 0;
+    if(branch_cond == BB_BRTYPE_BRANCH && bb.transopscount){
+        instr_call& last = bb.transops[bb.transopscount - 1];
+        if(decoder.is_branch_link(last)){ bb.exits |= BB_EXIT_LINK;                      }
+        if(decoder.is_branch_lr(last))  { bb.exits |= BB_EXIT_RETURN | BB_EXIT_INDIRECT; }
+        if(decoder.is_branch_ctr(last)) { bb.exits |= BB_EXIT_INDIRECT;                  }
+    }
     //end_of_block = 1;
     //
 
     LOG_DEBUG4(MSG_FUNC_END);
 }
 
+// Dead flag update elimination.
+// Walks the block backwards tracking liveness of CR0 & XER[CA]. A record form whose CR0 is overwritten
+// by a later record form ( or a carrying instr whose CA is overwritten by a later carrying instr ) before
+// anybody reads it, is replaced by the variant which doesn't update them ( for eg. add. -> add,
+// addc -> add ).
+// NOTE : Only instrs listed below are understood. Everything else ( branches, CR/SPR moves, loads &
+//        stores which can fault & expose CR/XER to an exception handler etc. ) makes both live again.
+//        XER[SO, OV] are sticky and are never eliminated.
+void ppcsimbooke::ppcsimbooke_basic_block::basic_block_decoder::elim_dead_flags(){
+    LOG_DEBUG4(MSG_FUNC_START);
+
+    // Neither read nor write CR/XER[CA] ( apart from CR0 for their record forms )
+    static const char* alu_tbl[] = {
+        "add", "addo", "subf", "subfo", "neg", "nego", "mullw", "mullwo", "mulhw", "mulhwu",
+        "divw", "divwo", "divwu", "divwuo", "and", "andc", "or", "orc", "xor", "nor", "nand", "eqv",
+        "slw", "srw", "cntlzw", "extsb", "extsh", "rlwinm", "rlwimi", "rlwnm",
+        "addi", "addis", "mulli", "ori", "oris", "xori", "xoris", "andi.", "andis.",
+    };
+    // Set XER[CA] without reading it
+    static const char* ca_set_tbl[] = {
+        "addc", "addco", "subfc", "subfco", "addic", "addic.", "subfic", "sraw", "srawi",
+    };
+    // Read & set XER[CA]
+    static const char* ca_use_tbl[] = {
+        "adde", "addeo", "addme", "addmeo", "addze", "addzeo", "subfe", "subfeo", "subfme", "subfmeo",
+        "subfze", "subfzeo",
+    };
+    // Carrying instr -> same instr without XER[CA] update
+    static const char* ca_drop_tbl[][2] = {
+        { "addc", "add" }, { "addco", "addo" }, { "subfc", "subf" }, { "subfco", "subfo" },
+    };
+
+    bool cr0_live = true;             // live out of block ( successors are unknown )
+    bool ca_live  = true;
+
+    for(size_t i=bb.transopscount; i-- > 0; ){
+        instr_call& ic   = bb.transops[i];
+        std::string name = ic.opcname;
+        bool        rc   = (name.size() > 1 && name[name.size()-1] == '.');
+        std::string base = (rc) ? name.substr(0, name.size()-1) : name;
+        bool        alu  = opc_in_tbl(alu_tbl, name) || opc_in_tbl(alu_tbl, base);
+        bool        cas  = opc_in_tbl(ca_set_tbl, name) || opc_in_tbl(ca_set_tbl, base);
+        bool        cau  = opc_in_tbl(ca_use_tbl, base);
+
+        if(!alu && !cas && !cau){
+            cr0_live = ca_live = true;
+            continue;
+        }
+
+        // Pick cheapest variant which still produces everything that is live
+        std::string nname = name;
+        if(rc && !cr0_live && (opc_in_tbl(alu_tbl, base) || opc_in_tbl(ca_set_tbl, base) || cau)){
+            nname = base;
+        }
+        if(cas && !ca_live){
+            for(size_t j=0; j<sizeof(ca_drop_tbl)/sizeof(ca_drop_tbl[0]); j++){
+                if(base == ca_drop_tbl[j][0]){
+                    nname = std::string(ca_drop_tbl[j][1]) + ((nname == name && rc) ? "." : "");
+                    break;
+                }
+            }
+        }
+        if(nname != name){
+            decoder.retarget(ic, nname);
+        }
+
+        // Liveness before this instr
+        if(rc)  { cr0_live = false; }
+        if(cas) { ca_live  = false; }
+        if(cau) { ca_live  = true;  }
+    }
+
+    LOG_DEBUG4(MSG_FUNC_END);
+}
+
 //////////////////////////////////////////////////////////////////////////////////////////////
 // basic block cache unit
 //////////////////////////////////////////////////////////////////////////////////////////////
 
-// translate current context into a single basic block & insert it into basic block cache
+// translate current context into a single basic block.
+// If current pc is one of the exits of last translated block and nothing has changed since the
+// link was made ( chain generation is same ), successor block is returned directly without any
+// address translation or hash lookup. Targets of returns & other indirect branches, which a single
+// taken link can't hold, are predicted by return address stack & indirect target cache.
 ppcsimbooke::ppcsimbooke_basic_block::basic_block*
 ppcsimbooke::ppcsimbooke_basic_block::basic_block_cache_unit::translate(ppcsimbooke::ppcsimbooke_basic_block::context& ctx){
     LOG_DEBUG4(MSG_FUNC_START);
 
+    // Last block is done with by now
+    if unlikely(!m_dirty_bbs.empty()){ reap(); }
+
+    basic_block* prev   = m_last_bb;
+    basic_block* bb     = NULL;
+    basic_block* caller = NULL;
+    itc_entry*   itc    = NULL;
+    uint64_t     pc     = ctx.get_pc();
+
+    // Calls & returns ( only if branch was taken ). Return is popped first, so bclrl returns & calls again.
+    if unlikely(prev != NULL && prev->exits && pc != prev->ip_not_taken){
+        if(prev->exits & BB_EXIT_RETURN){
+            ras_entry& e = m_ras[m_ras_top];
+            if(e.chain_gen == m_chain_gen && e.caller->ip_not_taken == pc){ caller = e.caller; }
+            e.chain_gen = 0;
+            m_ras_top   = (m_ras_top - 1) & (RAS_SIZE - 1);
+        }
+        if(prev->exits & BB_EXIT_LINK){
+            m_ras_top = (m_ras_top + 1) & (RAS_SIZE - 1);
+            m_ras[m_ras_top].caller    = prev;
+            m_ras[m_ras_top].chain_gen = m_chain_gen;
+        }
+    }
+
+    // Try following chain first
+    if likely(prev != NULL && prev->chain_gen == m_chain_gen){
+        if(pc == prev->ip_not_taken && prev->next_not_taken){
+            m_last_bb = prev->next_not_taken;
+            LOG_DEBUG4(MSG_FUNC_END);
+            return m_last_bb;
+        }
+        if(pc == prev->ip_taken && prev->next_taken){
+            m_last_bb = prev->next_taken;
+            LOG_DEBUG4(MSG_FUNC_END);
+            return m_last_bb;
+        }
+    }
+
+    // Return predicted by return address stack
+    if(caller != NULL && caller->chain_gen == m_chain_gen && caller->next_not_taken){
+        m_last_bb = caller->next_not_taken;
+        LOG_DEBUG4(MSG_FUNC_END);
+        return m_last_bb;
+    }
+
+    // Indirect target cache
+    if unlikely(prev != NULL && (prev->exits & BB_EXIT_INDIRECT)){
+        uint64_t src = prev->bip.ip + (prev->transopscount - 1)*OPCODE_SIZE;
+        itc = &m_itc[itc_index(src, pc)];
+        if(itc->chain_gen == m_chain_gen && itc->src == src && itc->target == pc){
+            m_last_bb = itc->bb;
+            LOG_DEBUG4(MSG_FUNC_END);
+            return m_last_bb;
+        }
+        itc->src       = src;
+        itc->target    = pc;
+    }
+
+    bb = lookup(ctx);
+    if unlikely(bb == NULL){
+        if(itc){ itc->chain_gen = 0; }
+        LOG_DEBUG4(MSG_FUNC_END);
+        return NULL;                 // exception pending ( instruction fetch faulted )
+    }
+
+    // Chain it to previous block ( & to the caller it returns to )
+    if likely(prev != NULL){ chain(prev, pc, bb); }
+    if(caller != NULL){ chain(caller, pc, bb); }
+    if(itc != NULL){
+        itc->bb        = bb;
+        itc->chain_gen = m_chain_gen;
+    }
+    m_last_bb = bb;
+
+    LOG_DEBUG4(MSG_FUNC_END);
+    return bb;
+}
+
+// Link successor of block from at pc ( no-op if pc is neither of from's exits )
+void ppcsimbooke::ppcsimbooke_basic_block::basic_block_cache_unit::chain(ppcsimbooke::ppcsimbooke_basic_block::basic_block* from,
+        uint64_t pc, ppcsimbooke::ppcsimbooke_basic_block::basic_block* to){
+    if(from->chain_gen != m_chain_gen){
+        from->next_taken = from->next_not_taken = NULL;
+        from->chain_gen  = m_chain_gen;
+    }
+    if(pc == from->ip_not_taken){
+        from->next_not_taken = to;
+    }else if(pc == from->ip_taken){
+        from->next_taken = to;
+    }
+}
+
+// Get hot trace headed by bb.
+// A trace is (re)formed every TRACE_HOT_THRESHOLD hits of it's head by following the more
+// frequently taken chain link of each block. Traces are valid only as long as block chains are,
+// so any invalidation or context switch drops them too.
+// Returns NULL if bb doesn't head a ( valid ) trace.
+ppcsimbooke::ppcsimbooke_basic_block::basic_block_trace*
+ppcsimbooke::ppcsimbooke_basic_block::basic_block_cache_unit::get_trace(ppcsimbooke::ppcsimbooke_basic_block::context& ctx,
+        ppcsimbooke::ppcsimbooke_basic_block::basic_block* bb){
+    LOG_DEBUG4(MSG_FUNC_START);
+
+    if likely(bb->trace != NULL && bb->trace->chain_gen == m_chain_gen){
+        LOG_DEBUG4(MSG_FUNC_END);
+        return bb->trace;
+    }
+
+    if likely(bb->hitcount == 0 || (bb->hitcount % TRACE_HOT_THRESHOLD) != 0){
+        LOG_DEBUG4(MSG_FUNC_END);
+        return NULL;
+    }
+
+    // Stale trace ( if any ) goes away
+    if(bb->trace){ delete bb->trace; bb->trace = NULL; }
+
+    basic_block*  path[MAX_TRACE_BBS];
+    size_t        npath  = 0;
+    size_t        nops   = 0;
+    basic_block*  cur    = bb;
+
+    // Record hot path
+    while(cur != NULL && cur->transopscount != 0 && npath < MAX_TRACE_BBS){
+        if(std::find(path, path + npath, cur) != (path + npath)){ break; }
+        path[npath++] = cur;
+        nops         += cur->transopscount + 2;
+
+        if(cur->chain_gen != m_chain_gen){ break; }
+        cur = (cur->taken_count > cur->not_taken_count) ? cur->next_taken : cur->next_not_taken;
+    }
+
+    if(npath < 2){
+        LOG_DEBUG4(MSG_FUNC_END);
+        return NULL;
+    }
+
+    // Stitch threaded code of all blocks. Each block except last one ends with a guard
+    // for the next one.
+    basic_block_trace* tr = new basic_block_trace;
+    tr->threadops         = new threaded_op[nops];
+    tr->chain_gen         = m_chain_gen;
+    tr->nbbs              = npath;
+
+    size_t j = 0;
+    for(size_t k=0; k<npath; k++){
+        tr->bbs[k]      = path[k];
+        j              += path[k]->emit_threadops(ctx, tr->threadops + j);
+        tr->exit_pos[k] = j;
+        if(k < (npath-1)){
+            tr->threadops[j].lbl = threaded_lbls.guard;
+            tr->threadops[j].ip  = path[k+1]->bip.ip;
+        }else{
+            tr->threadops[j].lbl = threaded_lbls.exit;
+            tr->threadops[j].ip  = 0;
+        }
+        tr->threadops[j].ic = NULL;
+        j++;
+    }
+
+    bb->trace = tr;
+
+    LOG_DEBUG4("Formed trace of ", npath, " basic blocks at ", bb->bip, std::endl);
+    LOG_DEBUG4(MSG_FUNC_END);
+    return tr;
+}
+
+// Run a trace & update all it's member blocks which were executed.
+// Returns number of instructions completed.
+size_t ppcsimbooke::ppcsimbooke_basic_block::basic_block_cache_unit::run_trace(ppcsimbooke::ppcsimbooke_basic_block::context& ctx,
+        ppcsimbooke::ppcsimbooke_basic_block::basic_block_trace* tr){
+    LOG_DEBUG4(MSG_FUNC_START);
+
+    const threaded_op* end = NULL;
+
+    // All members are in use ( a store may try to invalidate any of them )
+    for(size_t i=0; i<tr->nbbs; i++){ tr->bbs[i]->acquire(); }
+    try {
+        end = ppcsimbooke::ppcsimbooke_cpu::run_threaded_ops(&ctx, tr->threadops);
+    }
+    catch(...){
+        for(size_t i=0; i<tr->nbbs; i++){ tr->bbs[i]->release(); }
+        throw;
+    }
+    for(size_t i=0; i<tr->nbbs; i++){ tr->bbs[i]->release(); }
+
+    // find out where we left ( an exit / guard or a faulting instruction of k'th member )
+    size_t k = 0;
+    while(k < (tr->nbbs-1) && (tr->threadops + tr->exit_pos[k]) < end){ k++; }
+
+    size_t ninstrs = 0;
+    for(size_t i=0; i<k; i++){
+        tr->bbs[i]->hitcount++;
+        if(tr->bbs[i+1]->bip.ip == tr->bbs[i]->ip_not_taken){ tr->bbs[i]->not_taken_count++; }
+        else                                                 { tr->bbs[i]->taken_count++;     }
+        ninstrs += tr->bbs[i]->transopscount;
+    }
+
+    // k'th member raised an exception. Preceding members are complete & so are the instrs
+    // of k'th member before the faulting one ( PC points to faulting instr ).
+    if unlikely(ctx.exception_pending()){
+        ninstrs += tr->bbs[k]->ninstrs_before(ctx.get_pc());
+        m_last_bb = NULL;
+        LOG_DEBUG4(MSG_FUNC_END);
+        return ninstrs;
+    }
+
+    tr->bbs[k]->update_targets(ctx);
+    tr->bbs[k]->hitcount++;
+    ninstrs += tr->bbs[k]->transopscount;
+
+    // Exiting block becomes chain source for next translation, unless a store inside the trace
+    // invalidated it ( it's only waiting in m_dirty_bbs to be freed ).
+    if unlikely(std::find(m_dirty_bbs.begin(), m_dirty_bbs.end(), tr->bbs[k]) != m_dirty_bbs.end()){
+        m_last_bb = NULL;
+    }else{
+        m_last_bb = tr->bbs[k];
+    }
+
+    tr->hitcount++;
+    if(k < (tr->nbbs-1)){ tr->side_exits++; }
+
+    LOG_DEBUG4(MSG_FUNC_END);
+    return ninstrs;
+}
+
+// lookup current context in basic block cache & translate it if it's not there
+ppcsimbooke::ppcsimbooke_basic_block::basic_block*
+ppcsimbooke::ppcsimbooke_basic_block::basic_block_cache_unit::lookup(ppcsimbooke::ppcsimbooke_basic_block::context& ctx){
+    LOG_DEBUG4(MSG_FUNC_START);
+
     basic_block_ip bb_ip(ctx);
     basic_block_chunk_list* page_list = NULL;
 
+    // Instruction fetch faulted
+    if unlikely(ctx.exception_pending()){
+        LOG_DEBUG4(MSG_FUNC_END);
+        return NULL;
+    }
+
     basic_block* bb = m_bb_cache.get(bb_ip);
     if likely(bb){
         LOG_DEBUG4(MSG_FUNC_END);
@@ -405,6 +1009,7 @@ ppcsimbooke::ppcsimbooke_basic_block::basic_block_cache_unit::translate(ppcsimbo
     bb_decoder.fillbuff(ctx, bb_insnbuff, MAX_BB_INS_BYTES);           // Assign buffer for decoder to work on
     bb_decoder.decode();                                               // decode
     bb = bb_decoder.bb.clone();                                        // get basic block
+    if(m_aot){ bb->aotcode = m_aot->find(*bb, bb_insnbuff); }          // ahead of time translated code for it ?
 
     // Add to basic block cache
     bb->acquire();                  // acquire basic block
@@ -417,9 +1022,11 @@ ppcsimbooke::ppcsimbooke_basic_block::basic_block_cache_unit::translate(ppcsimbo
         page_list = new basic_block_chunk_list(bb->bip.mfn);
         page_list->refcount++;
         m_bb_page_cache.add(page_list);
+        m_code_pages.set((bb->bip.mfn >> MIN_PGSZ_SHIFT) & (CODE_PAGE_FILTER_SIZE - 1));
     }
     page_list->refcount++;
     page_list->add(bb, bb->mfn_loc);
+    page_list->add_code_range(bb->bip.ip & ~MIN_PGSZ_MASK, (bb->bip.ip & ~MIN_PGSZ_MASK) + bb->transopscount*OPCODE_SIZE);
     page_list->refcount--;
 
     LOG_DEBUG4(MSG_FUNC_END);
@@ -445,16 +1052,22 @@ bool ppcsimbooke::ppcsimbooke_basic_block::basic_block_cache_unit::invalidate(pp
 
     basic_block_chunk_list* page_list = NULL;
 
-    if unlikely(bb->refcount){
-        LOG_DEBUG4("basic_block ", bb, " is still in use somewhere. RefCount = ", bb->refcount);
-        LOG_DEBUG4(MSG_FUNC_END);
-        return false;
-    }
-
     page_list = m_bb_page_cache.get(bb->bip.mfn);
     page_list->remove(bb->mfn_loc);         // Remove this basic block from page list cache 
     m_bb_cache.remove(bb);                  // Remove this from basic block cache
 
+    // Other blocks may be chained to this one. Break all chains.
+    unchain();
+    if(m_last_bb == bb){ m_last_bb = NULL; }
+
+    // Caller ( or running trace ) still holds it. Free it once it's released.
+    if unlikely(bb->refcount){
+        LOG_DEBUG4("basic_block ", bb, " is still in use somewhere. RefCount = ", bb->refcount, ". Marked dirty.", std::endl);
+        m_dirty_bbs.push_back(bb);
+        LOG_DEBUG4(MSG_FUNC_END);
+        return true;
+    }
+
     bb->free();
 
     LOG_DEBUG4(MSG_FUNC_END);
@@ -478,25 +1091,71 @@ bool ppcsimbooke::ppcsimbooke_basic_block::basic_block_cache_unit::invalidate_pa
         return false;
     }
 
+    // Collect blocks first. invalidate() removes them from page list.
     basic_block_chunk_list::Iterator iter(page_list);
-    basic_block*  bb = NULL;
-    basic_block** bb_ptr = NULL;
+    std::vector<basic_block*>        bbs;
+    basic_block**                    bb_ptr = NULL;
 
     while((bb_ptr = iter.next())){
-        bb = *bb_ptr;
-        if unlikely(!invalidate(bb, reason)){
-            LOG_DEBUG4("Couldn't invalidate ", *bb, " std::endl");
-            LOG_DEBUG4(MSG_FUNC_END);
-            return false;
-        }
+        bbs.push_back(*bb_ptr);
+    }
+    for(size_t i=0; i<bbs.size(); i++){
+        invalidate(bbs[i], reason);
     }
 
     page_list->clear();
+    page_list->clear_code_range();
 
     LOG_DEBUG4(MSG_FUNC_END);
     return true;
 }
 
+// invalidate basic blocks whose code overlaps physical range [ra, ra + size) ( range is within a page )
+// Returns true if any block was invalidated.
+bool ppcsimbooke::ppcsimbooke_basic_block::basic_block_cache_unit::invalidate_range(uint64_t ra, size_t size, int reason){
+    LOG_DEBUG4(MSG_FUNC_START);
+
+    basic_block_chunk_list* page_list = m_bb_page_cache.get(ra & MIN_PGSZ_MASK);
+    uint64_t                start     = ra & ~MIN_PGSZ_MASK;
+    uint64_t                end       = start + size;
+
+    // Data sharing a page with code is common ( for eg. in images linked with -N )
+    if(!page_list || start >= page_list->code_end || end <= page_list->code_start){
+        LOG_DEBUG4(MSG_FUNC_END);
+        return false;
+    }
+
+    basic_block_chunk_list::Iterator iter(page_list);
+    std::vector<basic_block*>        bbs;
+    basic_block**                    bb_ptr = NULL;
+
+    while((bb_ptr = iter.next())){
+        uint64_t bb_start = (*bb_ptr)->bip.ip & ~MIN_PGSZ_MASK;
+        uint64_t bb_end   = bb_start + (*bb_ptr)->transopscount*OPCODE_SIZE;
+        if(start < bb_end && end > bb_start){ bbs.push_back(*bb_ptr); }
+    }
+    for(size_t i=0; i<bbs.size(); i++){
+        invalidate(bbs[i], reason);
+    }
+
+    LOG_DEBUG4(MSG_FUNC_END);
+    return !bbs.empty();
+}
+
+// Free blocks which were invalidated while in use, once nobody holds them.
+void ppcsimbooke::ppcsimbooke_basic_block::basic_block_cache_unit::reap(){
+    LOG_DEBUG4(MSG_FUNC_START);
+
+    size_t j = 0;
+    for(size_t i=0; i<m_dirty_bbs.size(); i++){
+        if(m_dirty_bbs[i]->refcount){ m_dirty_bbs[j++] = m_dirty_bbs[i]; }
+        else                        { m_dirty_bbs[i]->free();             }
+    }
+    m_dirty_bbs.resize(j);
+
+    LOG_DEBUG4(MSG_FUNC_END);
+}
+
 // Return total number of basic blocks belonging to a physical page no
 size_t ppcsimbooke::ppcsimbooke_basic_block::basic_block_cache_unit::get_page_bb_count(uint64_t mfn){
     LOG_DEBUG4(MSG_FUNC_START);
@@ -522,9 +1181,13 @@ size_t ppcsimbooke::ppcsimbooke_basic_block::basic_block_cache_unit::get_page_bb
 void ppcsimbooke::ppcsimbooke_basic_block::basic_block_cache_unit::flush(){
     LOG_DEBUG4(MSG_FUNC_START);
 
+    // Collect blocks first. invalidate() removes them from cache.
     basic_block_cache::Iterator iter_bc(m_bb_cache);
+    std::vector<basic_block*>   bbs;
     basic_block* bptr;
-    while((bptr = iter_bc.next())){ invalidate(bptr, INVALIDATE_REASON_RECLAIM); }
+    while((bptr = iter_bc.next())){ bbs.push_back(bptr); }
+    for(size_t i=0; i<bbs.size(); i++){ invalidate(bbs[i], INVALIDATE_REASON_RECLAIM); }
+    reap();
 
     basic_block_page_cache::Iterator iter_pc(m_bb_page_cache);
     basic_block_chunk_list *page;
@@ -532,6 +1195,7 @@ void ppcsimbooke::ppcsimbooke_basic_block::basic_block_cache_unit::flush(){
         m_bb_page_cache.remove(page);
         delete page;
     }
+    m_code_pages.reset();
 
     LOG_DEBUG4(MSG_FUNC_END);
 }
@@ -5,6 +5,9 @@
 #include "superstl.h"
 #include "ppc_dis.h"
 #include "globals.h"
+#include "jit_x86_64.h"
+#include "aot.h"
+#include <algorithm>
 
 namespace ppcsimbooke {
     // forward declarations
@@ -16,6 +19,12 @@ namespace ppcsimbooke {
 
         static const size_t OPCODE_SIZE = 4;
 
+        // Check if opcode name is in a table of opcode names ( used by block passes )
+        template<size_t N>
+        inline bool opc_in_tbl(const char* (&tbl)[N], const std::string& name){
+            return std::find(tbl, tbl + N, name) != tbl + N;
+        }
+
         // typedefs
         typedef ppcsimbooke_cpu::cpu context;
 
@@ -60,9 +69,17 @@ namespace ppcsimbooke {
             superstl::selflistlink               hashlink;
             uint64_t                             mfn;
             int                                  refcount;
+            uint64_t                             code_start;    // page offsets spanned by code of all blocks in list
+            uint64_t                             code_end;      // ( only grows, till list is cleared )
             
-            basic_block_chunk_list(): ChunkList<basic_block*, BB_PTRS_PER_CHUNK>() { refcount = 0; }
-            basic_block_chunk_list(uint64_t mfn): ChunkList<basic_block*, BB_PTRS_PER_CHUNK>() { this->mfn = mfn; refcount = 0; }
+            basic_block_chunk_list(): ChunkList<basic_block*, BB_PTRS_PER_CHUNK>() { refcount = 0; clear_code_range(); }
+            basic_block_chunk_list(uint64_t mfn): ChunkList<basic_block*, BB_PTRS_PER_CHUNK>() { this->mfn = mfn; refcount = 0; clear_code_range(); }
+
+            void clear_code_range() { code_start = ~0ULL; code_end = 0; }
+            void add_code_range(uint64_t start, uint64_t end) {
+                if(start < code_start){ code_start = start; }
+                if(end > code_end)    { code_end = end;     }
+            }
         };
 
         // basic block chunk list overload for std::cout
@@ -77,8 +94,57 @@ namespace ppcsimbooke {
 
         enum { BB_BRTYPE_SPLIT, BB_BRTYPE_BRANCH, BB_BRTYPE_INV };
 
+        // kind of branch ending a block ( bitmask, used for predicting indirect successors )
+        enum {
+            BB_EXIT_LINK      = 0x1,      // sets LR ( call, fall through is the return address )
+            BB_EXIT_RETURN    = 0x2,      // branch to LR ( return )
+            BB_EXIT_INDIRECT  = 0x4,      // branch to LR or CTR
+        };
+
+        // execution tiers ( used by tiered execution mode )
+        enum {
+            BB_TIER_INTERPRETIVE,         // one opcode handler call per instruction
+            BB_TIER_THREADED,             // direct threaded engine
+            BB_TIER_NATIVE,               // JIT compiled
+            BB_TIER_COUNT,
+        };
+
         //typedef typename ppcsimbooke::ppcsimbooke_cpu::cpu::ppc_opc_fun_ptr  opc_impl_func_t;   // powerpc opcode handler type
         typedef void (*opc_impl_func_t)(context *pcpu, ppcsimbooke::instr_call *pic);
+
+        // Direct threaded code entry.
+        // lbl is the address of opcode implementation (label) inside direct threaded engine
+        // ( see ppcsimbooke_cpu::run_threaded_ops() ), ic is the call frame it acts upon.
+        // ip is instruction address for opcode entries, pc to be set for sync entries and
+        // expected next block address for guard entries.
+        struct threaded_op {
+            const void*                      lbl;
+            instr_call*                      ic;
+            uint64_t                         ip;
+        };
+
+        // Fused instruction pair ( see FUSED INSTRUCTION PAIRS in cpu_ppc_instr.cc ).
+        // Replaces op of first instr. Entries of second instr stay in place, but are stepped over by
+        // fused body itself.
+        struct threaded_fused_op {
+            const char*                      opc0;                     // opcode of first instr
+            const char*                      opc1;                     // opcode of second instr
+            const void*                      lbl;
+            bool                             branch;                   // second instr ends the block
+        };
+
+        // Labels exported by direct threaded engine ( recorded when cpu is initialized )
+        struct threaded_labels {
+            std::vector<const void*>         opc;                      // opcode implementations (indexed by opcode index)
+            std::vector<threaded_fused_op>   fused;                    // fused instruction pairs
+            const void*                      sync;                     // set PC/NIP for last instruction of a block
+            const void*                      guard;                    // block boundary inside a trace
+            const void*                      exit;                     // return to caller
+        };
+
+        extern threaded_labels threaded_lbls;
+
+        struct basic_block_trace;
         
         // Basic Block
         struct basic_block {
@@ -90,10 +156,32 @@ namespace ppcsimbooke {
             size_t                           transopscount;
             uint8_t                          brtype;
             opc_impl_func_t*                 synthops;
+            threaded_op*                     threadops;                // direct threaded code
+            ppcsimbooke_jit::jit_block_func_t jitcode;                 // native code ( built once block is hot )
+            size_t                           jitsize;
+            ppcsimbooke_aot::aot_block_func_t aotcode;                 // ahead of time translated code ( if any, not owned )
             int                              refcount;
             uint32_t                         hitcount;
             uint64_t                         lastused;                 // last used indicator
             uint64_t                         lasttarget;
+
+            // block chaining ( direct pointers to successor blocks )
+            // links are valid only if chain_gen matches generation number of basic block cache unit.
+            basic_block*                     next_taken;               // successor block at ip_taken
+            basic_block*                     next_not_taken;           // successor block at ip_not_taken
+            uint64_t                         chain_gen;                // generation no. at which links were made
+
+            // branch profile & hot trace starting at this block
+            uint32_t                         taken_count;              // no of exits to ip_taken
+            uint32_t                         not_taken_count;          // no of exits to ip_not_taken
+            basic_block_trace*               trace;                    // trace headed by this block ( owned )
+
+            // tiered execution
+            uint8_t                          tier;                     // current execution tier
+            uint32_t                         tier_hits;                // hits since block was (re)started at lowest tier
+
+            bool                             side_effect_free;         // all instrs only affect registers ( polling loop candidate )
+            uint8_t                          exits;                    // kind of branch ending the block ( BB_EXIT_XXX )
         
             instr_call                       transops[MAX_BB_INS];
            
@@ -109,6 +197,8 @@ namespace ppcsimbooke {
             void reset();
             void reset(const basic_block_ip& ip);
             void use(uint64_t counter) { lastused = counter; }
+            // no of instrs completed before the one at pc ( a faulting instr in this block )
+            size_t ninstrs_before(uint64_t pc) const { return static_cast<size_t>((pc - bip.ip) >> 2); }
 
             // basic block pointer management
             basic_block* clone();                      // clone basic block
@@ -116,11 +206,25 @@ namespace ppcsimbooke {
 
             // Initialize synthops from passed context
             void init_synthops(context &ctx);
+            // Initialize direct threaded code
+            void init_threadops(context &ctx);
+            // append threaded code for this block ( without trailing exit ) to ops. Returns no of entries appended.
+            size_t emit_threadops(context &ctx, threaded_op* ops);
+            // fused pair starting with instr i ( if any )
+            const threaded_fused_op* find_fused(size_t i) const;
             // update branch targets for next basic block
             void update_targets(context& ctx);
 
             // run basic block
             void run(context& ctx);
+            // run basic block using direct threaded engine
+            void run_direct_threaded(context& ctx);
+            // run basic block as native code ( falls back to direct threaded engine till block is hot )
+            void run_jit(context& ctx);
+            // run basic block as native code ( compile it first if required )
+            void run_native(context& ctx);
+            // run ahead of time translated code of basic block
+            void run_aot(context& ctx);
 
             // instruction objects can be inserted directly into the basic block
             basic_block& operator<<(instr_call& ic){
@@ -132,6 +236,38 @@ namespace ppcsimbooke {
         
         std::ostream& operator <<(std::ostream& ostr, const basic_block& bb);
 
+        // Scoped reference to a basic block. Reference is dropped even if block raises an exception,
+        // otherwise it could never be invalidated again.
+        struct basic_block_ref {
+            basic_block*  bb;
+
+            basic_block_ref(basic_block* bb_) : bb(bb_) { bb->acquire(); }
+            ~basic_block_ref() { bb->release(); }
+        };
+
+        //////////////////////////////////////////////////////////////////////////
+        // basic block trace ( superblock )
+        //////////////////////////////////////////////////////////////////////////
+
+        static const size_t   MAX_TRACE_BBS         = 8;       // max basic blocks in a trace
+        static const uint32_t TRACE_HOT_THRESHOLD   = 64;      // hitcount after which a block heads a trace
+
+        // A hot path of chained basic blocks, stitched into a single piece of threaded code.
+        // Block boundaries are guarded, so control leaves the trace (side exit) as soon as
+        // it departs from the recorded path.
+        struct basic_block_trace {
+            basic_block*                     bbs[MAX_TRACE_BBS];       // member blocks ( bbs[0] is the head )
+            size_t                           nbbs;
+            size_t                           exit_pos[MAX_TRACE_BBS];  // index of guard/exit entry of each member
+            threaded_op*                     threadops;
+            uint64_t                         chain_gen;                // valid only while block chains are
+            uint64_t                         hitcount;
+            uint64_t                         side_exits;               // no of times trace was left early
+
+            basic_block_trace() : nbbs(0), threadops(NULL), chain_gen(0), hitcount(0), side_exits(0) {}
+            ~basic_block_trace() { if(threadops) delete[] threadops; }
+        };
+
         ///////////////////////////////////////////////////////////////////////////////////////////
         // basic block page cache / cache
         ///////////////////////////////////////////////////////////////////////////////////////////
@@ -194,8 +330,10 @@ namespace ppcsimbooke {
         };
 
         // basic block page cache
+        // Key manager is named explicitly, as uint64_t isn't W64 ( unsigned long long ) on every host
         typedef superstl::SelfHashtable<uint64_t, basic_block_chunk_list,
-                BB_PAGE_CACHE_SIZE, basic_block_chunk_list_hash_table_link_manager> basic_block_page_cache;
+                BB_PAGE_CACHE_SIZE, basic_block_chunk_list_hash_table_link_manager,
+                superstl::HashtableKeyManager<superstl::W64, BB_PAGE_CACHE_SIZE> > basic_block_page_cache;
 
         // basic block cache
         typedef superstl::SelfHashtable<basic_block_ip, basic_block,
@@ -240,11 +378,13 @@ namespace ppcsimbooke {
             
             void reset();
             int  fillbuff(context &ctx, uint8_t* insn_buff, int insn_buffsize);
+            int  fillbuff(uint8_t* insn_buff, int insn_buffsize, int nvalid);    // instrs are already in insn_buff ( offline decoding )
     
             bool invalidate();
             bool decode();
             bool flush();
             void split();
+            void elim_dead_flags();                                // drop CR0/XER[CA] updates nobody reads
             bool first_insn_in_bb() { return (uint64_t(ip_decoded) == uint64_t(bb.bip.ip)); }
         };
 
@@ -266,17 +406,79 @@ namespace ppcsimbooke {
             bool         invalidate(const basic_block_ip& b_ip, int reason);     // invalidate
             bool         invalidate(basic_block* bb, int reason);                // invalidate basic block
             bool         invalidate_page(uint64_t mfn, int reason);              // invalidate all basic blocks in a page
+            bool         invalidate_range(uint64_t ra, size_t size, int reason); // invalidate basic blocks overlapping physical range
             size_t       get_page_bb_count(uint64_t mfn);                        // get number of basic blocks for a physical page
             void         flush();                                                // flush all caches
             void         reclaim();                                              // reclaim memory by trashing least recently used entries
+            void         unchain() { m_chain_gen++; }                            // break all block chains ( on context changes )
+                                                                                 // ( return address stack & indirect target cache too )
+            void         set_aot_image(const ppcsimbooke_aot::aot_image* img) {  // use native code of img for blocks in it
+                flush();
+                m_aot = img;
+            }
+            uint64_t     get_chain_gen() const { return m_chain_gen; }
+            bool         is_code_page(uint64_t mfn) const {                      // if page may contain translated code
+                return m_code_pages.test((mfn >> MIN_PGSZ_SHIFT) & (CODE_PAGE_FILTER_SIZE - 1));
+            }
+
+            basic_block_trace* get_trace(context& ctx, basic_block* bb);         // get ( or form ) hot trace headed by bb
+            size_t       run_trace(context& ctx, basic_block_trace* tr);         // run trace. Returns no of instrs executed
 
             // constructors & destructors
-            basic_block_cache_unit()  {}
+            basic_block_cache_unit() : m_last_bb(NULL), m_chain_gen(1), m_aot(NULL), m_ras_top(0) {
+                memset(m_ras, 0, sizeof(m_ras));
+                memset(m_itc, 0, sizeof(m_itc));
+            }
             ~basic_block_cache_unit() { flush(); }
 
             private:
+            basic_block*              lookup(context& ctx);                      // full lookup ( or translation ) of current context
+            void                      reap();                                    // free invalidated blocks which were released since
+            void                      chain(basic_block* from, uint64_t pc, basic_block* to);  // link from's successor at pc
+
             basic_block_cache         m_bb_cache;
             basic_block_page_cache    m_bb_page_cache;
+            basic_block*              m_last_bb;                                 // last translated block ( chain source )
+            uint64_t                  m_chain_gen;                               // chain generation number
+            const ppcsimbooke_aot::aot_image*  m_aot;                            // ahead of time translated image ( if any )
+
+            // Blocks invalidated while in use ( a store by the running block itself to it's own page or
+            // to a member of running trace ). They are already out of all caches, but are freed only
+            // after they are released ( on next translation ).
+            std::vector<basic_block*> m_dirty_bbs;
+
+            // Return address stack.
+            // Pushed with the calling block on every call, popped on every return. A return to the fall
+            // through of the caller follows caller's not taken link, so returns are chained no matter how
+            // many call sites a function has. Entries ( like chains ) are valid only for their generation.
+            struct ras_entry {
+                basic_block*          caller;
+                uint64_t              chain_gen;
+            };
+            static const size_t       RAS_SIZE = 32;                             // power of 2 ( wraps around on overflow )
+            ras_entry                 m_ras[RAS_SIZE];
+            size_t                    m_ras_top;
+
+            // Indirect target cache.
+            // Direct mapped on ( branch ip, target ), for bcctr ( switch tables, function pointers ) & returns
+            // the return address stack misses.
+            struct itc_entry {
+                uint64_t              src;                                       // address of branch instr
+                uint64_t              target;
+                basic_block*          bb;
+                uint64_t              chain_gen;
+            };
+            static const size_t       ITC_SIZE = 1024;                           // power of 2
+            itc_entry                 m_itc[ITC_SIZE];
+
+            static size_t             itc_index(uint64_t src, uint64_t target) {
+                return ((src >> 2) ^ (target >> 2) ^ (target >> 12)) & (ITC_SIZE - 1);
+            }
+
+            // Filter of physical pages with translated code ( hashed on page no ).
+            // Lets stores to data pages skip the page cache lookup altogether.
+            static const size_t       CODE_PAGE_FILTER_SIZE = 64*1024;
+            std::bitset<CODE_PAGE_FILTER_SIZE>  m_code_pages;
         };
     
     }
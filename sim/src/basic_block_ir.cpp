@@ -0,0 +1,310 @@
+#include "basic_block_ir.h"
+#include <algorithm>
+
+#define IR_BIT(r)          (1U << ((r) & 0x1f))
+
+// Classify a call frame
+void ppcsimbooke::ppcsimbooke_basic_block::basic_block_ir::classify(ppcsimbooke::ppcsimbooke_basic_block::ir_op& op,
+        ppcsimbooke::instr_call* ic){
+    // rD = f(rA, rB)
+    static const char* alu3_tbl[] = { "add", "subf", "and", "andc", "or", "orc", "xor", "nor", "nand", "eqv",
+                                      "slw", "srw", "mullw", "mulhw", "mulhwu", "rlwnm" };
+    // rD = f(rA)
+    static const char* alu2_tbl[] = { "neg", "extsb", "extsh", "cntlzw", "rlwinm" };
+
+    op.ic       = ic;
+    op.kind     = IR_OTHER;
+    op.pure     = false;
+    op.abs      = false;
+    op.rd       = -1;
+    op.ra       = -1;
+    op.imm      = 0;
+    op.uses     = 0xffffffff;
+    op.defs     = 0xffffffff;
+    op.use_args = 0;
+
+    // Pseudo ops keep name of instr they replaced
+    const ppcsimbooke::ppcsimbooke_dis::ppc_opc_variant* v = ppcsimbooke::ppcsimbooke_dis::ppcdis::get_opc_variant(*ic);
+    bool        ir   = (v && v->form == ppcsimbooke::ppcsimbooke_dis::OPF_IR);
+    std::string name = (ir) ? std::string(v->name) : ic->opcname;
+    bool        rc   = (name.size() > 1 && name[name.size()-1] == '.');
+    std::string base = (rc) ? name.substr(0, name.size()-1) : name;
+    size_t      a0   = ic->arg[0].v, a1 = ic->arg[1].v, a2 = ic->arg[2].v, a3 = ic->arg[3].v;
+
+    if(ir){
+        size_t c = name.find(":abs");
+        if(c != std::string::npos){ base = name.substr(0, c); op.abs = true; }
+    }
+
+    if(name == "ir:nop"){
+        op.kind = IR_NOP; op.pure = true; op.uses = op.defs = 0;
+    }else if(name == "ir:li"){
+        op.kind = IR_LI; op.pure = true; op.rd = a0; op.imm = ic->arg[IR_ARG].v;
+        op.uses = 0; op.defs = IR_BIT(a0);
+    }else if(name == "addi" || name == "addis"){
+        // same values as RTL ( results are sign extended )
+        int32_t addend = (name == "addi") ? static_cast<int16_t>(a2) : (static_cast<int32_t>(static_cast<int16_t>(a2)) << 16);
+        op.pure = true; op.rd = a0; op.defs = IR_BIT(a0);
+        if(a1 == 0){
+            op.kind = IR_LI; op.imm = static_cast<uint64_t>(static_cast<int64_t>(addend)); op.uses = 0;
+        }else{
+            op.kind = IR_ADDI; op.ra = a1; op.imm = static_cast<uint32_t>(addend);
+            op.uses = IR_BIT(a1); op.use_args = (1 << 1);
+        }
+    }else if(name == "ori" || name == "oris"){
+        op.kind = IR_ORI; op.pure = true; op.rd = a0; op.ra = a1;
+        op.imm  = (name == "ori") ? static_cast<uint16_t>(a2) : (static_cast<uint32_t>(static_cast<uint16_t>(a2)) << 16);
+        op.uses = IR_BIT(a1); op.defs = IR_BIT(a0); op.use_args = (1 << 1);
+    }else if(name == "or" && a1 == a2){
+        op.kind = IR_MR; op.pure = true; op.rd = a0; op.ra = a1;
+        op.uses = IR_BIT(a1); op.defs = IR_BIT(a0); op.use_args = (1 << 1) | (1 << 2);
+    }else if(opc_in_tbl(alu3_tbl, base)){
+        op.kind = IR_ALU; op.pure = !rc; op.rd = a0;
+        op.uses = IR_BIT(a1) | IR_BIT(a2); op.defs = IR_BIT(a0); op.use_args = (1 << 1) | (1 << 2);
+    }else if(opc_in_tbl(alu2_tbl, base)){
+        op.kind = IR_ALU; op.pure = !rc; op.rd = a0;
+        op.uses = IR_BIT(a1); op.defs = IR_BIT(a0); op.use_args = (1 << 1);
+    }else if(base == "rlwimi"){
+        op.kind = IR_ALU; op.pure = !rc; op.rd = a0;
+        op.uses = IR_BIT(a0) | IR_BIT(a1); op.defs = IR_BIT(a0); op.use_args = (1 << 1);     // rA is written too
+    }else if((name == "cmp" || name == "cmpl") && a1 == 0){
+        op.kind = IR_CMP; op.uses = IR_BIT(a2) | IR_BIT(a3); op.defs = 0; op.use_args = (1 << 2) | (1 << 3);
+    }else if((name == "cmpi" || name == "cmpli") && a1 == 0){
+        op.kind = IR_CMP; op.uses = IR_BIT(a2); op.defs = 0; op.use_args = (1 << 2);
+    }else if(base == "lbz" || base == "lhz" || base == "lha" || base == "lwz"){
+        op.kind = IR_LOAD; op.rd = a0; op.defs = IR_BIT(a0);
+        if(op.abs){
+            op.imm = ic->arg[IR_ARG].v; op.uses = 0;
+        }else{
+            op.imm  = static_cast<uint64_t>(static_cast<int64_t>(static_cast<int16_t>(a1)));
+            op.ra   = (a2) ? static_cast<int>(a2) : -1;
+            op.uses = (a2) ? IR_BIT(a2) : 0;
+            op.use_args = (a2) ? (1 << 2) : 0;
+        }
+    }else if(base == "stb" || base == "sth" || base == "stw"){
+        op.kind = IR_STORE; op.defs = 0; op.uses = IR_BIT(a0); op.use_args = (1 << 0);
+        if(op.abs){
+            op.imm = ic->arg[IR_ARG].v;
+        }else{
+            op.imm  = static_cast<uint64_t>(static_cast<int64_t>(static_cast<int16_t>(a1)));
+            op.ra   = (a2) ? static_cast<int>(a2) : -1;
+            if(a2){ op.uses |= IR_BIT(a2); op.use_args |= (1 << 2); }
+        }
+    }
+}
+
+// Build IR for a basic block
+void ppcsimbooke::ppcsimbooke_basic_block::basic_block_ir::build(ppcsimbooke::ppcsimbooke_basic_block::basic_block& bb){
+    LOG_DEBUG4(MSG_FUNC_START);
+
+    nops = bb.transopscount;
+    for(size_t i=0; i<nops; i++){
+        classify(ops[i], &bb.transops[i]);
+    }
+
+    LOG_DEBUG4(MSG_FUNC_END);
+}
+
+// Replace op by ir:li
+inline void ppcsimbooke::ppcsimbooke_basic_block::basic_block_ir::lower_li(ppcsimbooke::ppcsimbooke_basic_block::ir_op& op,
+        uint64_t value, ppcsimbooke::ppcsimbooke_dis::ppcdis& dis){
+    op.ic->arg[IR_ARG].v = value;
+    if(dis.retarget(*op.ic, "ir:li")){
+        classify(op, op.ic);
+        nchanged++;
+    }
+}
+
+// Constant propagation.
+// Tracks GPRs holding known constants. Instrs computing a constant from them become ir:li, and
+// loads/stores from a known base use an absolute address.
+// NOTE : Values are computed exactly like RTL does ( 32 bit ops, sign/zero extended to 64 bits ).
+void ppcsimbooke::ppcsimbooke_basic_block::basic_block_ir::const_prop(ppcsimbooke::ppcsimbooke_dis::ppcdis& dis){
+    LOG_DEBUG4(MSG_FUNC_START);
+
+    uint32_t known = 0;
+    uint64_t val[32];
+
+    for(size_t i=0; i<nops; i++){
+        ir_op& op = ops[i];
+        bool   ka = (op.ra >= 0 && (known & IR_BIT(op.ra)));
+
+        switch(op.kind){
+            case IR_ADDI:
+                if(ka){ lower_li(op, static_cast<uint64_t>(static_cast<int64_t>(static_cast<int32_t>(
+                                     static_cast<uint32_t>(val[op.ra]) + static_cast<uint32_t>(op.imm)))), dis); }
+                break;
+            case IR_ORI:
+                if(ka){ lower_li(op, static_cast<uint32_t>(val[op.ra]) | static_cast<uint32_t>(op.imm), dis); }
+                break;
+            case IR_MR:
+                if(ka){ lower_li(op, static_cast<uint32_t>(val[op.ra]), dis); }      // or zero extends
+                break;
+            case IR_LOAD:
+            case IR_STORE:
+                if(ka){
+                    std::string name = std::string(op.ic->opcname).substr(0, 3) + ":abs";
+                    op.ic->arg[IR_ARG].v = static_cast<uint32_t>(static_cast<uint32_t>(val[op.ra]) + static_cast<uint32_t>(op.imm));
+                    if(dis.retarget(*op.ic, name)){
+                        classify(op, op.ic);
+                        nchanged++;
+                    }
+                }
+                break;
+        }
+
+        // Record results
+        known &= ~op.defs;
+        if(op.kind == IR_LI){
+            known |= IR_BIT(op.rd);
+            val[op.rd] = op.imm;
+        }
+    }
+
+    LOG_DEBUG4(MSG_FUNC_END);
+}
+
+// Copy propagation.
+// After rD = rA ( mr ), later reads of rD read rA instead, till either of them is written again.
+// Only instrs which read lower 32 bits of their operands are understood by IR, so it doesn't matter
+// that mr zero extends.
+// NOTE : r0 is never propagated, since as base register it means literal 0.
+void ppcsimbooke::ppcsimbooke_basic_block::basic_block_ir::copy_prop(){
+    LOG_DEBUG4(MSG_FUNC_START);
+
+    int copy_of[32];
+    for(int r=0; r<32; r++){ copy_of[r] = -1; }
+
+    for(size_t i=0; i<nops; i++){
+        ir_op& op = ops[i];
+
+        if(op.kind == IR_OTHER){
+            for(int r=0; r<32; r++){ copy_of[r] = -1; }
+            continue;
+        }
+
+        // Rewrite reads
+        bool changed = false;
+        for(int a=0; a<N_IC_ARGS; a++){
+            if(!(op.use_args & (1 << a))){ continue; }
+            int r = static_cast<int>(op.ic->arg[a].v & 0x1f);
+            if(copy_of[r] >= 0){
+                op.ic->arg[a].v = copy_of[r];
+                changed = true;
+            }
+        }
+        if(changed){
+            classify(op, op.ic);
+            nchanged++;
+        }
+
+        // Forget copies which are overwritten
+        for(int r=0; r<32; r++){
+            if((op.defs & IR_BIT(r)) || (copy_of[r] >= 0 && (op.defs & IR_BIT(copy_of[r])))){
+                copy_of[r] = -1;
+            }
+        }
+        if(op.kind == IR_MR && op.ra != 0 && op.ra != op.rd){
+            copy_of[op.rd] = op.ra;
+        }
+    }
+
+    LOG_DEBUG4(MSG_FUNC_END);
+}
+
+// Redundant load elimination.
+// A value reloaded from same stack slot ( r1 based ) while an earlier load of it is still in a
+// register, is copied from that register ( mr ) instead. Stores & anything not understood
+// forget all loads. Only zero extending loads are handled, since mr zero extends too.
+// NOTE : Only r1 based loads are handled, since only they are sure not to hit a device.
+void ppcsimbooke::ppcsimbooke_basic_block::basic_block_ir::elim_redundant_loads(ppcsimbooke::ppcsimbooke_dis::ppcdis& dis){
+    LOG_DEBUG4(MSG_FUNC_START);
+
+    struct avail_load { std::string name; uint64_t disp; int rd; };
+    avail_load avail[MAX_BB_INS];
+    size_t     navail = 0;
+
+    for(size_t i=0; i<nops; i++){
+        ir_op& op = ops[i];
+
+        if(op.kind == IR_OTHER || op.kind == IR_STORE){
+            navail = 0;
+            continue;
+        }
+
+        if(op.kind == IR_LOAD && op.ra == 1 && op.ic->opcname != "lha"){
+            for(size_t k=0; k<navail; k++){
+                if(avail[k].name == op.ic->opcname && avail[k].disp == op.imm){
+                    int rs = avail[k].rd;
+                    if(dis.retarget(*op.ic, "or")){
+                        op.ic->arg[1].v = op.ic->arg[2].v = rs;
+                        op.ic->argt |= (1 << 1) | (1 << 2);
+                        classify(op, op.ic);
+                        nchanged++;
+                    }
+                    break;
+                }
+            }
+        }
+
+        // Forget loads whose value or base is overwritten
+        size_t n = 0;
+        for(size_t k=0; k<navail; k++){
+            if(!(op.defs & (IR_BIT(avail[k].rd) | IR_BIT(1)))){ avail[n++] = avail[k]; }
+        }
+        navail = n;
+
+        if(op.kind == IR_LOAD && op.ra == 1 && op.rd != 1 && op.ic->opcname != "lha"){
+            avail[navail].name = op.ic->opcname;
+            avail[navail].disp = op.imm;
+            avail[navail].rd   = op.rd;
+            navail++;
+        }
+    }
+
+    LOG_DEBUG4(MSG_FUNC_END);
+}
+
+// Dead register elimination.
+// Walks the block backwards tracking live GPRs. Pure instrs whose result is overwritten before
+// anybody reads it become ir:nop. All GPRs are live at block exit & at instrs which can fault.
+void ppcsimbooke::ppcsimbooke_basic_block::basic_block_ir::elim_dead_regs(ppcsimbooke::ppcsimbooke_dis::ppcdis& dis){
+    LOG_DEBUG4(MSG_FUNC_START);
+
+    uint32_t live = 0xffffffff;
+
+    for(size_t i=nops; i-- > 0; ){
+        ir_op& op = ops[i];
+
+        if(op.kind == IR_OTHER || op.kind == IR_LOAD || op.kind == IR_STORE){
+            live = 0xffffffff;
+            continue;
+        }
+        if(op.pure && op.defs && !(op.defs & live)){
+            if(dis.retarget(*op.ic, "ir:nop")){
+                classify(op, op.ic);
+                nchanged++;
+            }
+            continue;
+        }
+        live = (live & ~op.defs) | op.uses;
+    }
+
+    LOG_DEBUG4(MSG_FUNC_END);
+}
+
+// Run all passes
+void ppcsimbooke::ppcsimbooke_basic_block::basic_block_ir::optimize(ppcsimbooke::ppcsimbooke_basic_block::basic_block& bb,
+        ppcsimbooke::ppcsimbooke_dis::ppcdis& dis){
+    LOG_DEBUG4(MSG_FUNC_START);
+
+    build(bb);
+    const_prop(dis);
+    elim_redundant_loads(dis);
+    copy_prop();
+    elim_dead_regs(dis);
+
+    LOG_DEBUG4(MSG_FUNC_END);
+}
+
+#undef IR_BIT
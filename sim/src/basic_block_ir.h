@@ -0,0 +1,74 @@
+#ifndef BASIC_BLOCK_IR_H_
+#define BASIC_BLOCK_IR_H_
+
+#include "basic_block.h"
+
+namespace ppcsimbooke {
+    namespace ppcsimbooke_basic_block {
+
+        //////////////////////////////////////////////////////////////////////////
+        // block local IR
+        //////////////////////////////////////////////////////////////////////////
+        //
+        // A view of a decoded basic block which knows which GPRs each instr reads & writes.
+        // Passes work on this view and rewrite call frames of the block in place ( operands or
+        // handler, see BLOCK IR PSEUDO OPS in cpu_ppc_instr.cc ), so every execution tier picks
+        // up the result. Instrs are never removed or reordered. A dropped instr still occupies
+        // it's slot ( as ir:nop ), so instr counts & precise PCs are not affected.
+        //
+        // Anything not understood by IR is a barrier. Loads & stores are barriers for dead
+        // register elimination too, since an exception handler can look at any register.
+
+        // IR op kinds
+        enum {
+            IR_OTHER,             // not understood
+            IR_NOP,               // dropped instr
+            IR_LI,                // rD = constant ( li, lis, ir:li )
+            IR_ADDI,              // rD = rA + imm ( addi, addis )
+            IR_ORI,               // rD = rA | imm ( ori, oris )
+            IR_MR,                // rD = rA ( or rD,rA,rA )
+            IR_ALU,               // other 32 bit integer op on GPRs
+            IR_CMP,               // 32 bit compare
+            IR_LOAD,              // D form load ( lbz, lhz, lha, lwz & their :abs forms )
+            IR_STORE,             // D form store ( stb, sth, stw & their :abs forms )
+        };
+
+        static const int IR_ARG = N_IC_ARGS - 1;           // call frame argument for constants ( IR_CONST in RTL )
+
+        struct ir_op {
+            instr_call*     ic;
+            int             kind;
+            bool            pure;             // only effect is writing rd ( can be dropped if rd is dead )
+            bool            abs;              // load/store from constant address ( imm )
+            int             rd;               // GPR written ( -1 if none )
+            int             ra;               // source GPR of LI/ADDI/ORI/MR, base GPR of loads/stores ( -1 if none )
+            uint64_t        imm;              // constant of LI, addend of ADDI, mask of ORI, displacement/address of loads/stores
+            uint32_t        uses;             // GPRs read ( bitmask )
+            uint32_t        defs;             // GPRs written ( bitmask )
+            uint8_t         use_args;         // call frame arguments which name GPRs read ( bitmask )
+        };
+
+        struct basic_block_ir {
+            ir_op           ops[MAX_BB_INS];
+            size_t          nops;
+            size_t          nchanged;         // no of call frames rewritten
+
+            basic_block_ir() : nops(0), nchanged(0) {}
+
+            void build(basic_block& bb);
+            void optimize(basic_block& bb, ppcsimbooke_dis::ppcdis& dis);      // build & run all passes
+
+            // passes
+            void const_prop(ppcsimbooke_dis::ppcdis& dis);                     // constant propagation & folding
+            void copy_prop();                                                   // copy propagation
+            void elim_redundant_loads(ppcsimbooke_dis::ppcdis& dis);           // reuse values reloaded from stack
+            void elim_dead_regs(ppcsimbooke_dis::ppcdis& dis);                 // drop instrs whose result is never read
+
+            private:
+            void classify(ir_op& op, instr_call* ic);
+            void lower_li(ir_op& op, uint64_t value, ppcsimbooke_dis::ppcdis& dis);
+        };
+    }
+}
+
+#endif
@@ -47,6 +47,11 @@ bool ppcsimbooke::ppcsimbooke_cpu::breakpt_mngr::check_pc(uint64_t pc){
     return true;
 }
 
+// If there is any breakpoint at all ( enabled or not )
+bool ppcsimbooke::ppcsimbooke_cpu::breakpt_mngr::has_breakpoints(){
+    return !m_bk_map.empty();
+}
+
 // Add breakpoint
 void ppcsimbooke::ppcsimbooke_cpu::breakpt_mngr::add_breakpoint(uint64_t ea){
     LOG_DEBUG4(MSG_FUNC_START);
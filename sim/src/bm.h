@@ -54,6 +54,8 @@ namespace ppcsimbooke {
             void clear_last_breakpoint();
             // check adddress for any hit
             bool check_pc(uint64_t pc);
+            // If there is any breakpoint at all
+            bool has_breakpoints();
             // Add breakpoint
             void add_breakpoint(uint64_t ea);
             // List all breakpoints
@@ -11,6 +11,8 @@
 #include <list>
 #include <map>
 #include <unordered_map>
+#include <unordered_set>
+#include <type_traits>
 #include <tuple>
 #include <bitset>
 #include <string>
@@ -6,6 +6,9 @@ size_t                         ppcsimbooke::ppcsimbooke_cpu::cpu::sm_ncpus = 0;
 Log<1>                         ppcsimbooke::ppcsimbooke_cpu::cpu::sm_instr_tracer;         // Instruction tracer
 std::map<uint64_t, std::pair<bool, uint8_t> >
                                ppcsimbooke::ppcsimbooke_cpu::cpu::sm_resv_map;             // This keeps track of global reservation map
+std::vector<ppcsimbooke::ppcsimbooke_cpu::cpu::ppc_opc_fun_ptr>
+                               ppcsimbooke::ppcsimbooke_cpu::cpu::sm_ppc_func_tbl;         // opcode handler table (shared by all cpus)
+std::vector<const char*>       ppcsimbooke::ppcsimbooke_cpu::cpu::sm_ppc_func_names;       // RTL function names of handlers
 
 
 // CPU Member function definitions -----------------------------------
@@ -36,8 +39,10 @@ void ppcsimbooke::ppcsimbooke_cpu::cpu::init(uint64_t cpuid, std::string name){
 }
 
 void ppcsimbooke::ppcsimbooke_cpu::cpu::register_mem(ppcsimbooke_memory::memory &mem){
-    if(m_mem_ptr == NULL)
-        m_mem_ptr = &mem;
+    if(m_mem_ptr == NULL){
+        m_mem_ptr    = &mem;
+        m_mem_writes = mem.add_writer();
+    }
 }
 
 size_t ppcsimbooke::ppcsimbooke_cpu::cpu::get_ninstrs(){
@@ -71,6 +76,9 @@ void ppcsimbooke::ppcsimbooke_cpu::cpu::run_basic_blocks_b(){
 
     // change cpu mode to running
     m_cpu_mode = CPU_MODE_RUNNING;
+    update_instrumentation();
+    stlb_flush();                          // host may have changed translations while cpu was stopped
+    m_pending_except.pending = false;      // faults of host accesses are never delivered to guest
     static const size_t n_basic_blocks_per_pass = 50;
 
     // get first timing & clear all counters
@@ -87,15 +95,55 @@ void ppcsimbooke::ppcsimbooke_cpu::cpu::run_basic_blocks_b(){
             try {
                 // Run this much instructions before checking for other conditions
                 for(size_t i=0; i<n_basic_blocks_per_pass; i++){
+                    bb = NULL;
                     bb = m_bb_cache_unit.translate(*this);
-                    bb->run(*this);
+                    if unlikely(bb == NULL){
+                        // Instruction fetch faulted
+                        deliver_exception();
+                        continue;
+                    }
+                    if(m_cpu_exec_mode == CPU_EXEC_MODE_DIRECT_THREADED){
+                        // Run hot trace starting here ( if any )
+                        ppcsimbooke::ppcsimbooke_basic_block::basic_block_trace* tr = m_bb_cache_unit.get_trace(*this, bb);
+                        if(tr){
+                            account_instrs(m_bb_cache_unit.run_trace(*this, tr));
+                            if unlikely(exception_pending()){
+                                deliver_exception();
+                            }
+                            continue;
+                        }
+                        bb->run_direct_threaded(*this);
+                    }else if(m_cpu_exec_mode == CPU_EXEC_MODE_JIT){
+                        bb->run_jit(*this);
+                    }else if(m_cpu_exec_mode == CPU_EXEC_MODE_TIERED){
+                        run_tiered(bb);
+                    }else if(m_cpu_exec_mode == CPU_EXEC_MODE_AOT){
+                        // code which wasn't translated ( or was modified since ) is interpreted
+                        if likely(bb->aotcode){ bb->run_aot(*this);            }
+                        else                  { bb->run_direct_threaded(*this); }
+                    }else{
+                        bb->run(*this);
+                    }
                     //std::cout << *bb << std::endl;
-                    m_ninstrs_last += bb->transopscount;
+                    if unlikely(exception_pending()){
+                        // Block was cut short. Count only instrs before faulting one.
+                        account_instrs(bb->ninstrs_before(PPCSIMBOOKE_CPU_PC));
+                        demote_block(bb);
+                        deliver_exception();
+                        continue;
+                    }
+                    account_instrs(bb->transopscount);
+
+                    // Same block again ?
+                    if unlikely(bb->side_effect_free && PPCSIMBOOKE_CPU_PC == bb->bip.ip){
+                        check_spin(bb);
+                    }
                 }
             }
-            // FIXME : TODO : Exceptions are not supported at this time. This catch block
-            //                is here just for sake of completeness.
+            // Guest exceptions are delivered above. Only exceptions thrown from outside
+            // the RTL ( for eg. illegal opcodes found by decoder ) reach here.
             catch(sim_except_ppc& e){
+                demote_block(bb);
                 ppc_exception(e.err_code0(), e.err_code1(), e.addr());
             }
 
@@ -111,6 +159,7 @@ void ppcsimbooke::ppcsimbooke_cpu::cpu::run_basic_blocks_b(){
 
     loop_exit_0:
     m_cpu_mode = CPU_MODE_STOPPED;
+    m_cpu_regs.sync_flags();      // make CR/XER visible to outside world
 
     m_ninstrs += m_ninstrs_last;  // update total instrs cnt
 
@@ -130,7 +179,12 @@ void ppcsimbooke::ppcsimbooke_cpu::cpu::run(){
     switch(m_cpu_exec_mode){
         case CPU_EXEC_MODE_INTERPRETIVE : { boost::thread thr0(&ppcsimbooke::ppcsimbooke_cpu::cpu::run_b, this); }
                                           break;
-        case CPU_EXEC_MODE_THREADED     : { boost::thread thr0(&ppcsimbooke::ppcsimbooke_cpu::cpu::run_basic_blocks_b, this); }
+        case CPU_EXEC_MODE_THREADED     :
+        case CPU_EXEC_MODE_DIRECT_THREADED :
+        case CPU_EXEC_MODE_JIT          :
+        case CPU_EXEC_MODE_TIERED       :
+        case CPU_EXEC_MODE_AOT          :
+                                          { boost::thread thr0(&ppcsimbooke::ppcsimbooke_cpu::cpu::run_basic_blocks_b, this); }
                                           break;
         default                         : LTHROW(sim_except_fatal("Wrong execution mode."), DEBUG4);
     }
@@ -150,13 +204,16 @@ void ppcsimbooke::ppcsimbooke_cpu::cpu::step(size_t instr_cnt){
 
     std::pair<uint64_t, bool> last_bkpt = m_bm.last_breakpoint();
     m_cpu_mode = CPU_MODE_STEPPING;
+    update_instrumentation();
+    stlb_flush();                          // host may have changed translations while cpu was stopped
+    m_pending_except.pending = false;      // faults of host accesses are never delivered to guest
 
     clear_ctrs();
 
     // run this instruction if this was last breakpointed
     if(last_bkpt.first == PPCSIMBOOKE_CPU_PC and last_bkpt.second == true){
         m_bm.disable_breakpoints();
-        run_curr_instr();
+        account_instrs(run_curr_instr());
         instr_cnt--;                  // decrement instr count
         m_bm.clear_last_breakpoint();
         m_bm.enable_breakpoints();
@@ -166,13 +223,14 @@ void ppcsimbooke::ppcsimbooke_cpu::cpu::step(size_t instr_cnt){
 
     for(t=0; t<instr_cnt; t++){
         try{
-            I;
+            account_instrs(I);
         }
         catch(sim_except_ppc& e){
             sim_except_ppc(e.err_code0(), e.err_code1(), e.addr());
         }
     }
     m_cpu_mode = CPU_MODE_STOPPED;
+    m_cpu_regs.sync_flags();      // make CR/XER visible to outside world
 
     m_ninstrs += m_ninstrs_last;
 #undef I
@@ -210,6 +268,10 @@ void ppcsimbooke::ppcsimbooke_cpu::cpu::exec_mode(){
     switch(m_cpu_exec_mode){
         case CPU_EXEC_MODE_INTERPRETIVE : std::cout << "Interpretive Mode." << std::endl; break;
         case CPU_EXEC_MODE_THREADED     : std::cout << "Threaded Mode."     << std::endl; break;
+        case CPU_EXEC_MODE_DIRECT_THREADED : std::cout << "Direct Threaded Mode." << std::endl; break;
+        case CPU_EXEC_MODE_JIT          : std::cout << "JIT Mode."          << std::endl; break;
+        case CPU_EXEC_MODE_TIERED       : std::cout << "Tiered Mode."       << std::endl; break;
+        case CPU_EXEC_MODE_AOT          : std::cout << "AOT Mode."          << std::endl; break;
         default                         : std::cout << "Unknown Mode."      << std::endl; break;
     }
     LOG_DEBUG4(MSG_FUNC_END);
@@ -223,6 +285,193 @@ void ppcsimbooke::ppcsimbooke_cpu::cpu::set_exec_mode_threaded(){
     m_cpu_exec_mode = CPU_EXEC_MODE_THREADED;
 }
 
+void ppcsimbooke::ppcsimbooke_cpu::cpu::set_exec_mode_direct_threaded(){
+    m_cpu_exec_mode = CPU_EXEC_MODE_DIRECT_THREADED;
+}
+
+void ppcsimbooke::ppcsimbooke_cpu::cpu::set_exec_mode_jit(){
+    LOG_DEBUG4(MSG_FUNC_START);
+    LASSERT_THROW_UNLIKELY(ppcsimbooke::ppcsimbooke_jit::x86_64_jit::host_supported(),
+            sim_except(SIM_EXCEPT_ENOEXEC, "JIT mode is not supported on this host"), DEBUG4);
+    m_cpu_exec_mode = CPU_EXEC_MODE_JIT;
+    LOG_DEBUG4(MSG_FUNC_END);
+}
+
+void ppcsimbooke::ppcsimbooke_cpu::cpu::set_exec_mode_tiered(){
+    m_cpu_exec_mode = CPU_EXEC_MODE_TIERED;
+}
+
+void ppcsimbooke::ppcsimbooke_cpu::cpu::set_exec_mode_aot(){
+    LOG_DEBUG4(MSG_FUNC_START);
+    LASSERT_THROW_UNLIKELY(m_aot_image.loaded(), sim_except(SIM_EXCEPT_EINVAL, "No translated code loaded ( see load_aot() )"), DEBUG4);
+    m_cpu_exec_mode = CPU_EXEC_MODE_AOT;
+    LOG_DEBUG4(MSG_FUNC_END);
+}
+
+// Translate code of loaded elf file ahead of time
+size_t ppcsimbooke::ppcsimbooke_cpu::cpu::aot_translate(std::string sofile){
+    LOG_DEBUG4(MSG_FUNC_START);
+    size_t n = ppcsimbooke::ppcsimbooke_aot::aot_translator::translate(*this, sofile);
+    LOG_DEBUG4(MSG_FUNC_END);
+    return n;
+}
+
+// Load translated code. Blocks translated so far are dropped, so they pick it up when they
+// are translated again.
+void ppcsimbooke::ppcsimbooke_cpu::cpu::load_aot(std::string sofile){
+    LOG_DEBUG4(MSG_FUNC_START);
+    m_bb_cache_unit.set_aot_image(NULL);
+    m_aot_image.load(sofile);
+    m_bb_cache_unit.set_aot_image(&m_aot_image);
+    LOG_DEBUG4(MSG_FUNC_END);
+}
+
+void ppcsimbooke::ppcsimbooke_cpu::cpu::unload_aot(){
+    LOG_DEBUG4(MSG_FUNC_START);
+    m_bb_cache_unit.set_aot_image(NULL);
+    m_aot_image.unload();
+    if(m_cpu_exec_mode == CPU_EXEC_MODE_AOT){ m_cpu_exec_mode = CPU_EXEC_MODE_DIRECT_THREADED; }
+    LOG_DEBUG4(MSG_FUNC_END);
+}
+
+void ppcsimbooke::ppcsimbooke_cpu::cpu::set_tier_threshold(int tier, uint32_t hits){
+    LOG_DEBUG4(MSG_FUNC_START);
+    LASSERT_THROW_UNLIKELY(tier > ppcsimbooke::ppcsimbooke_basic_block::BB_TIER_INTERPRETIVE &&
+                           tier < ppcsimbooke::ppcsimbooke_basic_block::BB_TIER_COUNT,
+            sim_except(SIM_EXCEPT_EINVAL, "Invalid tier"), DEBUG4);
+    m_tier_threshold[tier] = hits;
+    LOG_DEBUG4(MSG_FUNC_END);
+}
+
+uint32_t ppcsimbooke::ppcsimbooke_cpu::cpu::get_tier_threshold(int tier){
+    LOG_DEBUG4(MSG_FUNC_START);
+    LASSERT_THROW_UNLIKELY(tier >= 0 && tier < ppcsimbooke::ppcsimbooke_basic_block::BB_TIER_COUNT,
+            sim_except(SIM_EXCEPT_EINVAL, "Invalid tier"), DEBUG4);
+    LOG_DEBUG4(MSG_FUNC_END);
+    return m_tier_threshold[tier];
+}
+
+size_t ppcsimbooke::ppcsimbooke_cpu::cpu::get_tier_ninstrs(int tier){
+    LOG_DEBUG4(MSG_FUNC_START);
+    LASSERT_THROW_UNLIKELY(tier >= 0 && tier < ppcsimbooke::ppcsimbooke_basic_block::BB_TIER_COUNT,
+            sim_except(SIM_EXCEPT_EINVAL, "Invalid tier"), DEBUG4);
+    LOG_DEBUG4(MSG_FUNC_END);
+    return m_tier_ninstrs[tier];
+}
+
+uint64_t ppcsimbooke::ppcsimbooke_cpu::cpu::get_spin_idles(){
+    LOG_DEBUG4(MSG_FUNC_START);
+    LOG_DEBUG4(MSG_FUNC_END);
+    return m_nspin_idles;
+}
+
+// Time base ticks till next enabled DEC or FIT interrupt ( UINT64_MAX if none ).
+// A timer interrupt ends a polling loop as well, so an idling cpu mustn't sleep past it.
+uint64_t ppcsimbooke::ppcsimbooke_cpu::cpu::ticks_to_timer_event(){
+    uint64_t tcr   = PPCSIMBOOKE_CPU_REG(REG_TCR);
+    uint64_t dec   = PPCSIMBOOKE_CPU_REG(REG_DEC) & 0xffffffffULL;
+    uint64_t tb    = (PPCSIMBOOKE_CPU_REG(REG_TBRU) << 32) | (PPCSIMBOOKE_CPU_REG(REG_TBRL) & 0xffffffffULL);
+    uint64_t ticks = UINT64_MAX;
+
+    // DEC interrupt on it's 1 -> 0 transition
+    if((tcr & TCR_DIE) && dec){
+        ticks = dec;
+    }
+    // FIT interrupt on 0 -> 1 transition of time base bit selected by TCR[FPEXT] || TCR[FP]
+    // ( 0 selects msb )
+    if(tcr & TCR_FIE){
+        int sel = (((tcr >> 13) & 0xf) << 2) | ((tcr >> 24) & 0x3);
+        int bit = 63 - sel;
+        if(bit < 63){
+            uint64_t period = 1ULL << (bit + 1);
+            uint64_t fit    = ((1ULL << bit) - (tb & (period - 1))) & (period - 1);
+            ticks = min(ticks, (fit) ? fit : period);
+        }
+    }
+    return ticks;
+}
+
+// Polling loop detection.
+// A side effect free block looping back to itself, which leaves register state unchanged while
+// nobody writes memory, will keep doing exactly the same till some other agent ( another cpu or
+// host ) writes memory. After SPIN_DETECT_ITERS such iterations, cpu sleeps till memory changes or
+// it's asked to stop ( or next timer deadline ), instead of running the loop.
+inline void ppcsimbooke::ppcsimbooke_cpu::cpu::check_spin(ppcsimbooke::ppcsimbooke_basic_block::basic_block* bb){
+    spin_state st;
+    m_cpu_regs.sync_flags();
+    for(int i=0; i<32; i++){ st.gpr[i] = PPCSIMBOOKE_CPU_REG(REG_GPR0 + i); }
+    st.cr  = PPCSIMBOOKE_CPU_REG(REG_CR);
+    st.xer = PPCSIMBOOKE_CPU_REG(REG_XER);
+    st.ctr = PPCSIMBOOKE_CPU_REG(REG_CTR);
+    st.lr  = PPCSIMBOOKE_CPU_REG(REG_LR);
+    st.msr = PPCSIMBOOKE_CPU_REG(REG_MSR);
+    uint64_t mem_gen = m_mem_ptr->write_gen();
+
+    if(bb != m_spin_bb || mem_gen != m_spin_mem_gen || memcmp(&st, &m_spin_state, sizeof(spin_state))){
+        m_spin_bb      = bb;
+        m_spin_state   = st;
+        m_spin_mem_gen = mem_gen;
+        m_spin_iters   = 0;
+        return;
+    }
+    if likely(++m_spin_iters < SPIN_DETECT_ITERS){
+        return;
+    }
+
+    // Nothing can change till memory does ( or a timer fires )
+    LOG_DEBUG4("Polling loop at ", std::hex, bb->bip.ip, ". Idling.", std::endl);
+    m_nspin_idles++;
+    uint64_t           ticks = ticks_to_timer_event();
+    boost::system_time now   = boost::get_system_time();
+    boost::system_time end   = (ticks == UINT64_MAX) ? boost::system_time(boost::posix_time::pos_infin) :
+                                   now + boost::posix_time::microseconds(ticks / SPIN_TB_TICKS_PER_US);
+    while(m_mem_ptr->write_gen() == mem_gen && m_cpu_mode == CPU_MODE_RUNNING && now < end){
+        boost::this_thread::sleep(min(now + boost::posix_time::microseconds(SPIN_IDLE_US), end));
+        now = boost::get_system_time();
+    }
+    m_spin_bb = NULL;
+}
+
+// Run a basic block in it's current tier & promote it once it has been hit enough times
+// in lower tiers. Native tier is skipped on hosts without JIT support.
+inline void ppcsimbooke::ppcsimbooke_cpu::cpu::run_tiered(ppcsimbooke::ppcsimbooke_basic_block::basic_block* bb){
+    using namespace ppcsimbooke::ppcsimbooke_basic_block;
+
+    int max_tier = (ppcsimbooke::ppcsimbooke_jit::x86_64_jit::host_supported()) ? BB_TIER_NATIVE : BB_TIER_THREADED;
+
+    if unlikely(bb->tier < max_tier && bb->tier_hits >= m_tier_threshold[bb->tier + 1]){
+        bb->tier++;
+    }
+
+    switch(bb->tier){
+        case BB_TIER_INTERPRETIVE : bb->run(*this);                 break;
+        case BB_TIER_THREADED     : bb->run_direct_threaded(*this); break;
+        default                   : bb->run_native(*this);          break;
+    }
+
+    if unlikely(exception_pending()){
+        return;
+    }
+    bb->tier_hits++;
+    m_tier_ninstrs[bb->tier] += bb->transopscount;
+}
+
+// Blocks raising exceptions fall back to lowest tier ( tiered mode only )
+inline void ppcsimbooke::ppcsimbooke_cpu::cpu::demote_block(ppcsimbooke::ppcsimbooke_basic_block::basic_block* bb){
+    if(m_cpu_exec_mode == CPU_EXEC_MODE_TIERED && bb != NULL){
+        bb->tier      = ppcsimbooke::ppcsimbooke_basic_block::BB_TIER_INTERPRETIVE;
+        bb->tier_hits = 0;
+    }
+}
+
+// Stores to translated code ( self modifying code ) drop all blocks covering stored bytes.
+// They will be retranslated ( starting again at lowest tier ) on next execution.
+inline void ppcsimbooke::ppcsimbooke_cpu::cpu::check_code_write(uint64_t ra, size_t size){
+    if unlikely(m_bb_cache_unit.is_code_page(ra & MIN_PGSZ_MASK)){
+        m_bb_cache_unit.invalidate_range(ra, size, ppcsimbooke::ppcsimbooke_basic_block::INVALIDATE_REASON_DIRTY);
+    }
+}
+
 // virtual form of run_instr
 // Seems like c++ doesn't have an very effective way of handling non POD objects
 //  with variadic arg funcs
@@ -231,7 +480,12 @@ void ppcsimbooke::ppcsimbooke_cpu::cpu::run_instr(std::string instr){
     instr_call call_this;
 
     call_this = m_dis.disasm(instr, PPCSIMBOOKE_CPU_PC);
-    m_ppc_func_hash.at(call_this.hv)(this, &call_this);
+    LASSERT_THROW_UNLIKELY(call_this.fptr != NULL, sim_except(SIM_EXCEPT_EINVAL, "No implementation for " + call_this.opcname), DEBUG4);
+    call_this.fptr(this, &call_this);
+    m_cpu_regs.sync_flags();
+    if unlikely(exception_pending()){
+        throw_pending_exception();
+    }
     LOG_DEBUG4(MSG_FUNC_END);
 }
 
@@ -241,20 +495,43 @@ void ppcsimbooke::ppcsimbooke_cpu::cpu::run_instr(uint32_t opcd){
     instr_call call_this;
 
     call_this = m_dis.disasm(opcd, PPCSIMBOOKE_CPU_PC);
-    m_ppc_func_hash.at(call_this.hv)(this, &call_this);
+    LASSERT_THROW_UNLIKELY(call_this.fptr != NULL, sim_except(SIM_EXCEPT_EINVAL, "No implementation for " + call_this.opcname), DEBUG4);
+    call_this.fptr(this, &call_this);
+    m_cpu_regs.sync_flags();
+    if unlikely(exception_pending()){
+        throw_pending_exception();
+    }
     LOG_DEBUG4(MSG_FUNC_END);
 }
 
 // get opcode implementation function
+// NOTE : Lower 32 bits of opcode hash is the index of opcode in ppc opcode table.
+//        Decoded instrs already carry their handler in instr_call::fptr, so this is only
+//        needed for call frames which were not generated by a disassembler.
 ppcsimbooke::ppcsimbooke_cpu::cpu::ppc_opc_fun_ptr ppcsimbooke::ppcsimbooke_cpu::cpu::get_opc_impl(uint64_t opcode_hash){
     LOG_DEBUG4(MSG_FUNC_START);
+    ppc_opc_fun_ptr fptr = sm_ppc_func_tbl.at(opcode_hash & 0xffffffffULL);
+    LASSERT_THROW_UNLIKELY(fptr != NULL, sim_except(SIM_EXCEPT_EINVAL, "No implementation for this opcode."), DEBUG4);
     LOG_DEBUG4(MSG_FUNC_END);
-    return m_ppc_func_hash.at(opcode_hash);
+    return fptr;
+}
+
+// register opcode handler ( & name of it's RTL function ) in opcode handler table
+// NOTE : Opcodes which are not there in current dialect are silently skipped
+//        ( get_opc_index() already warns about them ).
+void ppcsimbooke::ppcsimbooke_cpu::cpu::set_opc_impl(std::string opcname, const char* func_name, ppc_opc_fun_ptr fptr){
+    int indx = m_dis.get_opc_index(opcname);
+    if unlikely(indx < 0 || indx >= static_cast<int>(sm_ppc_func_tbl.size())){
+        return;
+    }
+    sm_ppc_func_tbl[indx]   = fptr;
+    sm_ppc_func_names[indx] = func_name;
 }
 
 #define TO_RWX(r, w, x) (((r & 0x1) << 2) | ((w & 0x1) << 1) | (x & 0x1))
 // Translate EA to RA
-// NOTE: All exceptions ( hardware/software ) will be handled at run_instr() or run() level.
+// NOTE: TLB misses & access faults are only raised here ( see raise_exception() ) & delivered
+//       at run_instr() or run() level. Callers must check exception_pending().
 ppcsimbooke::ppcsimbooke_cpu::cpu::xlated_tlb_res ppcsimbooke::ppcsimbooke_cpu::cpu::xlate(uint64_t addr, bool wr, bool ex){
     LOG_DEBUG4(MSG_FUNC_START);
 
@@ -264,7 +541,7 @@ ppcsimbooke::ppcsimbooke_cpu::cpu::xlated_tlb_res ppcsimbooke::ppcsimbooke_cpu::
 
     xlated_tlb_res res;
     uint8_t  perm = ((wr) ? TO_RWX(0, 1, 0) : TO_RWX(1, 0, 0)) | TO_RWX(0, 0, ex);
-    bool as = EBF(PPCSIMBOOKE_CPU_REG(REG_MSR), MSR_DS);
+    bool as = (ex) ? EBF(PPCSIMBOOKE_CPU_REG(REG_MSR), MSR_IS) : EBF(PPCSIMBOOKE_CPU_REG(REG_MSR), MSR_DS);   // fetches use MSR[IS]
     bool pr = EBF(PPCSIMBOOKE_CPU_REG(REG_MSR), MSR_PR);
 
     // Try hits with PID0, PID1 and PID2
@@ -272,111 +549,229 @@ ppcsimbooke::ppcsimbooke_cpu::cpu::xlated_tlb_res ppcsimbooke::ppcsimbooke_cpu::
     res = m_l2tlb.xlate(addr, as, PPCSIMBOOKE_CPU_REG(REG_PID1), perm, pr); if(std::get<0>(res) != static_cast<uint64_t>(-1)) goto exit_loop_0; 
     res = m_l2tlb.xlate(addr, as, PPCSIMBOOKE_CPU_REG(REG_PID2), perm, pr); if(std::get<0>(res) != static_cast<uint64_t>(-1)) goto exit_loop_0;
 
-    // We encountered TLB miss. Throw exceptions. Also pass the faulting address as part of exception class
+    // We encountered TLB miss. Raise exceptions. Also pass the faulting address along.
     if(ex){
         LOG_DEBUG4("ITLB miss.");
-        LTHROW(sim_except_ppc(PPC_EXCEPTION_ITLB, PPC_EXCEPT_ITLB_MISS, "ITLB miss.", addr), DEBUG4);
-    }else{
-        LOG_DEBUG4("DTLB miss.");
-    }
-
-    if(wr){
-        LTHROW(sim_except_ppc(PPC_EXCEPTION_DTLB, PPC_EXCEPT_DTLB_MISS_ST, "DTLB miss on store.", addr), DEBUG4);
+        raise_exception(PPC_EXCEPTION_ITLB, PPC_EXCEPT_ITLB_MISS, addr);
+    }else if(wr){
+        LOG_DEBUG4("DTLB miss on store.");
+        raise_exception(PPC_EXCEPTION_DTLB, PPC_EXCEPT_DTLB_MISS_ST, addr);
     }else{
-        LTHROW(sim_except_ppc(PPC_EXCEPTION_DTLB, PPC_EXCEPT_DTLB_MISS_LD, "DTLB miss on load.", addr), DEBUG4);
+        LOG_DEBUG4("DTLB miss on load.");
+        raise_exception(PPC_EXCEPTION_DTLB, PPC_EXCEPT_DTLB_MISS_LD, addr);
     }
+    LOG_DEBUG4(MSG_FUNC_END);
+    return res;
 
     exit_loop_0:
+    // Entry was found, but access isn't permitted
+    if unlikely(std::get<0>(res) == ppcsimbooke_tlb::tlb::XLATE_PERM_FAULT){
+        if(ex)     { raise_exception(PPC_EXCEPTION_ISI, PPC_EXCEPT_ISI_ACS,   addr); }
+        else if(wr){ raise_exception(PPC_EXCEPTION_DSI, PPC_EXCEPT_DSI_ACS_W, addr); }
+        else       { raise_exception(PPC_EXCEPTION_DSI, PPC_EXCEPT_DSI_ACS_R, addr); }
+        LOG_DEBUG4(MSG_FUNC_END);
+        return res;
+    }
     LOG_DEBUG4(std::hex, std::showbase, "Xlation : ", addr, " -> ", std::get<0>(res), std::endl);
     LOG_DEBUG4(MSG_FUNC_END);
     return res;
 }
 
-// Get register pointer using regid
-// TODO : Check Permissions
-inline ppcsimbooke::ppc_reg64* ppcsimbooke::ppcsimbooke_cpu::cpu::reg(int regid){
-    return m_cpu_regs.m_ireg.at(regid);
-}
-
 // Get register pointer using reg name
 inline ppcsimbooke::ppc_reg64* ppcsimbooke::ppcsimbooke_cpu::cpu::regn(std::string regname){
+    m_cpu_regs.sync_flags();
     return m_cpu_regs.m_reg.at(regname);
 }
 
+// Soft tlb lookup for a data access at addr, which doesn't cross a 4K page ( see m_stlb ).
+// A miss goes through xlate() & fills the entry. Returns NULL if translation faulted ( exception is pending ).
+inline ppcsimbooke::ppcsimbooke_cpu::cpu::stlb_entry* ppcsimbooke::ppcsimbooke_cpu::cpu::stlb_xlate(uint64_t addr, bool wr){
+    uint64_t    msr = PPCSIMBOOKE_CPU_REG(REG_MSR);
+    uint64_t    tag = (addr & MIN_PGSZ_MASK) | (EBF(msr, MSR_DS) << 1) | EBF(msr, MSR_PR);
+    stlb_entry* e   = &m_stlb[wr][(addr >> MIN_PGSZ_SHIFT) & (STLB_SIZE - 1)];
+
+    if likely(e->tag == tag && e->gen == m_stlb_gen){
+        return e;
+    }
+
+    xlated_tlb_res res = xlate(addr, wr);
+    if unlikely(exception_pending()){ return NULL; }
+
+    LASSERT_THROW_UNLIKELY(m_mem_ptr != NULL, sim_except_fatal("no memory module registered."), DEBUG4);
+
+    e->tag    = tag;
+    e->gen    = m_stlb_gen;
+    e->ra     = std::get<0>(res) & MIN_PGSZ_MASK;
+    e->host   = const_cast<uint8_t*>(m_mem_ptr->host_ptr(e->ra));
+    e->endian = (std::get<1>(res) & 0x1);
+    return e;
+}
+
+// Accesses crossing a 4K page. Both pages are translated before any byte is accessed ( so a
+// fault on second page leaves memory untouched ) & each part goes through it's own host page.
+// Byte order is that of first page.
+template<typename T>
+T ppcsimbooke::ppcsimbooke_cpu::cpu::read_split(uint64_t addr){
+    uint8_t     buff[sizeof(T)];
+    size_t      n  = MIN_PGSZ - (addr & ~MIN_PGSZ_MASK);          // bytes in first page
+    stlb_entry  e0;
+
+    stlb_entry* e = stlb_xlate(addr, 0);
+    if unlikely(e == NULL){ return 0; }
+    e0 = *e;
+    e = stlb_xlate(addr + n, 0);
+    if unlikely(e == NULL){ return 0; }
+
+    memcpy(buff, e0.host + (addr & ~MIN_PGSZ_MASK), n);
+    memcpy(buff + n, e->host, sizeof(T) - n);
+    return ::read_buff<T>(buff, e0.endian);
+}
+
+template<typename T>
+void ppcsimbooke::ppcsimbooke_cpu::cpu::write_split(uint64_t addr, T value){
+    uint8_t     buff[sizeof(T)];
+    size_t      n  = MIN_PGSZ - (addr & ~MIN_PGSZ_MASK);          // bytes in first page
+    stlb_entry  e0;
+
+    stlb_entry* e = stlb_xlate(addr, 1);
+    if unlikely(e == NULL){ return; }
+    e0 = *e;
+    e = stlb_xlate(addr + n, 1);
+    if unlikely(e == NULL){ return; }
+
+    ::write_buff<T>(buff, value, e0.endian);
+    memcpy(e0.host + (addr & ~MIN_PGSZ_MASK), buff, n);
+    memcpy(e->host, buff + n, sizeof(T) - n);
+    m_mem_writes->bump();
+    check_code_write(e0.ra | (addr & ~MIN_PGSZ_MASK), n);
+    check_code_write(e->ra, sizeof(T) - n);
+}
+
 // Memory I/O functions
-uint8_t ppcsimbooke::ppcsimbooke_cpu::cpu::read8(uint64_t addr){
+#define CPU_LOAD(type, addr)                                                                       \
+    if unlikely(((addr) & ~MIN_PGSZ_MASK) + sizeof(type) > MIN_PGSZ){                             \
+        LOG_DEBUG4(MSG_FUNC_END);                                                                  \
+        return read_split<type>(addr);                                                             \
+    }                                                                                              \
+    stlb_entry* e = stlb_xlate(addr, 0);                                                           \
+    if unlikely(e == NULL){ LOG_DEBUG4(MSG_FUNC_END); return 0; }                                  \
+    LOG_DEBUG4(MSG_FUNC_END);                                                                      \
+    return ::read_buff<type>(e->host + (addr & ~MIN_PGSZ_MASK), e->endian)
+
+#define CPU_STORE(type, addr, value)                                                               \
+    if unlikely(((addr) & ~MIN_PGSZ_MASK) + sizeof(type) > MIN_PGSZ){                             \
+        write_split<type>(addr, value);                                                            \
+        LOG_DEBUG4(MSG_FUNC_END);                                                                  \
+        return;                                                                                    \
+    }                                                                                              \
+    stlb_entry* e = stlb_xlate(addr, 1);                                                           \
+    if unlikely(e == NULL){ LOG_DEBUG4(MSG_FUNC_END); return; }                                    \
+    ::write_buff<type>(e->host + (addr & ~MIN_PGSZ_MASK), value, e->endian);                         \
+    m_mem_writes->bump();                                                                          \
+    check_code_write(e->ra | (addr & ~MIN_PGSZ_MASK), sizeof(type));                               \
+    LOG_DEBUG4(MSG_FUNC_END)
+
+uint8_t ppcsimbooke::ppcsimbooke_cpu::cpu::rtl_read8(uint64_t addr){
     LOG_DEBUG4(MSG_FUNC_START);
-    xlated_tlb_res res = xlate(addr, 0);
- 
-    LASSERT_THROW_UNLIKELY(m_mem_ptr != NULL, sim_except_fatal("no memory module registered."), DEBUG4);
+    stlb_entry* e = stlb_xlate(addr, 0);
+    if unlikely(e == NULL){ LOG_DEBUG4(MSG_FUNC_END); return 0; }
     LOG_DEBUG4(MSG_FUNC_END);
-    return m_mem_ptr->read8(std::get<0>(res), (std::get<1>(res) & 0x1));
+    return e->host[addr & ~MIN_PGSZ_MASK];
 }
 
-void ppcsimbooke::ppcsimbooke_cpu::cpu::write8(uint64_t addr, uint8_t value){
+void ppcsimbooke::ppcsimbooke_cpu::cpu::rtl_write8(uint64_t addr, uint8_t value){
     LOG_DEBUG4(MSG_FUNC_START);
-    xlated_tlb_res res = xlate(addr, 1);
-
-    LASSERT_THROW_UNLIKELY(m_mem_ptr != NULL, sim_except_fatal("no memory module registered."), DEBUG4);
-    m_mem_ptr->write8(std::get<0>(res), value, (std::get<1>(res) & 0x1));
+    stlb_entry* e = stlb_xlate(addr, 1);
+    if unlikely(e == NULL){ LOG_DEBUG4(MSG_FUNC_END); return; }
+    e->host[addr & ~MIN_PGSZ_MASK] = value;
+    m_mem_writes->bump();
+    check_code_write(e->ra | (addr & ~MIN_PGSZ_MASK), sizeof(uint8_t));
     LOG_DEBUG4(MSG_FUNC_END);
 }
 
-uint16_t ppcsimbooke::ppcsimbooke_cpu::cpu::read16(uint64_t addr){
+uint16_t ppcsimbooke::ppcsimbooke_cpu::cpu::rtl_read16(uint64_t addr){
     LOG_DEBUG4(MSG_FUNC_START);
-    xlated_tlb_res res = xlate(addr, 0);
+    CPU_LOAD(uint16_t, addr);
+}
 
-    LASSERT_THROW_UNLIKELY(m_mem_ptr != NULL, sim_except_fatal("no memory module registered."), DEBUG4);
-    LOG_DEBUG4(MSG_FUNC_END);
-    return m_mem_ptr->read16(std::get<0>(res), (std::get<1>(res) & 0x1));
+void ppcsimbooke::ppcsimbooke_cpu::cpu::rtl_write16(uint64_t addr, uint16_t value){
+    LOG_DEBUG4(MSG_FUNC_START);
+    CPU_STORE(uint16_t, addr, value);
 }
 
+uint32_t ppcsimbooke::ppcsimbooke_cpu::cpu::rtl_read32(uint64_t addr){
+    LOG_DEBUG4(MSG_FUNC_START);
+    CPU_LOAD(uint32_t, addr);
+}
 
-void ppcsimbooke::ppcsimbooke_cpu::cpu::write16(uint64_t addr, uint16_t value){
+void ppcsimbooke::ppcsimbooke_cpu::cpu::rtl_write32(uint64_t addr, uint32_t value){
     LOG_DEBUG4(MSG_FUNC_START);
-    xlated_tlb_res res = xlate(addr, 1);
+    CPU_STORE(uint32_t, addr, value);
+}
 
-    LASSERT_THROW_UNLIKELY(m_mem_ptr != NULL, sim_except_fatal("no memory module registered."), DEBUG4);
-    m_mem_ptr->write16(std::get<0>(res), value, (std::get<1>(res) & 0x1));
-    LOG_DEBUG4(MSG_FUNC_END);
+uint64_t ppcsimbooke::ppcsimbooke_cpu::cpu::rtl_read64(uint64_t addr){
+    LOG_DEBUG4(MSG_FUNC_START);
+    CPU_LOAD(uint64_t, addr);
 }
 
-uint32_t ppcsimbooke::ppcsimbooke_cpu::cpu::read32(uint64_t addr){
+void ppcsimbooke::ppcsimbooke_cpu::cpu::rtl_write64(uint64_t addr, uint64_t value){
     LOG_DEBUG4(MSG_FUNC_START);
-    xlated_tlb_res res = xlate(addr, 0);
+    CPU_STORE(uint64_t, addr, value);
+}
 
-    LASSERT_THROW_UNLIKELY(m_mem_ptr != NULL, sim_except_fatal("no memory module registered."), DEBUG4);
-    LOG_DEBUG4(MSG_FUNC_END);
-    return m_mem_ptr->read32(std::get<0>(res), (std::get<1>(res) & 0x1));
+#undef CPU_LOAD
+#undef CPU_STORE
+
+// Host side accessors. Faults are thrown as sim_except_ppc ( like run_instr() does ) instead of
+// being left pending, where next run would deliver them to guest.
+// Host may have changed registers ( PID, MSR ) or memory targets since last access, which soft tlb
+// entries don't track, so they are dropped first.
+#define CPU_HOST_LOAD(bits, addr)                                                                  \
+    stlb_flush();                                                                                  \
+    uint##bits##_t value = rtl_read##bits(addr);                                                   \
+    if unlikely(exception_pending()){ throw_pending_exception(); }                                 \
+    return value
+
+#define CPU_HOST_STORE(bits, addr, value)                                                          \
+    stlb_flush();                                                                                  \
+    rtl_write##bits(addr, value);                                                                  \
+    if unlikely(exception_pending()){ throw_pending_exception(); }
+
+uint8_t ppcsimbooke::ppcsimbooke_cpu::cpu::read8(uint64_t addr){
+    CPU_HOST_LOAD(8, addr);
 }
 
-void ppcsimbooke::ppcsimbooke_cpu::cpu::write32(uint64_t addr, uint32_t value){
-    LOG_DEBUG4(MSG_FUNC_START);
-    xlated_tlb_res res = xlate(addr, 1);
+void ppcsimbooke::ppcsimbooke_cpu::cpu::write8(uint64_t addr, uint8_t value){
+    CPU_HOST_STORE(8, addr, value);
+}
 
-    LASSERT_THROW_UNLIKELY(m_mem_ptr != NULL, sim_except_fatal("no memory module registered."), DEBUG4);
-    m_mem_ptr->write32(std::get<0>(res), value, (std::get<1>(res) & 0x1));
-    LOG_DEBUG4(MSG_FUNC_END);
+uint16_t ppcsimbooke::ppcsimbooke_cpu::cpu::read16(uint64_t addr){
+    CPU_HOST_LOAD(16, addr);
 }
 
-uint64_t ppcsimbooke::ppcsimbooke_cpu::cpu::read64(uint64_t addr){
-    LOG_DEBUG4(MSG_FUNC_START);
-    xlated_tlb_res res = xlate(addr, 0);
+void ppcsimbooke::ppcsimbooke_cpu::cpu::write16(uint64_t addr, uint16_t value){
+    CPU_HOST_STORE(16, addr, value);
+}
 
-    LASSERT_THROW_UNLIKELY(m_mem_ptr != NULL, sim_except_fatal("no memory module registered."), DEBUG4);
-    LOG_DEBUG4(MSG_FUNC_END);
-    return m_mem_ptr->read64(std::get<0>(res), (std::get<1>(res) & 0x1));
+uint32_t ppcsimbooke::ppcsimbooke_cpu::cpu::read32(uint64_t addr){
+    CPU_HOST_LOAD(32, addr);
 }
 
-void ppcsimbooke::ppcsimbooke_cpu::cpu::write64(uint64_t addr, uint64_t value){
-    LOG_DEBUG4(MSG_FUNC_START);
-    xlated_tlb_res res = xlate(addr, 1);
+void ppcsimbooke::ppcsimbooke_cpu::cpu::write32(uint64_t addr, uint32_t value){
+    CPU_HOST_STORE(32, addr, value);
+}
 
-    LASSERT_THROW_UNLIKELY(m_mem_ptr != NULL, sim_except_fatal("no memory module registered."), DEBUG4);
-    m_mem_ptr->write64(std::get<0>(res), value, (std::get<1>(res) & 0x1));
-    LOG_DEBUG4(MSG_FUNC_END);
+uint64_t ppcsimbooke::ppcsimbooke_cpu::cpu::read64(uint64_t addr){
+    CPU_HOST_LOAD(64, addr);
+}
+
+void ppcsimbooke::ppcsimbooke_cpu::cpu::write64(uint64_t addr, uint64_t value){
+    CPU_HOST_STORE(64, addr, value);
 }
 
+#undef CPU_HOST_LOAD
+#undef CPU_HOST_STORE
+
 size_t ppcsimbooke::ppcsimbooke_cpu::cpu::read_buff(uint64_t addr, uint8_t* buff, size_t buffsize, bool ex){
     LOG_DEBUG4(MSG_FUNC_START);
 
@@ -388,15 +783,15 @@ size_t ppcsimbooke::ppcsimbooke_cpu::cpu::read_buff(uint64_t addr, uint8_t* buff
     LASSERT_THROW_UNLIKELY(m_mem_ptr != NULL, sim_except_fatal("no memory module registered."), DEBUG4);
     
     while(rem_buffsize > 0){
-        // We may encounter tlb misses here
-        try{
-            res = xlate(addr, 0, ex);      // translate this address
-        }catch(sim_except_ppc& e){
-            switch(e.err_code<0>()){
+        // We may encounter tlb misses here. They only end the read & aren't delivered.
+        res = xlate(addr, 0, ex);      // translate this address
+        if unlikely(exception_pending()){
+            switch(m_pending_except.exception_nr){
                 case PPC_EXCEPTION_ITLB :
                 case PPC_EXCEPTION_DTLB : break;
                 default                 : throw(sim_except_fatal("Unexpected exception in read_buff() !!"));
             }
+            m_pending_except.pending = false;
 
             LOG_DEBUG4(MSG_FUNC_END);
             return buffsize - rem_buffsize;   // returning data size read
@@ -405,7 +800,7 @@ size_t ppcsimbooke::ppcsimbooke_cpu::cpu::read_buff(uint64_t addr, uint8_t* buff
         ps = std::get<2>(res);         // get page_size & page_mask
         pm = ~(ps - 1);
         size_curr_page = min(rem_buffsize, ((addr & pm) + ps - addr));
-        m_mem_ptr->read_to_buffer(addr, buff, size_curr_page);
+        m_mem_ptr->read_to_buffer(std::get<0>(res), buff, size_curr_page);     // read from real address
         buff         += size_curr_page;
         rem_buffsize -= size_curr_page;
         addr         += size_curr_page;
@@ -590,7 +985,7 @@ void ppcsimbooke::ppcsimbooke_cpu::cpu::ppc_exception(int exception_nr, int subt
             // Is FPU there in e500v2 ??
             break;
         case  PPC_EXCEPTION_SC:
-            PPCSIMBOOKE_CPU_REG(REG_SRR0) = PPCSIMBOOKE_CPU_PC;
+            PPCSIMBOOKE_CPU_REG(REG_SRR0) = PPCSIMBOOKE_CPU_PC + 4;      // sc is done, return past it
             PPCSIMBOOKE_CPU_REG(REG_SRR1) = PPCSIMBOOKE_CPU_REG(REG_MSR);
 
             CLR_DEFAULT_MSR_BITS();
@@ -826,6 +1221,13 @@ void ppcsimbooke::ppcsimbooke_cpu::cpu::ppc_exception(int exception_nr, int subt
 #undef GET_PC_FROM_IVOR_NUM
 #undef CLR_DEFAULT_MSR_BITS
 
+    // Interpreted instrs advance from NIP ( see RTL_BEGIN in cpu_ppc_instr.cc ), which is still
+    // past the faulting instr.
+    PPCSIMBOOKE_CPU_NIP = PPCSIMBOOKE_CPU_PC;
+
+    // MSR has changed
+    notify_ctxt_switch();
+
     LOG_DEBUG4(MSG_FUNC_END);
 }
 
@@ -851,6 +1253,10 @@ ppcsimbooke::instr_call ppcsimbooke::ppcsimbooke_cpu::cpu::get_instr(){
 
     // Translate program counter to physical address
     res = xlate(PPCSIMBOOKE_CPU_PC, 0, 1);  // wr=0, ex=1
+    if unlikely(exception_pending()){
+        LOG_DEBUG4(MSG_FUNC_END);
+        return call_this;
+    }
 
     LOG_DEBUG4(std::hex, std::showbase, "instr Xlation : ", PPCSIMBOOKE_CPU_PC, " -> ", std::get<0>(res), std::endl);
 
@@ -949,8 +1355,12 @@ void ppcsimbooke::ppcsimbooke_cpu::cpu::run_b(){
 
     std::pair<uint64_t, bool> last_bkpt = m_bm.last_breakpoint();
     m_cpu_mode = CPU_MODE_RUNNING;
+    update_instrumentation();
+    stlb_flush();                          // host may have changed translations while cpu was stopped
+    m_pending_except.pending = false;      // faults of host accesses are never delivered to guest
     static const int n_instrs_per_pass = 100;
     int i;
+    size_t n = 0;                          // completed instrs of current pass
 
     // get first timing & clear all counters
     m_prev_stamp = boost::posix_time::microsec_clock::local_time();
@@ -959,7 +1369,7 @@ void ppcsimbooke::ppcsimbooke_cpu::cpu::run_b(){
     // run this instruction if this was last breakpointed
     if(last_bkpt.first == PPCSIMBOOKE_CPU_PC and last_bkpt.second == true){
         m_bm.disable_breakpoints();
-        run_curr_instr();
+        account_instrs(run_curr_instr());
         m_bm.clear_last_breakpoint();
         m_bm.enable_breakpoints();
     }
@@ -971,15 +1381,20 @@ void ppcsimbooke::ppcsimbooke_cpu::cpu::run_b(){
     try {
         for(;;){
             // Observe each instruction for possible exceptions
+            // Completed instrs are accounted once per pass
+            n = 0;
             try {
                 // Run this much instructions before checking for other conditions
                 for(i=0; i<n_instrs_per_pass; i++){
-                    I;
+                    n += I;
                 }
+                account_instrs(n);
             }
             catch(sim_except_ppc& e){
+                account_instrs(n);     // i'th instr didn't complete
                 ppc_exception(e.err_code0(), e.err_code1(), e.addr());
             }
+            n = 0;
 
             // If running status is changed to stopped/halted, exit out of loop
             if unlikely(m_cpu_mode == CPU_MODE_HALTED or m_cpu_mode == CPU_MODE_STOPPED){
@@ -988,11 +1403,13 @@ void ppcsimbooke::ppcsimbooke_cpu::cpu::run_b(){
         }
     }
     catch(...){
+        account_instrs(n);         // instrs of interrupted pass
         sim_except_ptr = std::current_exception();
     }
 
     loop_exit_0:
     m_cpu_mode = CPU_MODE_STOPPED;
+    m_cpu_regs.sync_flags();      // make CR/XER visible to outside world
 
     m_ninstrs += m_ninstrs_last;  // update total instrs cnt
 
@@ -1011,43 +1428,104 @@ void ppcsimbooke::ppcsimbooke_cpu::cpu::run_b(){
 inline void ppcsimbooke::ppcsimbooke_cpu::cpu::clear_ctrs(){
     LOG_DEBUG4(MSG_FUNC_START);
     m_ninstrs_last = 0;
+    for(int i=0; i<ppcsimbooke::ppcsimbooke_basic_block::BB_TIER_COUNT; i++){ m_tier_ninstrs[i] = 0; }
     LOG_DEBUG4(MSG_FUNC_END);
 }
 
+// Account completed instrs. Execution loops call this once per block/pass.
+// There is no timing model yet, so every instr takes one cycle.
+inline void ppcsimbooke::ppcsimbooke_cpu::cpu::account_instrs(size_t n){
+    m_ninstrs_last += n;
+    m_ncycles      += n;
+}
+
 /*
  * @func : run current instr
+ * @ret  : 1 if instr completed, 0 if it raised an exception ( callers account completed
+ *         instrs, see account_instrs() )
  */
-inline void ppcsimbooke::ppcsimbooke_cpu::cpu::run_curr_instr(){
+inline size_t ppcsimbooke::ppcsimbooke_cpu::cpu::run_curr_instr(){
     LOG_DEBUG4(MSG_FUNC_START);
 
     /* Get Instr call frame at next NIP */
     instr_call call_this = get_instr();
+    if unlikely(exception_pending()){
+        deliver_exception();
+        LOG_DEBUG4(MSG_FUNC_END);
+        return 0;
+    }
     LOG_DEBUG4("INSTR : ", call_this.get_instr_str(), std::endl);
 
     // Trace instructions
     //sm_instr_tracer("DEBUG") << "[CPU_" << (int)m_cpu_no << std::hex << "]\t" << "PC: 0x" << PPCSIMBOOKE_CPU_PC << "\t" << call_this.get_instr_str() << std::endl;
+
+    // Coverage, breakpoints, stepping & debug events
+    if unlikely(m_instrument){
+        instrument_instr(call_this);
+    }
+ 
+    /* call handler function for this call frame ( resolved at decode time ) */
+    LASSERT_THROW_UNLIKELY(call_this.fptr != NULL, sim_except(SIM_EXCEPT_EINVAL, "No implementation for " + call_this.opcname), DEBUG4);
+    call_this.fptr(this, &call_this);
+
+    // Instruction raised an exception
+    if unlikely(exception_pending()){
+        deliver_exception();
+        LOG_DEBUG4(MSG_FUNC_END);
+        return 0;
+    }
+
+    LOG_DEBUG4(MSG_FUNC_END);
+    return 1;
+}
+
+/*
+ * @func : run instrumentation for current instr
+ *         ( only called if any of INSTRUMENT_XXX is active )
+ */
+void ppcsimbooke::ppcsimbooke_cpu::cpu::instrument_instr(instr_call& call_this){
+    LOG_DEBUG4(MSG_FUNC_START);
+
     // Log coverage
-    m_cov_logger.probe(call_this.opcname);
+    if(m_instrument & INSTRUMENT_COV){
+        m_cov_logger.probe(call_this.opcname);
+    }
 
-    if(m_bm.check_pc(PPCSIMBOOKE_CPU_PC)){
+    if((m_instrument & INSTRUMENT_BKPT) && m_bm.check_pc(PPCSIMBOOKE_CPU_PC)){
         // Throw a software breakpoint exception
         LTHROW(sim_except(SIM_EXCEPT_SBKPT, "Software breakpoint"), DEBUG4);
     }
 
     // Do this while stepping
-    if(m_cpu_mode == CPU_MODE_STEPPING){
+    if((m_instrument & INSTRUMENT_STEP) && m_cpu_mode == CPU_MODE_STEPPING){
         std::cout << std::hex << "PC:" <<  PPCSIMBOOKE_CPU_PC << " [ " << call_this.get_instr_str() << " ]" << std::endl;
     }
 
     // Check for any debug events for IAC
     // FIXME : This may not work at this time
-    check_for_dbg_events(DBG_EVENT_IAC);
- 
-    /* call handler function for this call frame */ 
-    m_ppc_func_hash.at(call_this.hv)(this, &call_this);
+    if(m_instrument & INSTRUMENT_DBG_IAC){
+        check_for_dbg_events(DBG_EVENT_IAC);
+    }
 
-    m_ninstrs_last++;
+    LOG_DEBUG4(MSG_FUNC_END);
+}
 
+/*
+ * @func : recompute active instrumentation mask
+ *         Called whenever coverage, breakpoints, stepping or debug registers may have changed
+ *         ( on coverage enable/disable, mtspr to DBCR0 & at start of every run/step ).
+ */
+void ppcsimbooke::ppcsimbooke_cpu::cpu::update_instrumentation(){
+    LOG_DEBUG4(MSG_FUNC_START);
+    uint32_t mask = 0;
+
+    if(m_cov_logger.is_enabled())                                               mask |= INSTRUMENT_COV;
+    if(m_bm.has_breakpoints())                                                  mask |= INSTRUMENT_BKPT;
+    if(m_cpu_mode == CPU_MODE_STEPPING)                                         mask |= INSTRUMENT_STEP;
+    if(PPCSIMBOOKE_CPU_REGMASK(REG_DBCR0, DBCR0_IAC1) ||
+       PPCSIMBOOKE_CPU_REGMASK(REG_DBCR0, DBCR0_IAC2))                          mask |= INSTRUMENT_DBG_IAC;
+
+    m_instrument = mask;
     LOG_DEBUG4(MSG_FUNC_END);
 }
 
@@ -1056,13 +1534,30 @@ inline void ppcsimbooke::ppcsimbooke_cpu::cpu::init_common(){
     LOG_DEBUG4(MSG_FUNC_START);
     m_cpu_no = sm_ncpus++;                 // Increment global cpu cnt
     gen_ppc_opc_func_hash(this);           // Initialize opcode function pointer table
+    m_dis.set_opc_impl_table(sm_ppc_func_tbl.data());   // Let disassembler resolve handlers at decode time
     m_instr_cache.set_size(4096);          // LRU cache size = 4096 instrs
+    m_mem_ptr = NULL;                      // No memory registered yet ( see register_mem() )
+    m_mem_writes = NULL;
     m_ctxt_switch = 0;                     // Initialize flag to zero
+    m_pending_except.pending = false;      // No exception pending
+    m_instrument = 0;                      // No instrumentation active
+    memset(m_stlb, 0, sizeof(m_stlb));     // Soft tlb is empty
+    m_stlb_gen = 1;
+    m_spin_bb = NULL;                      // No polling loop seen yet
+    m_spin_iters = 0;
+    m_nspin_idles = 0;
     m_cpu_mode = CPU_MODE_HALTED;
     m_cpu_exec_mode = CPU_EXEC_MODE_INTERPRETIVE;   // Fix to interpretive mode
+    m_ninstrs = 0;
     m_ncycles = 0;
     m_cpu_bits = 32;                       // 32 bit machine
 
+    // Default tier promotion thresholds ( in hits )
+    m_tier_threshold[ppcsimbooke::ppcsimbooke_basic_block::BB_TIER_INTERPRETIVE] = 0;
+    m_tier_threshold[ppcsimbooke::ppcsimbooke_basic_block::BB_TIER_THREADED]     = 8;
+    m_tier_threshold[ppcsimbooke::ppcsimbooke_basic_block::BB_TIER_NATIVE]       = 64;
+    for(int i=0; i<ppcsimbooke::ppcsimbooke_basic_block::BB_TIER_COUNT; i++){ m_tier_ninstrs[i] = 0; }
+
     // Init logging facilities
     std::ostringstream ostr;
     ostr << "cpu_" << int(m_cpu_no) << "_cov.log";
@@ -1076,6 +1571,7 @@ inline void ppcsimbooke::ppcsimbooke_cpu::cpu::init_common(){
 void ppcsimbooke::ppcsimbooke_cpu::cpu::set_resv(uint64_t ea, size_t size){
     LOG_DEBUG4(MSG_FUNC_START);
     xlated_tlb_res res = xlate(ea, 0);
+    if unlikely(exception_pending()){ LOG_DEBUG4(MSG_FUNC_END); return; }
     m_resv_addr = std::get<0>(res);
     m_resv_set  = true;
     m_resv_size = size;
@@ -1097,6 +1593,7 @@ void ppcsimbooke::ppcsimbooke_cpu::cpu::clear_resv(uint64_t ea){
 bool ppcsimbooke::ppcsimbooke_cpu::cpu::check_resv(uint64_t ea, size_t size){
     LOG_DEBUG4(MSG_FUNC_START);
     xlated_tlb_res res = xlate(ea, 1);  // Reservation is checked during stwcx.
+    if unlikely(exception_pending()){ LOG_DEBUG4(MSG_FUNC_END); return false; }
     uint64_t caddr = std::get<0>(res) & ~(m_cache_line_size - 1);    // Get granule addr
     if(sm_resv_map.find(caddr) == sm_resv_map.end()){
         return false;
@@ -1110,12 +1607,30 @@ bool ppcsimbooke::ppcsimbooke_cpu::cpu::check_resv(uint64_t ea, size_t size){
     return false;
 }
 
+// Deliver pending exception
+void ppcsimbooke::ppcsimbooke_cpu::cpu::deliver_exception(){
+    LOG_DEBUG4(MSG_FUNC_START);
+    m_pending_except.pending = false;
+    ppc_exception(m_pending_except.exception_nr, m_pending_except.subtype, m_pending_except.ea);
+    LOG_DEBUG4(MSG_FUNC_END);
+}
+
+// Throw pending exception ( for callers which expect sim_except_ppc )
+void ppcsimbooke::ppcsimbooke_cpu::cpu::throw_pending_exception(){
+    LOG_DEBUG4(MSG_FUNC_START);
+    m_pending_except.pending = false;
+    LTHROW(sim_except_ppc(m_pending_except.exception_nr, m_pending_except.subtype, "PPC exception", m_pending_except.ea), DEBUG4);
+}
+
 // Notify of context switches. LRU cache uses this parameter to flush it's
-// instruction cache when a context switch happens.
+// instruction cache when a context switch happens. Basic block chains are also
+// broken, since they were made in the previous context.
 void ppcsimbooke::ppcsimbooke_cpu::cpu::notify_ctxt_switch(){
     LOG_DEBUG4(MSG_FUNC_START);
     m_ctxt_switch = 1;
     m_instr_cache.clear();
+    m_bb_cache_unit.unchain();
+    stlb_flush();
     LOG_DEBUG4(MSG_FUNC_END);
 }
 
@@ -1123,6 +1638,7 @@ void ppcsimbooke::ppcsimbooke_cpu::cpu::notify_ctxt_switch(){
 uint64_t ppcsimbooke::ppcsimbooke_cpu::cpu::get_reg(std::string reg_name) throw(sim_except) {
     LOG_DEBUG4(MSG_FUNC_START);
     //if unlikely(m_cpu_regs.m_reg.find(reg_name) == m_cpu_regs.m_reg.end()) throw sim_except(SIM_EXCEPT_EINVAL, "Illegal register name.");
+    m_cpu_regs.sync_flags();
     LOG_DEBUG4(MSG_FUNC_END);
     return PPCSIMBOOKE_CPU_REGN(reg_name);
 }
@@ -1131,6 +1647,7 @@ uint64_t ppcsimbooke::ppcsimbooke_cpu::cpu::get_reg(std::string reg_name) throw(
 uint64_t ppcsimbooke::ppcsimbooke_cpu::cpu::get_reg(int reg_id) throw(sim_except) {
     LOG_DEBUG4(MSG_FUNC_START);
     //if unlikely(m_cpu_regs.m_ireg.find(reg_id) == m_cpu_regs.m_ireg.end()) throw sim_except(SIM_EXCEPT_EINVAL, "Illegal register ID.");
+    m_cpu_regs.sync_flags();
     LOG_DEBUG4(MSG_FUNC_END);
     return PPCSIMBOOKE_CPU_REG(reg_id);
 }
@@ -1140,6 +1657,7 @@ void ppcsimbooke::ppcsimbooke_cpu::cpu::dump_state(std::ostream &ostr){
     LOG_DEBUG4(MSG_FUNC_START);
 
     // print register file state
+    m_cpu_regs.sync_flags();
     ostr << m_cpu_regs;
 
     LOG_DEBUG4(MSG_FUNC_END);
@@ -1155,12 +1673,14 @@ void ppcsimbooke::ppcsimbooke_cpu::cpu::print_L2tlbs(){
 void ppcsimbooke::ppcsimbooke_cpu::cpu::enable_cov_log(){
     LOG_DEBUG4(MSG_FUNC_START);
     m_cov_logger.enable();
+    update_instrumentation();
     LOG_DEBUG4(MSG_FUNC_END);
 }
 
 void ppcsimbooke::ppcsimbooke_cpu::cpu::disable_cov_log(){
     LOG_DEBUG4(MSG_FUNC_START);
     m_cov_logger.disable();
+    update_instrumentation();
     LOG_DEBUG4(MSG_FUNC_END);
 }
 
@@ -1187,5 +1707,141 @@ void ppcsimbooke::ppcsimbooke_cpu::cpu::log_cov_to_file(std::string filename){
 
 // friend function
 void ppcsimbooke::ppcsimbooke_cpu::gen_ppc_opc_func_hash(ppcsimbooke::ppcsimbooke_cpu::cpu *pcpu){
+    // handler table is shared by all cpus. Populate it only once.
+    if(!cpu::sm_ppc_func_tbl.empty()){
+        return;
+    }
+    cpu::sm_ppc_func_tbl.assign(ppcsimbooke::ppcsimbooke_dis::ppcdis::get_num_handlers(), NULL);
+    cpu::sm_ppc_func_names.assign(ppcsimbooke::ppcsimbooke_dis::ppcdis::get_num_handlers(), NULL);
+
     #include "cpu_ppc_instr.cc"
+
+    // Record labels for direct threaded engine too
+    run_threaded_ops(pcpu, NULL);
+}
+
+// Direct threaded engine (friend function)
+//
+// RTL bodies from cpu_ppc_instr.cc are expanded a second time, this time as labelled blocks
+// inside this function. Threaded code ( an array of threaded_op, built by basic_block or
+// basic_block_trace ) is executed by jumping from one body straight to the next one
+// ( GCC's labels as values ).
+//
+// PC/NIP bookkeeping is done once per block. Only the last instruction of a basic block can
+// be a control transfer or context altering instruction ( see basic_block_decoder::decode() ),
+// so PC/NIP are set up ( sync op ) just before it. Others never look at PC/NIP. If an
+// instruction in the middle of the block raises an exception, PC/NIP are restored for that
+// instruction. Guest exceptions are left pending for the caller, others are passed on.
+//
+// Returns pointer to the exit ( or failed guard / faulting ) op at which execution stopped.
+//
+// NOTE : First call (with ops = NULL) only records labels of all opcode implementations
+//        in ppcsimbooke_basic_block::threaded_lbls.
+const ppcsimbooke::ppcsimbooke_basic_block::threaded_op*
+ppcsimbooke::ppcsimbooke_cpu::run_threaded_ops(ppcsimbooke::ppcsimbooke_cpu::cpu *pcpu,
+        const ppcsimbooke::ppcsimbooke_basic_block::threaded_op *ops){
+    using ppcsimbooke::ppcsimbooke_basic_block::threaded_op;
+    using ppcsimbooke::ppcsimbooke_basic_block::threaded_lbls;
+
+    const threaded_op*               top = ops;            // current threaded op
+    ppcsimbooke::instr_call*         ic  = NULL;           // current call frame (IC in RTL)
+    uint64_t                         chain_gen = pcpu->m_bb_cache_unit.get_chain_gen();
+
+    if unlikely(ops == NULL){
+        threaded_lbls.opc.assign(ppcsimbooke::ppcsimbooke_dis::ppcdis::get_num_handlers(), &&__rtl_unimpl__);
+        threaded_lbls.fused.clear();
+        threaded_lbls.sync  = &&__rtl_sync__;
+        threaded_lbls.guard = &&__rtl_guard__;
+        threaded_lbls.exit  = &&__rtl_exit__;
+    }
+
+#define RTL_DISPATCH()                     do { ++top; ic = top->ic; goto *top->lbl; } while(0)
+#define RTL_BEGIN(opc_name, func_name)     {                                                                            \
+                                               int __indx = pcpu->m_dis.get_opc_index(opc_name);                        \
+                                               if(__indx >= 0 && __indx < static_cast<int>(threaded_lbls.opc.size()))   \
+                                                   threaded_lbls.opc[__indx] = &&func_name;                             \
+                                           }                                                                            \
+                                           if(0){ func_name: {
+#define RTL_END                            } RTL_DISPATCH(); }
+#define RTL_EXCEPT_EXIT()                  goto __rtl_except__
+
+    // fused pairs. Registered only if both instrs are known.
+#define RTL_FUSED_ADD(opc_name0, opc_name1, func_name, br)                                                     \
+                                           {                                                                    \
+                                               ppcsimbooke::ppcsimbooke_basic_block::threaded_fused_op __f;     \
+                                               int __i0   = pcpu->m_dis.get_opc_index(opc_name0);               \
+                                               int __i1   = pcpu->m_dis.get_opc_index(opc_name1);               \
+                                               __f.opc0   = opc_name0;                                          \
+                                               __f.opc1   = opc_name1;                                          \
+                                               __f.lbl    = &&func_name;                                        \
+                                               __f.branch = br;                                                 \
+                                               if(__i0 >= 0 && __i0 < static_cast<int>(threaded_lbls.opc.size()) &&          \
+                                                  __i1 >= 0 && __i1 < static_cast<int>(threaded_lbls.opc.size()))            \
+                                                   threaded_lbls.fused.push_back(__f);                          \
+                                           }
+#define RTL_FUSED_BEGIN(opc_name0, opc_name1, func_name)         RTL_FUSED_ADD(opc_name0, opc_name1, func_name, false) \
+                                                                 if(0){ func_name: {
+#define RTL_FUSED_BRANCH_BEGIN(opc_name0, opc_name1, func_name)  RTL_FUSED_ADD(opc_name0, opc_name1, func_name, true)  \
+                                                                 if(0){ func_name: {
+#define RTL_FUSED_NEXT()                   do { ++top; ic = top->ic; } while(0)
+#define RTL_FUSED_SYNC_NEXT()              do { ++top; pcpu->m_cpu_regs.pc  = top->ip;                         \
+                                                       pcpu->m_cpu_regs.nip = top->ip + 4;                     \
+                                                ++top; ic = top->ic; } while(0)
+
+    try {
+        if likely(ops != NULL){
+            ic = top->ic;
+            goto *top->lbl;
+        }
+
+#undef __CPU_PPC_INSTR_RTL
+#include "cpu_ppc_instr.cc"
+
+        // All labels are recorded. Done with first call.
+        return NULL;
+
+        __rtl_unimpl__:
+            LTHROW(sim_except(SIM_EXCEPT_EINVAL, "No implementation for " + ic->opcname), DEBUG4);
+
+        // set PC/NIP for last instruction of a block
+        __rtl_sync__:
+            pcpu->m_cpu_regs.pc  = top->ip;
+            pcpu->m_cpu_regs.nip = top->ip + 4;
+            RTL_DISPATCH();
+
+        // end of a block inside a trace. Continue only if we are going where the trace goes.
+        // Context changes ( unchaining ) end a trace too.
+        __rtl_guard__:
+            pcpu->m_cpu_regs.pc  = pcpu->m_cpu_regs.nip;
+            if unlikely(pcpu->m_cpu_regs.pc != top->ip || pcpu->m_bb_cache_unit.get_chain_gen() != chain_gen){
+                return top;
+            }
+            RTL_DISPATCH();
+
+        __rtl_exit__:
+            pcpu->m_cpu_regs.pc  = pcpu->m_cpu_regs.nip;
+            return top;
+
+        // current instruction raised a guest exception. Restore precise PC/NIP & leave.
+        __rtl_except__:
+            pcpu->m_cpu_regs.pc  = top->ip;
+            pcpu->m_cpu_regs.nip = top->ip + 4;
+            return top;
+    }
+    catch(...){
+        // Restore precise PC/NIP for the faulting instruction
+        if(ic != NULL){
+            pcpu->m_cpu_regs.pc  = top->ip;
+            pcpu->m_cpu_regs.nip = top->ip + 4;
+        }
+        throw;
+    }
+
+#undef RTL_DISPATCH
+#undef RTL_FUSED_ADD
+#undef RTL_FUSED_BEGIN
+#undef RTL_FUSED_BRANCH_BEGIN
+#undef RTL_FUSED_NEXT
+#undef RTL_FUSED_SYNC_NEXT
+    return top;
 }
@@ -32,12 +32,15 @@
 #include "cpu_ppc_coverage.h"        // Coverage logger
 #include "fpu_emul.h"                // floating point emulation
 #include "basic_block.h"             // Basic block decoder & caches module
+#include "jit_x86_64.h"              // x86-64 JIT for basic blocks
+#include "aot.h"                     // ahead of time translation
 
 namespace ppcsimbooke {
     namespace ppcsimbooke_cpu {
 
         class cpu;
         void gen_ppc_opc_func_hash(cpu *pcpu);
+        const ppcsimbooke_basic_block::threaded_op* run_threaded_ops(cpu *pcpu, const ppcsimbooke_basic_block::threaded_op *ops);
 
         // cpu run mode
         enum cpu_run_mode {
@@ -50,12 +53,40 @@ namespace ppcsimbooke {
         enum cpu_exec_mode {
             CPU_EXEC_MODE_INTERPRETIVE = 1,
             CPU_EXEC_MODE_THREADED     = 2,
+            CPU_EXEC_MODE_DIRECT_THREADED = 3,
+            CPU_EXEC_MODE_JIT          = 4,
+            CPU_EXEC_MODE_TIERED       = 5,
+            CPU_EXEC_MODE_AOT          = 6,
+        };
+
+        // Pending ppc exception.
+        // Guest exceptions ( tlb misses, ISI/DSI, program checks, system calls etc. ) are only
+        // recorded when raised. Execution loops check for them at instruction / basic block
+        // boundaries and deliver them, so no C++ unwinding is involved.
+        struct ppc_pending_exception {
+            bool                   pending;
+            int                    exception_nr;
+            int                    subtype;
+            uint64_t               ea;
+
+            ppc_pending_exception() : pending(false), exception_nr(0), subtype(0), ea(0) {}
         };
 
         // Debug events
         static const int DBG_EVENT_IAC     = 0x00000001UL;
         static const int DBG_EVENT_DAC_LD  = 0x00000002UL;
         static const int DBG_EVENT_DAC_ST  = 0x00000004UL;
+
+        // Active instrumentation ( per instruction slow path work in run_curr_instr() )
+        static const uint32_t INSTRUMENT_COV       = 0x00000001UL;    // coverage logging
+        static const uint32_t INSTRUMENT_BKPT      = 0x00000002UL;    // software breakpoints
+        static const uint32_t INSTRUMENT_STEP      = 0x00000004UL;    // stepping
+        static const uint32_t INSTRUMENT_DBG_IAC   = 0x00000008UL;    // instruction address compare debug events
+
+        // Polling loop detection ( see cpu::check_spin() )
+        static const uint32_t SPIN_DETECT_ITERS    = 4;               // identical iterations after which a loop is spinning
+        static const uint32_t SPIN_IDLE_US         = 100;             // host sleep between memory checks while idling
+        static const uint32_t SPIN_TB_TICKS_PER_US = 100;             // time base rate used to turn timer deadlines into host time
         
         /* 64 bit MSRs were used in older powerPC designs */
         /* All BookE cores have 32 bit MSRs only */
@@ -70,19 +101,29 @@ namespace ppcsimbooke {
             //
             // For eg. there is one function for "add", another for "or" and likewise
             //
-            // NOTE : It's the responsibility of this function to populate m_ppc_func_hash and
-            //        it has to be called once in the constructor.
+            // NOTE : It's the responsibility of this function to populate sm_ppc_func_tbl and
+            //        it has to be called once in the constructor. Since all handlers are stateless,
+            //        the table is shared by all cpus and is populated only by the first one.
             friend void gen_ppc_opc_func_hash(ppcsimbooke::ppcsimbooke_cpu::cpu *pcpu);
+            // Direct threaded engine. Expands the same RTL bodies (as labels) inside a single function
+            // and runs threaded code (of a basic block or a trace) using computed gotos.
+            friend const ppcsimbooke::ppcsimbooke_basic_block::threaded_op*
+                run_threaded_ops(ppcsimbooke::ppcsimbooke_cpu::cpu *pcpu, const ppcsimbooke::ppcsimbooke_basic_block::threaded_op *ops);
             // Basic Block [decoder] is cpu's friend
             friend struct ppcsimbooke::ppcsimbooke_basic_block::basic_block_decoder;
             friend struct ppcsimbooke::ppcsimbooke_basic_block::basic_block;
+            // JIT maps guest registers directly
+            friend class ppcsimbooke::ppcsimbooke_jit::x86_64_jit;
+            // Ahead of time translated code runs RTL bodies directly
+            friend struct ppcsimbooke::ppcsimbooke_aot::aot_rtl;
+            friend class ppcsimbooke::ppcsimbooke_aot::aot_translator;
 
             /////////////////////////////////////////////////////////////////////////
             // public typedefs
             /////////////////////////////////////////////////////////////////////////
             public:
             // function pointer type for opcode handlers
-            typedef void (*ppc_opc_fun_ptr)(ppcsimbooke::ppcsimbooke_cpu::cpu *, ppcsimbooke::instr_call *);
+            typedef ppcsimbooke::ppc_opc_fun_ptr ppc_opc_fun_ptr;
             // translated result type for tlb array
             typedef std::tuple<uint64_t, uint8_t, uint64_t>  xlated_tlb_res;
        
@@ -120,6 +161,23 @@ namespace ppcsimbooke {
             void       exec_mode();                         // prints exec mode
             void       set_exec_mode_threaded();            // switch exec mode to threaded execution
             void       set_exec_mode_interpretive();        // switch exec mode to interpretive execution
+            void       set_exec_mode_direct_threaded();     // switch exec mode to direct threaded (basic block) execution
+            void       set_exec_mode_jit();                 // switch exec mode to JIT ( native code for hot basic blocks )
+            void       set_exec_mode_tiered();              // switch exec mode to tiered ( blocks are promoted as they get hot )
+            void       set_exec_mode_aot();                 // switch exec mode to ahead of time translated code ( see load_aot() )
+
+            // ahead of time translation ( see ppcsimbooke_aot )
+            size_t     aot_translate(std::string sofile);   // translate loaded elf into a shared object
+            void       load_aot(std::string sofile);        // use translated code from a shared object
+            void       unload_aot();
+
+            // tiered execution ( tiers are ppcsimbooke_basic_block::BB_TIER_* )
+            void       set_tier_threshold(int tier, uint32_t hits);   // hits after which a block is promoted to tier
+            uint32_t   get_tier_threshold(int tier);
+            size_t     get_tier_ninstrs(int tier);                    // instrs executed in tier ( last run )
+
+            // polling loops
+            uint64_t   get_spin_idles();                              // no of times cpu idled in a polling loop
            
             // Memory (EA) access functions
             //
@@ -131,6 +189,7 @@ namespace ppcsimbooke {
             // to the instruction physical page.
             // NOTE : store to an instruction page always goes through DTLB. ITLB is only used for
             // instruction fetches.
+            // TLB misses & access faults are thrown as sim_except_ppc.
             uint8_t    read8(uint64_t addr);
             void       write8(uint64_t addr, uint8_t value);
             uint16_t   read16(uint64_t addr);
@@ -139,6 +198,18 @@ namespace ppcsimbooke {
             void       write32(uint64_t addr, uint32_t value);
             uint64_t   read64(uint64_t addr);
             void       write64(uint64_t addr, uint64_t value);
+
+            // Same for RTL ( & native code helpers ). These go straight to the soft tlb, which the
+            // host accessors above flush first. Faults aren't thrown, but are left pending
+            // ( see raise_exception() ). Callers must check exception_pending().
+            uint8_t    rtl_read8(uint64_t addr);
+            void       rtl_write8(uint64_t addr, uint8_t value);
+            uint16_t   rtl_read16(uint64_t addr);
+            void       rtl_write16(uint64_t addr, uint16_t value);
+            uint32_t   rtl_read32(uint64_t addr);
+            void       rtl_write32(uint64_t addr, uint32_t value);
+            uint64_t   rtl_read64(uint64_t addr);
+            void       rtl_write64(uint64_t addr, uint64_t value);
             
             // Read memory buffer.
             // It can read instruction as well as data pages.
@@ -158,6 +229,9 @@ namespace ppcsimbooke {
 
             // get opcode implementation function pointer
             ppc_opc_fun_ptr  get_opc_impl(uint64_t opcode_hash);
+
+            // if a guest exception was raised & not yet delivered
+            bool       exception_pending() const { return m_pending_except.pending; }
         
             // Logging functions
             void       enable_cov_log();
@@ -176,6 +250,11 @@ namespace ppcsimbooke {
             void       clear_resv(uint64_t ea);
             bool       check_resv(uint64_t ea, size_t size);
             void       notify_ctxt_switch();   // notify of context switches ( called by context syncronizing instructions  such as rfi, sc etc. )
+
+            // guest exceptions
+            inline void  raise_exception(int exception_nr, int subtype, uint64_t ea=0xffffffffffffffffULL);  // record exception
+            void         deliver_exception();                    // deliver pending exception ( see ppc_exception() )
+            void         throw_pending_exception();              // convert pending exception to sim_except_ppc
         
             // Accessing registers using reghash interface ( for use with ppc code translation unit )
             inline ppc_reg64*      reg(int regid);
@@ -188,8 +267,22 @@ namespace ppcsimbooke {
             void                  ppc_exception(int exception_nr, int subtype, uint64_t ea=0xffffffffffffffffULL);
             instr_call            get_instr();                                 // Automatically tries to read instr from next NIP(PC)
             void                  check_for_dbg_events(int flags, uint64_t ea=0);   // check for debug events
-            inline void           run_curr_instr();                                 // run current instr
+            inline size_t         run_curr_instr();                                 // run current instr ( returns 1 if it completed )
+            inline void           account_instrs(size_t n);                         // account n completed instrs ( instrs & cycles )
+            void                  instrument_instr(instr_call& call_this);          // run instrumentation for current instr
+            void                  update_instrumentation();                         // recompute m_instrument
+            void                  set_opc_impl(std::string opcname, const char* func_name, ppc_opc_fun_ptr fptr);   // register opcode handler
             inline void           init_common();
+            inline void           run_tiered(ppcsimbooke_basic_block::basic_block* bb);  // run block in it's tier
+            inline void           demote_block(ppcsimbooke_basic_block::basic_block* bb); // drop block to lowest tier
+            inline void           check_code_write(uint64_t ra, size_t size);            // invalidate code on stores to it
+            void                  stlb_flush() { m_stlb_gen++; }                         // drop all soft tlb entries
+            struct stlb_entry;
+            inline stlb_entry*    stlb_xlate(uint64_t addr, bool wr);                    // soft tlb lookup ( or fill ). NULL on fault
+            template<typename T> T    read_split(uint64_t addr);                         // load crossing a 4K page
+            template<typename T> void write_split(uint64_t addr, T value);               // store crossing a 4K page
+            inline void           check_spin(ppcsimbooke_basic_block::basic_block* bb);  // idle if bb is a polling loop
+            uint64_t              ticks_to_timer_event();                                // time base ticks till next DEC/FIT interrupt
 
             //////////////////////////////////////////////////////////////////////
             // data members
@@ -200,10 +293,11 @@ namespace ppcsimbooke {
             
             private: 
             ppcsimbooke_basic_block::basic_block_cache_unit   m_bb_cache_unit;
+            ppcsimbooke_aot::aot_image                        m_aot_image;          // ahead of time translated code
         
             std::string                            m_cpu_name;
             cpu_run_mode                           m_cpu_mode;            // Run mode : Running/Halted/Stopped etc.
-            cpu_exec_mode                          m_cpu_exec_mode;       // Execution mode : Interpretive/Threaded (basic block)
+            cpu_exec_mode                          m_cpu_exec_mode;       // Execution mode : Interpretive/Threaded/Direct threaded/JIT (basic block)
             int                                    m_cpu_bits;            // 32 or 64
             bool                                   m_cpu_running;         // If CPU is in run mode
         
@@ -236,7 +330,21 @@ namespace ppcsimbooke {
             static size_t                          sm_ncpus;              // Total cpus
             size_t                                 m_ninstrs;             // Number of instrs (total)
             size_t                                 m_ninstrs_last;        // Number of instrs in last run
-            size_t                                 m_ncycles;             // number of cycles
+            size_t                                 m_tier_ninstrs[ppcsimbooke_basic_block::BB_TIER_COUNT];     // Instrs per tier in last run
+            uint32_t                               m_tier_threshold[ppcsimbooke_basic_block::BB_TIER_COUNT];   // promotion thresholds
+            size_t                                 m_ncycles;             // number of cycles ( no timing model, 1 per instr )
+
+            // Polling loop detection
+            struct spin_state {
+                uint64_t                           gpr[32];
+                uint64_t                           cr, xer, ctr, lr, msr;
+            };
+            ppcsimbooke_basic_block::basic_block*  m_spin_bb;             // block last seen looping on itself
+            spin_state                             m_spin_state;          // register state after it's last iteration
+            uint64_t                               m_spin_mem_gen;        // memory write generation after it's last iteration
+            uint32_t                               m_spin_iters;          // no of identical iterations so far
+            uint64_t                               m_nspin_idles;         // no of times cpu idled in a polling loop
+
             instr_call                             m_instr_this;          // Current instr
             instr_call                             m_instr_next;          // next instr
         
@@ -246,6 +354,7 @@ namespace ppcsimbooke {
             ppcsimbooke_dis::ppcdis                m_dis;                  // Disassembler module
             ppcsimbooke_tlb::tlb                   m_l2tlb;                // tlb4K_ns = 128, tlb4K_nw = 4, tlbCam_ne = 16
             ppcsimbooke_memory::memory             *m_mem_ptr;             // Memory module
+            ppcsimbooke_memory::write_counter      *m_mem_writes;          // our write count in memory module
             
             
             // Host flags
@@ -255,15 +364,56 @@ namespace ppcsimbooke {
             // A Cache of recently called instrs.
             lru_cache<uint64_t, instr_call>        m_instr_cache;     // Cache of recently used instrs
             bool                                   m_ctxt_switch;     // Flag indicating that a ctxt switch happened
+            ppc_pending_exception                  m_pending_except;  // exception raised by last instruction
+            uint32_t                               m_instrument;      // Active instrumentation ( INSTRUMENT_XXX bits )
 
-            // opcode to function pointer map
-            std::map<uint64_t, ppc_opc_fun_ptr>    m_ppc_func_hash;
+            // Software TLB.
+            // Direct mapped cache of recent data translations ( EA page -> host page ), one for loads & one
+            // for stores, indexed by EA page & tagged with EA page, MSR[DS] & MSR[PR]. A hit is a tag compare
+            // & a host access. Entries are valid only for their generation, which is bumped on every context
+            // switch ( tlbwe, tlbivax, MSR & PID writes, interrupts ) & whenever cpu starts running.
+            // NOTE : Accesses crossing a 4K page are split & translated one page at a time.
+            struct stlb_entry {
+                uint64_t           tag;                                   // EA page | MSR[DS] << 1 | MSR[PR]
+                uint64_t           gen;
+                uint8_t*           host;                                  // host page
+                uint64_t           ra;                                    // real page ( stores check it for code )
+                int                endian;                                // WIMGE[E]
+            };
+            static const size_t                    STLB_SIZE = 256;       // power of 2
+            stlb_entry                             m_stlb[2][STLB_SIZE];  // [wr]
+            uint64_t                               m_stlb_gen;
+
+            // opcode handler table ( indexed by opcode index in ppc opcode table, i.e lower 32 bits of instr_call::hv )
+            static std::vector<ppc_opc_fun_ptr>    sm_ppc_func_tbl;
+            // RTL function names of handlers ( same indexing, used by ahead of time translator )
+            static std::vector<const char*>        sm_ppc_func_names;
         
             // timings
             boost::posix_time::ptime               m_prev_stamp;
             boost::posix_time::ptime               m_next_stamp;
         
         };
+
+        // These are used by RTL, so every unit expanding cpu_ppc_instr.cc needs them
+        // ( direct threaded engine, ahead of time translated images ).
+
+        // Get register pointer using regid
+        // TODO : Check Permissions
+        inline ppc_reg64* cpu::reg(int regid){
+            m_cpu_regs.sync_flags();
+            ppc_reg64* r = m_cpu_regs.reg_by_id(regid);
+            if unlikely(r == NULL){ throw std::out_of_range("No register with ID " + std::to_string(regid)); }
+            return r;
+        }
+
+        // Record a guest exception. It's delivered at next instruction / basic block boundary.
+        inline void cpu::raise_exception(int exception_nr, int subtype, uint64_t ea){
+            m_pending_except.pending      = true;
+            m_pending_except.exception_nr = exception_nr;
+            m_pending_except.subtype      = subtype;
+            m_pending_except.ea           = ea;
+        }
     }
 }
 
@@ -55,6 +55,10 @@
 #undef  DREG
 #define DREG(reg_alias)          CPU->m_cpu_regs.reg_alias.value.u64v
 
+#pragma push_macro("HREG")
+#undef  HREG
+#define HREG(reg_alias)          CPU->m_cpu_regs.hot.reg_alias.u64v
+
 #pragma push_macro("DREG_FN")
 #undef  DREG_FN
 #define DREG_FN(reg_fn)          CPU->m_cpu_regs.reg_fn
@@ -63,31 +67,31 @@
 // MSR bits
 #pragma push_macro("MSR_CM")
 #undef  MSR_CM
-#define MSR_CM                   ((DREG(msr) & 0x80000000) ? 1 : 0)
+#define MSR_CM                   ((HREG(msr) & 0x80000000) ? 1 : 0)
 
 #pragma push_macro("MSR_UCLE")
 #undef  MSR_UCLE
-#define MSR_UCLE                 ((DREG(msr) & 0x4000000) ? 1:0)
+#define MSR_UCLE                 ((HREG(msr) & 0x4000000) ? 1:0)
 
 #pragma push_macro("MSR_PR")
 #undef  MSR_PR
-#define MSR_PR                   ((DREG(msr) & 0x4000) ? 1:0)
+#define MSR_PR                   ((HREG(msr) & 0x4000) ? 1:0)
 
 #pragma push_macro("GPR")
 #undef  GPR
-#define GPR(gprno)               DREG(gpr[gprno])
+#define GPR(gprno)               HREG(gpr[gprno])
 
 #pragma push_macro("SPR")
 #undef  SPR
-#define SPR(sprno)               PPCREG(REG_SPR0 + sprno)
+#define SPR(sprno)               (DREG_FN(sync_flags()), PPCREG(REG_SPR0 + sprno))
 
 #pragma push_macro("XER")
 #undef  XER
-#define XER                      DREG(xer)
+#define XER                      (DREG_FN(sync_flags()), HREG(xer))
 
 #pragma push_macro("MSR")
 #undef  MSR
-#define MSR                      DREG(msr)
+#define MSR                      HREG(msr)
 
 #pragma push_macro("ACC")
 #undef  ACC
@@ -103,15 +107,15 @@
 
 #pragma push_macro("CR")
 #undef  CR
-#define CR                       DREG(cr)
+#define CR                       (DREG_FN(sync_flags()), HREG(cr))
 
 #pragma push_macro("LR")
 #undef  LR
-#define LR                       DREG(lr)
+#define LR                       HREG(lr)
 
 #pragma push_macro("CTR")
 #undef  CTR
-#define CTR                      DREG(ctr)
+#define CTR                      HREG(ctr)
 
 #pragma push_macro("SRR0")
 #undef  SRR0
@@ -173,11 +177,12 @@
 #define GET_OF_H()               CPU->host_flags.of       // x86 overflow flag
 
 // Generic macros
-#define UPDATE_CA()              DREG_FN(update_xer_ca_host(HOST_FLAGS))
+// CR0 & XER[SO, OV, CA] updates from host flags are deferred till CR/XER is read ( see ppc_regs::sync_flags() )
+#define UPDATE_CA()              DREG_FN(set_lazy_ca(HOST_FLAGS))
 #define UPDATE_CA_V              DREG_FN(update_xer_ca)
-#define UPDATE_SO_OV()           DREG_FN(update_xer_so_ov_host(HOST_FLAGS))
+#define UPDATE_SO_OV()           DREG_FN(set_lazy_so_ov(HOST_FLAGS))
 #define UPDATE_SO_OV_V           DREG_FN(update_xer_so_ov)
-#define UPDATE_CR0()             DREG_FN(update_cr0_host(HOST_FLAGS))
+#define UPDATE_CR0()             DREG_FN(set_lazy_cr0(HOST_FLAGS))
 #define GET_CA()                 DREG_FN(get_xer_ca())
 #define GET_SO()                 DREG_FN(get_xer_so())
 #define UPDATE_CR0_V             DREG_FN(update_cr0)
@@ -186,21 +191,34 @@
 
 #define UPDATE_CYCLES(n)         CPU->m_ncycles += n
 
+// Context (MSR, PIDs, TLBs) changed
+#define CTXT_SWITCH()            CPU->notify_ctxt_switch()
+
+// Debug control registers changed
+#define UPDATE_INSTRUMENTATION() CPU->update_instrumentation()
+
+// Leave current instruction after a guest exception was raised ( see PPC_EXCEPT ).
+// NOTE : Including unit can supply it's own exit path (for eg. direct threaded engine).
+#ifndef RTL_EXCEPT_EXIT
+#define RTL_EXCEPT_EXIT()        return
+#endif
+
 // load/store macros
+// NOTE : A faulting access ( TLB miss, DSI ) raises an exception & terminates the instruction.
 //
-#define LOAD8(addr)              CPU->read8(addr)
-#define LOAD16(addr)             CPU->read16(addr)
-#define LOAD32(addr)             CPU->read32(addr)
-#define LOAD64(addr)             CPU->read64(addr)
+#define LOAD8(addr)              ({ uint8_t  __v = CPU->rtl_read8(addr);  if unlikely(CPU->exception_pending()) RTL_EXCEPT_EXIT(); __v; })
+#define LOAD16(addr)             ({ uint16_t __v = CPU->rtl_read16(addr); if unlikely(CPU->exception_pending()) RTL_EXCEPT_EXIT(); __v; })
+#define LOAD32(addr)             ({ uint32_t __v = CPU->rtl_read32(addr); if unlikely(CPU->exception_pending()) RTL_EXCEPT_EXIT(); __v; })
+#define LOAD64(addr)             ({ uint64_t __v = CPU->rtl_read64(addr); if unlikely(CPU->exception_pending()) RTL_EXCEPT_EXIT(); __v; })
 
-#define STORE8(addr, value)      CPU->write8(addr, value)
-#define STORE16(addr, value)     CPU->write16(addr, value)
-#define STORE32(addr, value)     CPU->write32(addr, value)
-#define STORE64(addr, value)     CPU->write64(addr, value)
+#define STORE8(addr, value)      ({ CPU->rtl_write8(addr, value);  if unlikely(CPU->exception_pending()) RTL_EXCEPT_EXIT(); })
+#define STORE16(addr, value)     ({ CPU->rtl_write16(addr, value); if unlikely(CPU->exception_pending()) RTL_EXCEPT_EXIT(); })
+#define STORE32(addr, value)     ({ CPU->rtl_write32(addr, value); if unlikely(CPU->exception_pending()) RTL_EXCEPT_EXIT(); })
+#define STORE64(addr, value)     ({ CPU->rtl_write64(addr, value); if unlikely(CPU->exception_pending()) RTL_EXCEPT_EXIT(); })
 
 // Reservation macros
-#define SET_RESV(ea, size)       CPU->set_resv(ea, size)
-#define CHECK_RESV(ea, size)     CPU->check_resv(ea, size)
+#define SET_RESV(ea, size)       ({ CPU->set_resv(ea, size); if unlikely(CPU->exception_pending()) RTL_EXCEPT_EXIT(); })
+#define CHECK_RESV(ea, size)     ({ bool __r = CPU->check_resv(ea, size); if unlikely(CPU->exception_pending()) RTL_EXCEPT_EXIT(); __r; })
 #define CLEAR_RESV(ea)           CPU->clear_resv(ea)
 
 // TLB macros
@@ -218,11 +236,11 @@
 #define ARG3                     (ARG_BASE[3].v)
 #define ARG4                     (ARG_BASE[4].v)
 
-#define REG0                     CPU->m_cpu_regs.gpr[ARG0].value.u64v
-#define REG1                     CPU->m_cpu_regs.gpr[ARG1].value.u64v
-#define REG2                     CPU->m_cpu_regs.gpr[ARG2].value.u64v
-#define REG3                     CPU->m_cpu_regs.gpr[ARG3].value.u64v
-#define REG4                     CPU->m_cpu_regs.gpr[ARG4].value.u64v
+#define REG0                     HREG(gpr[ARG0])
+#define REG1                     HREG(gpr[ARG1])
+#define REG2                     HREG(gpr[ARG2])
+#define REG3                     HREG(gpr[ARG3])
+#define REG4                     HREG(gpr[ARG4])
 
 
 // target mode , UT -> unsigned target, st -> signed target
@@ -319,7 +337,8 @@
 #define FORM_CRX(lt, gt, eq, so)   (((lt) << 3) | ((gt) << 2) | ((eq) << 1) | (so))
 
 // PPC Exceptions
-#define  PPC_EXCEPT         sim_except_ppc
+// Exception is only recorded here & delivered by the execution loop. Message is for documentation.
+#define  PPC_EXCEPT(exp_nr, subtype, msg)   do { CPU->raise_exception(exp_nr, subtype); RTL_EXCEPT_EXIT(); } while(0)
 
 // These functions are defined in utils.h
 #define X86_ADDW(arg1,    arg2)                       x86_add<int32_t>(arg1, arg2, HOST_FLAGS)
@@ -353,10 +372,13 @@
 // NOTE : All branch instructions calculate NIP (using the current PC for relative jumps).
 //        NIP is assigned to PC at the end.So effectively NIP is always 4 byte ahead of PC,
 //        except when a branch is taken.
-#define RTL_BEGIN(opc_name, func_name)     CPU->m_ppc_func_hash[CPU->m_dis.get_opc_hash(opc_name)] =  \
+// NOTE : Including unit can supply it's own RTL_BEGIN/RTL_END (for eg. direct threaded engine).
+#ifndef RTL_BEGIN
+#define RTL_BEGIN(opc_name, func_name)     CPU->set_opc_impl(opc_name, #func_name, \
                                                [](ppcsimbooke::ppcsimbooke_cpu::cpu *CPU, ppcsimbooke::instr_call *IC) \
                                                -> void { NIP += 4;
-#define RTL_END                            PC = NIP; };
+#define RTL_END                            PC = NIP; });
+#endif
 
 
 // START
@@ -452,9 +474,12 @@ RTL_BEGIN("addeo.", ___addeo_dot___)
 RTL_END
 
 RTL_BEGIN("addi", ___addi___)
-    SMODE tmp = (int16_t)ARG2;
-    if(ARG1){ add_code(REG0, REG1, tmp);        }
-    else    { REG0 = (int16_t)ARG2;             }
+#define addi_code(rD, A, rA, SIMM)                       \
+    SMODE tmp = (int16_t)SIMM;                           \
+    if(A){ add_code(rD, rA, tmp);        }               \
+    else { rD = (int16_t)SIMM;           }
+
+    addi_code(REG0, ARG1, REG1, ARG2);
 RTL_END
 
 RTL_BEGIN("addic", ___addic___)
@@ -470,9 +495,12 @@ RTL_BEGIN("addic.", ___addic_dot___)
 RTL_END
 
 RTL_BEGIN("addis", ___addis___)
-    SMODE tmp = (((int16_t)ARG2) << 16);
-    if(ARG1){ add_code(REG0, REG1, tmp);        }
-    else    { REG0 = ((int16_t)ARG2) << 16;     }
+#define addis_code(rD, A, rA, SIMM)                      \
+    SMODE tmp = (((int16_t)SIMM) << 16);                 \
+    if(A){ add_code(rD, rA, tmp);        }               \
+    else { rD = ((int16_t)SIMM) << 16;   }
+
+    addis_code(REG0, ARG1, REG1, ARG2);
 RTL_END
 
 // XER[CA] is always altered
@@ -1344,30 +1372,32 @@ RTL_END
 
 // byte loads
 RTL_BEGIN("lbz", ___lbz___)
-    UMODE tmp = 0;
-    UMODE ea;
-    if(ARG2){ tmp = REG2; }
-    ea = tmp + EXTS_H2N(ARG1);
-    REG0 = LOAD8(ea);    
+#define load_d_code(LD, rD, D, A, rA)                    \
+    UMODE ea = ((A) ? (UMODE)(rA) : 0) + EXTS_H2N(D);    \
+    rD = LD(ea)
+
+    load_d_code(LOAD8, REG0, ARG1, ARG2, REG2);
 RTL_END
 RTL_BEGIN("lbzx", ___lbzx___)
-    UMODE tmp = 0;
-    UMODE ea;
-    if(ARG1){ tmp = REG1; }
-    ea = tmp + REG2;
-    REG0 = LOAD8(ea);
+#define load_x_code(LD, rD, A, rA, rB)                   \
+    UMODE ea = ((A) ? (UMODE)(rA) : 0) + (UMODE)(rB);    \
+    rD = LD(ea)
+
+    load_x_code(LOAD8, REG0, ARG1, REG1, REG2);
 RTL_END
 RTL_BEGIN("lbzu", ___lbzu___)
-    if(ARG2 == 0 || ARG0 == ARG2)
-        throw PPC_EXCEPT(PPC_EXCEPTION_PRG, PPC_EXCEPT_PRG_ILG, "Illegal opcode");
-    UMODE ea;
-    ea = REG2 + EXTS_H2N(ARG1);
-    REG0 = LOAD8(ea);
-    REG2 = ea;
+#define load_u_code(LD, rD, D, rA, ILL)                  \
+    if(ILL)                                              \
+        PPC_EXCEPT(PPC_EXCEPTION_PRG, PPC_EXCEPT_PRG_ILG, "Illegal opcode"); \
+    UMODE ea = rA + EXTS_H2N(D);                         \
+    rD = LD(ea);                                         \
+    rA = ea
+
+    load_u_code(LOAD8, REG0, ARG1, REG2, (ARG2 == 0 || ARG0 == ARG2));
 RTL_END
 RTL_BEGIN("lbzux", ___lbzux___)
     if(ARG1 == 0 || ARG0 == ARG1)
-        throw PPC_EXCEPT(PPC_EXCEPTION_PRG, PPC_EXCEPT_PRG_ILG, "Illegal opcode");
+        PPC_EXCEPT(PPC_EXCEPTION_PRG, PPC_EXCEPT_PRG_ILG, "Illegal opcode");
     UMODE ea;
     ea = REG1 + REG2;
     REG0 = LOAD8(ea);
@@ -1376,11 +1406,9 @@ RTL_END
 
 // Halfword algebraic loads
 RTL_BEGIN("lha", ___lha___)
-    UMODE tmp = 0;
-    UMODE ea;
-    if(ARG2){ tmp = REG2; }
-    ea = tmp + EXTS_H2N(ARG1);
-    REG0 = EXTS_H2N(LOAD16(ea));
+#define LOAD16_SE(addr)                  EXTS_H2N(LOAD16(addr))
+
+    load_d_code(LOAD16_SE, REG0, ARG1, ARG2, REG2);
 RTL_END
 RTL_BEGIN("lhax", ___lhax___)
     UMODE tmp = 0;
@@ -1391,7 +1419,7 @@ RTL_BEGIN("lhax", ___lhax___)
 RTL_END
 RTL_BEGIN("lhau", ___lhau___)
     if(ARG2 == 0 || ARG0 == ARG2)
-        throw PPC_EXCEPT(PPC_EXCEPTION_PRG, PPC_EXCEPT_PRG_ILG, "Illegal opcode");
+        PPC_EXCEPT(PPC_EXCEPTION_PRG, PPC_EXCEPT_PRG_ILG, "Illegal opcode");
     UMODE ea;
     ea = REG2 + EXTS_H2N(ARG1);
     REG0 = EXTS_H2N(LOAD16(ea));
@@ -1399,7 +1427,7 @@ RTL_BEGIN("lhau", ___lhau___)
 RTL_END
 RTL_BEGIN("lhaux", ___lhaux___)
     if(ARG1 == 0 || ARG0 == ARG1)
-        throw PPC_EXCEPT(PPC_EXCEPTION_PRG, PPC_EXCEPT_PRG_ILG, "Illegal opcode");
+        PPC_EXCEPT(PPC_EXCEPTION_PRG, PPC_EXCEPT_PRG_ILG, "Illegal opcode");
     UMODE ea;
     ea = REG1 + REG2;
     REG0 = EXTS_H2N(LOAD16(ea));
@@ -1408,30 +1436,17 @@ RTL_END
 
 // Half word loads
 RTL_BEGIN("lhz", ___lhz___)
-    UMODE tmp = 0;
-    UMODE ea;
-    if(ARG2){ tmp = REG2; }
-    ea = tmp + EXTS_H2N(ARG1);
-    REG0 = LOAD16(ea);
+    load_d_code(LOAD16, REG0, ARG1, ARG2, REG2);
 RTL_END
 RTL_BEGIN("lhzx", ___lhzx___)
-    UMODE tmp = 0;
-    UMODE ea;
-    if(ARG1){ tmp = REG1; }
-    ea = tmp + REG2;
-    REG0 = LOAD16(ea);
+    load_x_code(LOAD16, REG0, ARG1, REG1, REG2);
 RTL_END
 RTL_BEGIN("lhzu", ___lhzu___)
-    if(ARG2 == 0 || ARG0 == ARG2)
-        throw PPC_EXCEPT(PPC_EXCEPTION_PRG, PPC_EXCEPT_PRG_ILG, "Illegal opcode");
-    UMODE ea;
-    ea = REG2 + EXTS_H2N(ARG1);
-    REG0 = LOAD16(ea);
-    REG2 = ea;
+    load_u_code(LOAD16, REG0, ARG1, REG2, (ARG2 == 0 || ARG0 == ARG2));
 RTL_END
 RTL_BEGIN("lhzux", ___lhzux___)
     if(ARG1 == 0 || ARG0 == ARG1)
-        throw PPC_EXCEPT(PPC_EXCEPTION_PRG, PPC_EXCEPT_PRG_ILG, "Illegal opcode");
+        PPC_EXCEPT(PPC_EXCEPTION_PRG, PPC_EXCEPT_PRG_ILG, "Illegal opcode");
     UMODE ea;
     ea = REG1 + REG2;
     REG0 = LOAD16(ea);
@@ -1441,32 +1456,19 @@ RTL_END
 // word loads
 // lwz rD,D(rA)
 RTL_BEGIN("lwz", ___lwz___)
-    UMODE tmp = 0;
-    UMODE ea;
-    if(ARG2){ tmp = REG2; }
-    ea = tmp + EXTS_H2N(ARG1);
-    REG0 = LOAD32(ea);
+    load_d_code(LOAD32, REG0, ARG1, ARG2, REG2);
 RTL_END
 // lwzx rD,rA,rB
 RTL_BEGIN("lwzx", ___lwzx___)
-    UMODE tmp = 0;
-    UMODE ea;
-    if(ARG1){ tmp = REG1; }
-    ea = tmp + REG2;
-    REG0 = LOAD32(ea);
+    load_x_code(LOAD32, REG0, ARG1, REG1, REG2);
 RTL_END
 //  lwzu rD,D(rA)
 RTL_BEGIN("lwzu", ___lwzu___)
-    if(ARG2 == 0 || ARG0 == ARG2)
-        throw PPC_EXCEPT(PPC_EXCEPTION_PRG, PPC_EXCEPT_PRG_ILG, "Illegal opcode");
-    UMODE ea;
-    ea = REG2 + EXTS_H2N(ARG1);
-    REG0 = LOAD32(ea);
-    REG2 = ea;
+    load_u_code(LOAD32, REG0, ARG1, REG2, (ARG2 == 0 || ARG0 == ARG2));
 RTL_END
 RTL_BEGIN("lwzux", ___lwzux___)
     if(ARG1 == 0 || ARG0 == ARG1)
-        throw PPC_EXCEPT(PPC_EXCEPTION_PRG, PPC_EXCEPT_PRG_ILG, "Illegal opcode");
+        PPC_EXCEPT(PPC_EXCEPTION_PRG, PPC_EXCEPT_PRG_ILG, "Illegal opcode");
     UMODE ea;
     ea = REG1 + REG2;
     REG0 = LOAD32(ea);
@@ -1510,30 +1512,32 @@ RTL_END
 
 // byte stores
 RTL_BEGIN("stb", ___stb___)
-    UMODE tmp = 0;
-    UMODE ea;
-    if(ARG2){ tmp = REG2; }
-    ea = tmp + EXTS_H2N(ARG1);
-    STORE8(ea, REG0);
+#define store_d_code(ST, rS, D, A, rA)                   \
+    UMODE ea = ((A) ? (UMODE)(rA) : 0) + EXTS_H2N(D);    \
+    ST(ea, rS)
+
+    store_d_code(STORE8, REG0, ARG1, ARG2, REG2);
 RTL_END
 RTL_BEGIN("stbx", ___stbx___)
-    UMODE tmp = 0;
-    UMODE ea;
-    if(ARG1){ tmp = REG1; }
-    ea = tmp + REG2;
-    STORE8(ea, REG0);
+#define store_x_code(ST, rS, A, rA, rB)                  \
+    UMODE ea = ((A) ? (UMODE)(rA) : 0) + (UMODE)(rB);    \
+    ST(ea, rS)
+
+    store_x_code(STORE8, REG0, ARG1, REG1, REG2);
 RTL_END
 RTL_BEGIN("stbu", ___stbu___)
-    if(ARG2 == 0)
-        throw PPC_EXCEPT(PPC_EXCEPTION_PRG, PPC_EXCEPT_PRG_ILG, "Illegal opcode");
-    UMODE ea;
-    ea = REG2 + EXTS_H2N(ARG1);
-    STORE8(ea, REG0);
-    REG2 = ea;
+#define store_u_code(ST, rS, D, rA, ILL)                 \
+    if(ILL)                                              \
+        PPC_EXCEPT(PPC_EXCEPTION_PRG, PPC_EXCEPT_PRG_ILG, "Illegal opcode"); \
+    UMODE ea = rA + EXTS_H2N(D);                         \
+    ST(ea, rS);                                          \
+    rA = ea
+
+    store_u_code(STORE8, REG0, ARG1, REG2, (ARG2 == 0));
 RTL_END
 RTL_BEGIN("stbux", ___stbux___)
     if(ARG1 == 0)
-        throw PPC_EXCEPT(PPC_EXCEPTION_PRG, PPC_EXCEPT_PRG_ILG, "Illegal opcode");
+        PPC_EXCEPT(PPC_EXCEPTION_PRG, PPC_EXCEPT_PRG_ILG, "Illegal opcode");
     UMODE ea;
     ea = REG1 + REG2;
     STORE8(ea, REG0);
@@ -1542,30 +1546,17 @@ RTL_END
 
 // half word stores
 RTL_BEGIN("sth", ___sth___)
-    UMODE tmp = 0;
-    UMODE ea;
-    if(ARG2){ tmp = REG2; }
-    ea = tmp + EXTS_H2N(ARG1);
-    STORE16(ea, REG0);
+    store_d_code(STORE16, REG0, ARG1, ARG2, REG2);
 RTL_END
 RTL_BEGIN("sthx", ___sthx___)
-    UMODE tmp = 0;
-    UMODE ea;
-    if(ARG1){ tmp = REG1; }
-    ea = tmp + REG2;
-    STORE16(ea, REG0);
+    store_x_code(STORE16, REG0, ARG1, REG1, REG2);
 RTL_END
 RTL_BEGIN("sthu", ___sthu___)
-    if(ARG2 == 0)
-        throw PPC_EXCEPT(PPC_EXCEPTION_PRG, PPC_EXCEPT_PRG_ILG, "Illegal opcode");
-    UMODE ea;
-    ea = REG2 + EXTS_H2N(ARG1);
-    STORE16(ea, REG0);
-    REG2 = ea;
+    store_u_code(STORE16, REG0, ARG1, REG2, (ARG2 == 0));
 RTL_END
 RTL_BEGIN("sthux", ___sthux___)
     if(ARG1 == 0)
-        throw PPC_EXCEPT(PPC_EXCEPTION_PRG, PPC_EXCEPT_PRG_ILG, "Illegal opcode");
+        PPC_EXCEPT(PPC_EXCEPTION_PRG, PPC_EXCEPT_PRG_ILG, "Illegal opcode");
     UMODE ea;
     ea = REG1 + REG2;
     STORE16(ea, REG0);
@@ -1574,30 +1565,17 @@ RTL_END
 
 // word stores
 RTL_BEGIN("stw", ___stw___)
-    UMODE tmp = 0;
-    UMODE ea;
-    if(ARG2){ tmp = REG2; }
-    ea = tmp + EXTS_H2N(ARG1);
-    STORE32(ea, REG0);
+    store_d_code(STORE32, REG0, ARG1, ARG2, REG2);
 RTL_END
 RTL_BEGIN("stwx", ___stwx___)
-    UMODE tmp = 0;
-    UMODE ea;
-    if(ARG1){ tmp = REG1; }
-    ea = tmp + REG2;
-    STORE32(ea, REG0);
+    store_x_code(STORE32, REG0, ARG1, REG1, REG2);
 RTL_END
 RTL_BEGIN("stwu", ___stwu___)
-    if(ARG2 == 0)
-        throw PPC_EXCEPT(PPC_EXCEPTION_PRG, PPC_EXCEPT_PRG_ILG, "Illegal opcode");
-    UMODE ea;
-    ea = REG2 + EXTS_H2N(ARG1);
-    STORE32(ea, REG0);
-    REG2 = ea;
+    store_u_code(STORE32, REG0, ARG1, REG2, (ARG2 == 0));
 RTL_END
 RTL_BEGIN("stwux", ___stwux___)
     if(ARG1 == 0)
-        throw PPC_EXCEPT(PPC_EXCEPTION_PRG, PPC_EXCEPT_PRG_ILG, "Illegal opcode");
+        PPC_EXCEPT(PPC_EXCEPTION_PRG, PPC_EXCEPT_PRG_ILG, "Illegal opcode");
     UMODE ea;
     ea = REG1 + REG2;
     STORE32(ea, REG0);
@@ -1652,6 +1630,7 @@ RTL_END
 
 RTL_BEGIN("tlbwe", ___tlbwe___)
     TLBWE();
+    CTXT_SWITCH();
 RTL_END
 
 RTL_BEGIN("tlbre", ___tlbre___)
@@ -1668,6 +1647,7 @@ RTL_BEGIN("tlbivax", ___tlbivax___)
     uint64_t ea = REG1;
     if(ARG0){ ea += REG0; }
     TLBIVAX(ea);
+    CTXT_SWITCH();
     // if HID1[ABE]=1 && CT=1, this instruction is broadcast
 RTL_END
 
@@ -1738,7 +1718,7 @@ RTL_BEGIN("dcbi", ___dcbi___)
 RTL_END
 
 RTL_BEGIN("dcblc", ___dcblc___)
-    if(MSR_PR && !MSR_UCLE){ throw PPC_EXCEPT(PPC_EXCEPTION_DSI, PPC_EXCEPT_DSI_CL, "dcblc: MSR[UCLE]=0, MSR[PR]=1."); }
+    if(MSR_PR && !MSR_UCLE){ PPC_EXCEPT(PPC_EXCEPTION_DSI, PPC_EXCEPT_DSI_CL, "dcblc: MSR[UCLE]=0, MSR[PR]=1."); }
     // if HID1[ABE]=1 && CT=1, this instruction is broadcast
 
     UMODE tmp = 0;
@@ -1810,7 +1790,7 @@ RTL_BEGIN("dcbtst", ___dcbtst___)
 RTL_END
 
 RTL_BEGIN("dcbtls", ___dcbtls___)
-    if(MSR_PR && !MSR_UCLE){ throw PPC_EXCEPT(PPC_EXCEPTION_DSI, PPC_EXCEPT_DSI_CL, "dcbtls: MSR[UCLE]=0, MSR[PR]=1."); }
+    if(MSR_PR && !MSR_UCLE){ PPC_EXCEPT(PPC_EXCEPTION_DSI, PPC_EXCEPT_DSI_CL, "dcbtls: MSR[UCLE]=0, MSR[PR]=1."); }
 
     UMODE tmp = 0;
     UMODE ea;
@@ -1823,7 +1803,7 @@ RTL_BEGIN("dcbtls", ___dcbtls___)
 RTL_END
 
 RTL_BEGIN("dcbtstls", ___dcbtstls___)
-    if(MSR_PR && !MSR_UCLE){ throw PPC_EXCEPT(PPC_EXCEPTION_DSI, PPC_EXCEPT_DSI_CL, "dcbtstls: MSR[UCLE]=0, MSR[PR]=1."); }
+    if(MSR_PR && !MSR_UCLE){ PPC_EXCEPT(PPC_EXCEPTION_DSI, PPC_EXCEPT_DSI_CL, "dcbtstls: MSR[UCLE]=0, MSR[PR]=1."); }
 
     UMODE tmp = 0;
     UMODE ea;
@@ -1849,7 +1829,7 @@ RTL_END
 
 RTL_BEGIN("icblc", ___icblc___)
     // if HID1[ABE]=1 && CT=1, this instruction is broadcast
-    if(MSR_PR && !MSR_UCLE){ throw PPC_EXCEPT(PPC_EXCEPTION_DSI, PPC_EXCEPT_DSI_CL, "icblc: MSR[UCLE]=0, MSR[PR]=1."); }
+    if(MSR_PR && !MSR_UCLE){ PPC_EXCEPT(PPC_EXCEPTION_DSI, PPC_EXCEPT_DSI_CL, "icblc: MSR[UCLE]=0, MSR[PR]=1."); }
 
     UMODE tmp = 0;
     UMODE ea;
@@ -1873,7 +1853,7 @@ RTL_BEGIN("icbt", ___icbt___)
 RTL_END
 
 RTL_BEGIN("icbtls", ___icbtls___)
-    if(MSR_PR && !MSR_UCLE){ throw PPC_EXCEPT(PPC_EXCEPTION_DSI, PPC_EXCEPT_DSI_CL, "icbtls: MSR[UCLE]=0, MSR[PR]=1."); }
+    if(MSR_PR && !MSR_UCLE){ PPC_EXCEPT(PPC_EXCEPTION_DSI, PPC_EXCEPT_DSI_CL, "icbtls: MSR[UCLE]=0, MSR[PR]=1."); }
 
     UMODE tmp = 0;
     UMODE ea;
@@ -1900,36 +1880,39 @@ RTL_END
 // Update 18'th June 2013 : Added support for priviledge mode check.
 
 RTL_BEGIN("rfi", ___rfi___)
-    // throw a program exception if called in user mode
-    if unlikely(MSR_PR) { throw PPC_EXCEPT(PPC_EXCEPTION_PRG, PPC_EXCEPT_PRG_PRV, "rfi: MSR[PR]=1."); }
+    // raise a program exception if called in user mode
+    if unlikely(MSR_PR) { PPC_EXCEPT(PPC_EXCEPTION_PRG, PPC_EXCEPT_PRG_PRV, "rfi: MSR[PR]=1."); }
 
     MSR = SRR1;
     NIP = ((UMODE)SRR0) & ~0x3ULL;       // Mask Lower 2 bits to zero
+    CTXT_SWITCH();
 RTL_END
 
 RTL_BEGIN("rfmci", ___rfmci___)
-    // throw a program exception if called in user mode
-    if unlikely(MSR_PR) { throw PPC_EXCEPT(PPC_EXCEPTION_PRG, PPC_EXCEPT_PRG_PRV, "rfmci: MSR[PR]=1."); }
+    // raise a program exception if called in user mode
+    if unlikely(MSR_PR) { PPC_EXCEPT(PPC_EXCEPTION_PRG, PPC_EXCEPT_PRG_PRV, "rfmci: MSR[PR]=1."); }
 
     MSR = MCSRR1;
     NIP = ((UMODE)MCSRR0) & ~0x3ULL;
+    CTXT_SWITCH();
 RTL_END
 
 RTL_BEGIN("rfci", ___rfci___)
-    // throw a program exception if called in user mode
-    if unlikely(MSR_PR) { throw PPC_EXCEPT(PPC_EXCEPTION_PRG, PPC_EXCEPT_PRG_PRV, "rfci: MSR[PR]=1."); }
+    // raise a program exception if called in user mode
+    if unlikely(MSR_PR) { PPC_EXCEPT(PPC_EXCEPTION_PRG, PPC_EXCEPT_PRG_PRV, "rfci: MSR[PR]=1."); }
 
     MSR = CSRR1;
     NIP = ((UMODE)CSRR0) & ~0x3ULL;
+    CTXT_SWITCH();
 RTL_END
 
 RTL_BEGIN("sc", ___sc___)
-    throw PPC_EXCEPT(PPC_EXCEPTION_SC, PPC_EXCEPT_SC, "system call");     // raise a system call exception
+    PPC_EXCEPT(PPC_EXCEPTION_SC, PPC_EXCEPT_SC, "system call");     // raise a system call exception
 RTL_END
 
 RTL_BEGIN("mtmsr", ___mtmsr___)
-    // throw a program exception if called in user mode
-    if unlikely(MSR_PR) { throw PPC_EXCEPT(PPC_EXCEPTION_PRG, PPC_EXCEPT_PRG_PRV, "mtmsr: MSR[PR]=1."); }
+    // raise a program exception if called in user mode
+    if unlikely(MSR_PR) { PPC_EXCEPT(PPC_EXCEPTION_PRG, PPC_EXCEPT_PRG_PRV, "mtmsr: MSR[PR]=1."); }
 
     uint64_t newmsr = B_32_63(REG0);
     uint8_t newmsr_cm = ((newmsr & MSR_CM) ? 1:0);
@@ -1938,6 +1921,7 @@ RTL_BEGIN("mtmsr", ___mtmsr___)
     // Another check is required for MSR_GS == 1, but since we don't have guest mode
     // this is irrelevant.
     MSR = newmsr;
+    CTXT_SWITCH();
 RTL_END
 
 RTL_BEGIN("mfmsr", ___mfmsr___)
@@ -1949,8 +1933,8 @@ RTL_BEGIN("wrtee", ___wrtee___)
     MSR &= ~(1L << 15);           \
     MSR |= rS & (1L << 15);
 
-    // throw a program exception if called in user mode
-    if unlikely(MSR_PR) { throw PPC_EXCEPT(PPC_EXCEPTION_PRG, PPC_EXCEPT_PRG_PRV, "wrtee: MSR[PR]=1."); }
+    // raise a program exception if called in user mode
+    if unlikely(MSR_PR) { PPC_EXCEPT(PPC_EXCEPTION_PRG, PPC_EXCEPT_PRG_PRV, "wrtee: MSR[PR]=1."); }
 
     wrtee_code(REG0);
 RTL_END
@@ -1959,8 +1943,8 @@ RTL_BEGIN("wrteei", ___wrteei___)
     MSR &= ~(1 << 15);            \
     MSR |= ((E & 0x1) << 15);
 
-    // throw a program exception if called in user mode
-    if unlikely(MSR_PR) { throw PPC_EXCEPT(PPC_EXCEPTION_PRG, PPC_EXCEPT_PRG_PRV, "wrteei: MSR[PR]=1."); }
+    // raise a program exception if called in user mode
+    if unlikely(MSR_PR) { PPC_EXCEPT(PPC_EXCEPTION_PRG, PPC_EXCEPT_PRG_PRV, "wrteei: MSR[PR]=1."); }
 
     wrteei_code(ARG0);
 RTL_END
@@ -1984,7 +1968,7 @@ RTL_BEGIN("twi", ___twi___)
     if((au < bu) && ((TO >> 3) & 0x1)) { trap = true; }                                \
     if((au > bu) && ((TO >> 4) & 0x1)) { trap = true; }                                \
     if(trap == true){                                                                  \
-        throw PPC_EXCEPT(PPC_EXCEPTION_PRG, PPC_EXCEPT_PRG_TRAP, "System Trap");       \
+        PPC_EXCEPT(PPC_EXCEPTION_PRG, PPC_EXCEPT_PRG_TRAP, "System Trap");       \
     }
 
     twi_code(ARG0, REG1, ARG2);
@@ -2003,7 +1987,7 @@ RTL_BEGIN("tw", ___tw___)
     if((au < bu) && ((TO >> 3) & 0x1)) { trap = true; }                                \
     if((au > bu) && ((TO >> 4) & 0x1)) { trap = true; }                                \
     if(trap == true){                                                                  \
-        throw PPC_EXCEPT(PPC_EXCEPTION_PRG, PPC_EXCEPT_PRG_TRAP, "System Trap");       \
+        PPC_EXCEPT(PPC_EXCEPTION_PRG, PPC_EXCEPT_PRG_TRAP, "System Trap");       \
     }
 
     tw_code(ARG0, REG1, REG2);
@@ -2044,7 +2028,7 @@ RTL_BEGIN("mfcr", ___mfcr___)
 #define mfcr_code(rD)                               \
     rD = B_32_63(CR)
 
-    mfcr_code(ARG0);
+    mfcr_code(REG0);
 RTL_END
 
 RTL_BEGIN("mfspr", ___mfspr___)
@@ -2059,6 +2043,8 @@ RTL_BEGIN("mtspr", ___mtspr___)
     SPR(SPRN) = rS;
 
     mtspr_code(ARG0, REG1);       // FIXME : No special checks for SPRN no. Will fix this later on.
+    if unlikely(ARG0 == SPRN_PID0 || ARG0 == SPRN_PID1 || ARG0 == SPRN_PID2){ CTXT_SWITCH(); }
+    if unlikely(ARG0 == SPRN_DBCR0){ UPDATE_INSTRUMENTATION(); }
 RTL_END
 
 // START
@@ -2071,7 +2057,8 @@ RTL_END
 //             stwcx.
 
 RTL_BEGIN("isync", ___isync___)
-    // Do nothing
+    // context synchronizing
+    CTXT_SWITCH();
 RTL_END
 
 // Barrier
@@ -2127,7 +2114,7 @@ RTL_BEGIN("mfpmr", ___mfpmr___)
 #define mfpmr_code(rD, PMRN)                  \
     rD = PMR(PMRN);
 
-    mfpmr_code(ARG0, REG1);
+    mfpmr_code(REG0, ARG1);
 RTL_END
 
 // START
@@ -4287,9 +4274,290 @@ RTL_BEGIN("efdneg", ___efdneg___)
 RTL_END
 
 
+// START
+// ------------------------------ OPERAND SPECIALIZED VARIANTS ---------------------
+// RTL of some frequent instrs expanded a second time with shape of their operands ( rA = 0 or not,
+// legal update form ) fixed at compile time, so they don't test it at run time.
+// Decoder picks one of these, once it knows operands of an instr ( see ppcdis::specialize() ).
+// NOTE : Names of variants are <opcode>:<form> & are listed in ppcdis::sm_opc_variants as well.
+// forms :
+//             ra0    rA field is 0 ( operand is 0 instead of GPR0 )
+//             ra     rA field is not 0
+//             ok     update form with a legal rA
+
+RTL_BEGIN("addi:ra0", ___addi_ra0___)
+    addi_code(REG0, 0, REG1, ARG2);
+RTL_END
+
+RTL_BEGIN("addi:ra", ___addi_ra___)
+    addi_code(REG0, 1, REG1, ARG2);
+RTL_END
+
+RTL_BEGIN("addis:ra0", ___addis_ra0___)
+    addis_code(REG0, 0, REG1, ARG2);
+RTL_END
+
+RTL_BEGIN("addis:ra", ___addis_ra___)
+    addis_code(REG0, 1, REG1, ARG2);
+RTL_END
+
+RTL_BEGIN("lbz:ra0", ___lbz_ra0___)
+    load_d_code(LOAD8, REG0, ARG1, 0, REG2);
+RTL_END
+
+RTL_BEGIN("lbz:ra", ___lbz_ra___)
+    load_d_code(LOAD8, REG0, ARG1, 1, REG2);
+RTL_END
+
+RTL_BEGIN("lhz:ra0", ___lhz_ra0___)
+    load_d_code(LOAD16, REG0, ARG1, 0, REG2);
+RTL_END
+
+RTL_BEGIN("lhz:ra", ___lhz_ra___)
+    load_d_code(LOAD16, REG0, ARG1, 1, REG2);
+RTL_END
+
+RTL_BEGIN("lha:ra0", ___lha_ra0___)
+    load_d_code(LOAD16_SE, REG0, ARG1, 0, REG2);
+RTL_END
+
+RTL_BEGIN("lha:ra", ___lha_ra___)
+    load_d_code(LOAD16_SE, REG0, ARG1, 1, REG2);
+RTL_END
+
+RTL_BEGIN("lwz:ra0", ___lwz_ra0___)
+    load_d_code(LOAD32, REG0, ARG1, 0, REG2);
+RTL_END
+
+RTL_BEGIN("lwz:ra", ___lwz_ra___)
+    load_d_code(LOAD32, REG0, ARG1, 1, REG2);
+RTL_END
+
+RTL_BEGIN("lbzx:ra0", ___lbzx_ra0___)
+    load_x_code(LOAD8, REG0, 0, REG1, REG2);
+RTL_END
+
+RTL_BEGIN("lbzx:ra", ___lbzx_ra___)
+    load_x_code(LOAD8, REG0, 1, REG1, REG2);
+RTL_END
+
+RTL_BEGIN("lhzx:ra0", ___lhzx_ra0___)
+    load_x_code(LOAD16, REG0, 0, REG1, REG2);
+RTL_END
+
+RTL_BEGIN("lhzx:ra", ___lhzx_ra___)
+    load_x_code(LOAD16, REG0, 1, REG1, REG2);
+RTL_END
+
+RTL_BEGIN("lwzx:ra0", ___lwzx_ra0___)
+    load_x_code(LOAD32, REG0, 0, REG1, REG2);
+RTL_END
+
+RTL_BEGIN("lwzx:ra", ___lwzx_ra___)
+    load_x_code(LOAD32, REG0, 1, REG1, REG2);
+RTL_END
+
+RTL_BEGIN("lbzu:ok", ___lbzu_ok___)
+    load_u_code(LOAD8, REG0, ARG1, REG2, 0);
+RTL_END
+
+RTL_BEGIN("lhzu:ok", ___lhzu_ok___)
+    load_u_code(LOAD16, REG0, ARG1, REG2, 0);
+RTL_END
+
+RTL_BEGIN("lwzu:ok", ___lwzu_ok___)
+    load_u_code(LOAD32, REG0, ARG1, REG2, 0);
+RTL_END
+
+RTL_BEGIN("stb:ra0", ___stb_ra0___)
+    store_d_code(STORE8, REG0, ARG1, 0, REG2);
+RTL_END
+
+RTL_BEGIN("stb:ra", ___stb_ra___)
+    store_d_code(STORE8, REG0, ARG1, 1, REG2);
+RTL_END
+
+RTL_BEGIN("sth:ra0", ___sth_ra0___)
+    store_d_code(STORE16, REG0, ARG1, 0, REG2);
+RTL_END
+
+RTL_BEGIN("sth:ra", ___sth_ra___)
+    store_d_code(STORE16, REG0, ARG1, 1, REG2);
+RTL_END
+
+RTL_BEGIN("stw:ra0", ___stw_ra0___)
+    store_d_code(STORE32, REG0, ARG1, 0, REG2);
+RTL_END
+
+RTL_BEGIN("stw:ra", ___stw_ra___)
+    store_d_code(STORE32, REG0, ARG1, 1, REG2);
+RTL_END
+
+RTL_BEGIN("stbx:ra0", ___stbx_ra0___)
+    store_x_code(STORE8, REG0, 0, REG1, REG2);
+RTL_END
+
+RTL_BEGIN("stbx:ra", ___stbx_ra___)
+    store_x_code(STORE8, REG0, 1, REG1, REG2);
+RTL_END
+
+RTL_BEGIN("sthx:ra0", ___sthx_ra0___)
+    store_x_code(STORE16, REG0, 0, REG1, REG2);
+RTL_END
+
+RTL_BEGIN("sthx:ra", ___sthx_ra___)
+    store_x_code(STORE16, REG0, 1, REG1, REG2);
+RTL_END
+
+RTL_BEGIN("stwx:ra0", ___stwx_ra0___)
+    store_x_code(STORE32, REG0, 0, REG1, REG2);
+RTL_END
+
+RTL_BEGIN("stwx:ra", ___stwx_ra___)
+    store_x_code(STORE32, REG0, 1, REG1, REG2);
+RTL_END
+
+RTL_BEGIN("stbu:ok", ___stbu_ok___)
+    store_u_code(STORE8, REG0, ARG1, REG2, 0);
+RTL_END
+
+RTL_BEGIN("sthu:ok", ___sthu_ok___)
+    store_u_code(STORE16, REG0, ARG1, REG2, 0);
+RTL_END
+
+RTL_BEGIN("stwu:ok", ___stwu_ok___)
+    store_u_code(STORE32, REG0, ARG1, REG2, 0);
+RTL_END
+
+// START
+// ------------------------------ BLOCK IR PSEUDO OPS ------------------------------
+// Targets of block IR passes ( see basic_block_ir ). These replace a decoded instr whose
+// operands were found to be constant or whose result is never used. The constant is kept in
+// last argument of call frame ( IR_CONST ).
+// pseudo ops :
+//             ir:nop        instr dropped
+//             ir:li         rD = IR_CONST
+//             <ld/st>:abs   load/store at IR_CONST
+
+#define IR_CONST                 (ARG_BASE[N_IC_ARGS - 1].v)
+
+RTL_BEGIN("ir:nop", ___ir_nop___)
+RTL_END
+
+RTL_BEGIN("ir:li", ___ir_li___)
+    REG0 = IR_CONST;
+RTL_END
+
+RTL_BEGIN("lbz:abs", ___lbz_abs___)
+    REG0 = LOAD8((UMODE)IR_CONST);
+RTL_END
+RTL_BEGIN("lhz:abs", ___lhz_abs___)
+    REG0 = LOAD16((UMODE)IR_CONST);
+RTL_END
+RTL_BEGIN("lha:abs", ___lha_abs___)
+    REG0 = LOAD16_SE((UMODE)IR_CONST);
+RTL_END
+RTL_BEGIN("lwz:abs", ___lwz_abs___)
+    REG0 = LOAD32((UMODE)IR_CONST);
+RTL_END
+RTL_BEGIN("stb:abs", ___stb_abs___)
+    STORE8((UMODE)IR_CONST, REG0);
+RTL_END
+RTL_BEGIN("sth:abs", ___sth_abs___)
+    STORE16((UMODE)IR_CONST, REG0);
+RTL_END
+RTL_BEGIN("stw:abs", ___stw_abs___)
+    STORE32((UMODE)IR_CONST, REG0);
+RTL_END
+
+// START
+// ------------------------------ FUSED INSTRUCTION PAIRS --------------------------
+// Common compiler idioms, executed back to back with a single dispatch.
+// Only an including unit which can dispatch a pair at once ( direct threaded engine ) supplies
+// RTL_FUSED_BEGIN. Each body runs RTL of first instr, moves IC to second one ( RTL_FUSED_NEXT() )
+// and runs RTL of second one, so a faulting instr is always known exactly.
+// Pairs declared with RTL_FUSED_BRANCH_BEGIN end a block. They use RTL_FUSED_SYNC_NEXT(), which
+// sets up PC/NIP for the branch as well.
+// pairs :
+//             addis + ori            ( lis/ori 32 bit constant )
+//             addis + addi           ( lis/addi 32 bit constant or address )
+//             addis + lwz            ( load from far address )
+//             rlwinm + add           ( scaled index )
+//             rlwinm + lwzx          ( load from scaled index )
+//             cmp/cmpi/cmpl/cmpli + bc
+
+#ifdef RTL_FUSED_BEGIN
+
+RTL_FUSED_BEGIN("addis", "ori", ___addis_ori___)
+    { addis_code(REG0, ARG1, REG1, ARG2);            }
+    RTL_FUSED_NEXT();
+    { or_code(REG0, REG1, (UMODE)(uint16_t)(ARG2));  }
+RTL_END
+
+RTL_FUSED_BEGIN("addis", "addi", ___addis_addi___)
+    { addis_code(REG0, ARG1, REG1, ARG2);            }
+    RTL_FUSED_NEXT();
+    { addi_code(REG0, ARG1, REG1, ARG2);             }
+RTL_END
+
+RTL_FUSED_BEGIN("addis", "lwz", ___addis_lwz___)
+    { addis_code(REG0, ARG1, REG1, ARG2);            }
+    RTL_FUSED_NEXT();
+    { load_d_code(LOAD32, REG0, ARG1, ARG2, REG2);   }
+RTL_END
+
+RTL_FUSED_BEGIN("rlwinm", "add", ___rlwinm_add___)
+    { rlwinm_code(REG0, REG1, ARG2, ARG3, ARG4);     }
+    RTL_FUSED_NEXT();
+    { add_code(REG0, REG1, REG2);                    }
+RTL_END
+
+RTL_FUSED_BEGIN("rlwinm", "lwzx", ___rlwinm_lwzx___)
+    { rlwinm_code(REG0, REG1, ARG2, ARG3, ARG4);     }
+    RTL_FUSED_NEXT();
+    { load_x_code(LOAD32, REG0, ARG1, REG1, REG2);   }
+RTL_END
+
+RTL_FUSED_BRANCH_BEGIN("cmp", "bc", ___cmp_bc___)
+    { cmp_code(ARG0, ARG1, REG2, REG3);              }
+    RTL_FUSED_SYNC_NEXT();
+    { bc_code(ARG0, ARG1, ARG2);                     }
+RTL_END
+
+RTL_FUSED_BRANCH_BEGIN("cmpi", "bc", ___cmpi_bc___)
+    { cmpi_code(ARG0, ARG1, REG2, ARG3);             }
+    RTL_FUSED_SYNC_NEXT();
+    { bc_code(ARG0, ARG1, ARG2);                     }
+RTL_END
+
+RTL_FUSED_BRANCH_BEGIN("cmpl", "bc", ___cmpl_bc___)
+    { cmpl_code(ARG0, ARG1, REG2, REG3);             }
+    RTL_FUSED_SYNC_NEXT();
+    { bc_code(ARG0, ARG1, ARG2);                     }
+RTL_END
+
+RTL_FUSED_BRANCH_BEGIN("cmpli", "bc", ___cmpli_bc___)
+    { cmpli_code(ARG0, ARG1, REG2, ARG3);            }
+    RTL_FUSED_SYNC_NEXT();
+    { bc_code(ARG0, ARG1, ARG2);                     }
+RTL_END
+
+#endif
+
+
+// RTL building blocks are specific to each inclusion
+#undef RTL_BEGIN
+#undef RTL_END
+#undef RTL_EXCEPT_EXIT
+
+// These clash with SFF's members if this file is included again
+#undef SF
+#undef GSF
+
 // Restore all saved macros
 #pragma pop_macro("PPCREG")
 #pragma pop_macro("DREG")
+#pragma pop_macro("HREG")
 #pragma pop_macro("DREG_FN")
 #pragma pop_macro("MSR_CM")
 #pragma pop_macro("MSR_UCLE")
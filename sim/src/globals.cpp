@@ -1,45 +1,74 @@
 #include "globals.h"
+#include <deque>
 
 ///////////////////////////////////////////////////////////////////////////////////////////
 // instruction call frame
 //////////////////////////////////////////////////////////////////////////////////////////
 
+// Interned strings live in a fixed table, so that str() needs no lock. Only intern() of a new string
+// takes one.
+namespace {
+    const size_t                                 STRTAB_SIZE = 65536;
+    const char*                                  strtab[STRTAB_SIZE] = { "" };
+    size_t                                       strtab_n = 1;
+    std::unordered_map<std::string, uint16_t>    strtab_ids;
+    std::deque<std::string>                      strtab_pool;       // backing store ( never moves it's strings )
+    boost::mutex                                 strtab_lock;
+}
+
+uint16_t ppcsimbooke::instr_strtab::intern(const char* s){
+    if(*s == '\0'){
+        return 0;
+    }
+    boost::lock_guard<boost::mutex> lock(strtab_lock);
+    std::unordered_map<std::string, uint16_t>::iterator it = strtab_ids.find(s);
+    if(it != strtab_ids.end()){
+        return it->second;
+    }
+    LASSERT_THROW(strtab_n < STRTAB_SIZE, sim_except(SIM_EXCEPT_ENOMEM, "Too many interned strings"), DEBUG4);
+    strtab_pool.push_back(s);
+    strtab[strtab_n] = strtab_pool.back().c_str();
+    strtab_ids[s]    = strtab_n;
+    return strtab_n++;
+}
+
+const char* ppcsimbooke::instr_strtab::str(uint16_t id){
+    return strtab[id];
+}
+
 ppcsimbooke::instr_call::instr_call(){
-    opc     = 0;
+    fptr    = NULL;
     hv      = 0;
+    fmt     = 0;
     nargs   = 0;
+    argt    = 0;
     for(int i=0; i<N_IC_ARGS; i++){
-        arg[i].v = arg[i].p = arg[i].t = 0;
+        arg[i].v = 0;
     }
 }
 
 // Dump state
 void ppcsimbooke::instr_call::dump_state() const{
     std::cout << "name   : " << opcname << std::endl;
-    std::cout << "opcode : " << std::hex << std::showbase << opc << std::endl;
+    std::cout << "opcode : " << std::hex << std::showbase << opc() << std::endl;
     std::cout << "hash   : " << std::hex << std::showbase << hv << std::endl;
     std::cout << "args   : ";
     for(int i=0; i<nargs; i++){
         std::cout << std::hex << std::showbase << arg[i].v << " ";
     }
     std::cout << std::endl;
-    std::cout << "pargs  : ";
-    for(int i=0; i<nargs; i++){
-        std::cout << std::hex << std::showbase << arg[i].p << " ";
-    }
-    std::cout << std::endl;
     std::cout << "targs  : ";
     for(int i=0; i<nargs; i++){
-        std::cout << std::hex << std::showbase << arg[i].t << " ";
+        std::cout << is_reg(i) << " ";
     }
     std::cout << std::endl;
-    std::cout << "fmt    : " << fmt << std::endl;
-    std::cout << "nargs  : " << nargs << std::endl << std::endl;
+    std::cout << "fmt    : " << instr_strtab::str(fmt) << std::endl;
+    std::cout << "nargs  : " << std::dec << static_cast<int>(nargs) << std::endl << std::endl;
 }
 
 // print instruction
 void ppcsimbooke::instr_call::print_instr() const{
-    std::string lfmt = fmt;
+    std::string lfmt = instr_strtab::str(fmt);
     for(int i=nargs; i<N_IC_ARGS; i++){
         lfmt += "%c";
     }
@@ -48,14 +77,14 @@ void ppcsimbooke::instr_call::print_instr() const{
     if(opcname == "")
         printf(".long 0x%lx\n", (arg[0].v & 0xffffffff));
     else
-        printf(lfmt.c_str(), opcname.c_str(), arg[0].v, arg[1].v, arg[2].v, arg[3].v, arg[4].v, arg[5].v);
+        printf(lfmt.c_str(), opcname.c_str(), arg[0].v, arg[1].v, arg[2].v, arg[3].v, arg[4].v);
 }
 
 
 // Get instruction representation in string form ( Used for DEBUG logs )
 char* ppcsimbooke::instr_call::get_instr_str() const{
     static char instr_str[100];
-    std::string lfmt = fmt;
+    std::string lfmt = instr_strtab::str(fmt);
     for(int i=nargs; i<N_IC_ARGS; i++){
         lfmt += "%c";
     }
@@ -64,7 +93,7 @@ char* ppcsimbooke::instr_call::get_instr_str() const{
     if(opcname == "")
         sprintf(instr_str, ".long 0x%lx ", (arg[0].v & 0xffffffff));
     else
-        sprintf(instr_str, lfmt.c_str(), opcname.c_str(), arg[0].v, arg[1].v, arg[2].v, arg[3].v, arg[4].v, arg[5].v);
+        sprintf(instr_str, lfmt.c_str(), opcname.c_str(), arg[0].v, arg[1].v, arg[2].v, arg[3].v, arg[4].v);
     return instr_str;
 }
 
@@ -74,53 +103,55 @@ char* ppcsimbooke::instr_call::get_instr_str() const{
 
 // Constructor
 ppcsimbooke::ppc_regs::ppc_regs(bool c_m, uint64_t pc_):
-    cm(c_m),
-
     pc(pc_), nip(pc_),
 
-    msr     (0,    (REG_READ_SUP | REG_WRITE_SUP | REG_READ_USR                                  ), 0            , REG_TYPE_MSR),
-    cr      (0,    0                                                                              , 0            , REG_TYPE_CR ),
+    lazy_pending(0),
+
+    cm(c_m),
+
+    msr     (hot.msr, 0,    (REG_READ_SUP | REG_WRITE_SUP | REG_READ_USR                                  ), 0            , REG_TYPE_MSR),
+    cr      (hot.cr,  0,    0                                                                              , 0            , REG_TYPE_CR ),
     acc     (0,    0                                                                              , 0            , REG_TYPE_ACC),
 
-    gpr{ ppc_reg64(0,    0                                                                              , 0            , REG_TYPE_GPR),
-         ppc_reg64(0,    0                                                                              , 1            , REG_TYPE_GPR),
-         ppc_reg64(0,    0                                                                              , 2            , REG_TYPE_GPR),
-         ppc_reg64(0,    0                                                                              , 3            , REG_TYPE_GPR),
-         ppc_reg64(0,    0                                                                              , 4            , REG_TYPE_GPR),
-         ppc_reg64(0,    0                                                                              , 5            , REG_TYPE_GPR),
-         ppc_reg64(0,    0                                                                              , 6            , REG_TYPE_GPR),
-         ppc_reg64(0,    0                                                                              , 7            , REG_TYPE_GPR),
-         ppc_reg64(0,    0                                                                              , 8            , REG_TYPE_GPR),
-         ppc_reg64(0,    0                                                                              , 9            , REG_TYPE_GPR),
-         ppc_reg64(0,    0                                                                              , 10           , REG_TYPE_GPR),
-         ppc_reg64(0,    0                                                                              , 11           , REG_TYPE_GPR),
-         ppc_reg64(0,    0                                                                              , 12           , REG_TYPE_GPR),
-         ppc_reg64(0,    0                                                                              , 13           , REG_TYPE_GPR),
-         ppc_reg64(0,    0                                                                              , 14           , REG_TYPE_GPR),
-         ppc_reg64(0,    0                                                                              , 15           , REG_TYPE_GPR),
-         ppc_reg64(0,    0                                                                              , 16           , REG_TYPE_GPR),
-         ppc_reg64(0,    0                                                                              , 17           , REG_TYPE_GPR),
-         ppc_reg64(0,    0                                                                              , 18           , REG_TYPE_GPR),
-         ppc_reg64(0,    0                                                                              , 19           , REG_TYPE_GPR),
-         ppc_reg64(0,    0                                                                              , 20           , REG_TYPE_GPR),
-         ppc_reg64(0,    0                                                                              , 21           , REG_TYPE_GPR),
-         ppc_reg64(0,    0                                                                              , 22           , REG_TYPE_GPR),
-         ppc_reg64(0,    0                                                                              , 23           , REG_TYPE_GPR),
-         ppc_reg64(0,    0                                                                              , 24           , REG_TYPE_GPR),
-         ppc_reg64(0,    0                                                                              , 25           , REG_TYPE_GPR),
-         ppc_reg64(0,    0                                                                              , 26           , REG_TYPE_GPR),
-         ppc_reg64(0,    0                                                                              , 27           , REG_TYPE_GPR),
-         ppc_reg64(0,    0                                                                              , 28           , REG_TYPE_GPR),
-         ppc_reg64(0,    0                                                                              , 29           , REG_TYPE_GPR),
-         ppc_reg64(0,    0                                                                              , 30           , REG_TYPE_GPR),
-         ppc_reg64(0,    0                                                                              , 31           , REG_TYPE_GPR),
+    gpr{ { hot.gpr[0],  0, 0                                                                              , 0            , REG_TYPE_GPR },
+         { hot.gpr[1],  0, 0                                                                              , 1            , REG_TYPE_GPR },
+         { hot.gpr[2],  0, 0                                                                              , 2            , REG_TYPE_GPR },
+         { hot.gpr[3],  0, 0                                                                              , 3            , REG_TYPE_GPR },
+         { hot.gpr[4],  0, 0                                                                              , 4            , REG_TYPE_GPR },
+         { hot.gpr[5],  0, 0                                                                              , 5            , REG_TYPE_GPR },
+         { hot.gpr[6],  0, 0                                                                              , 6            , REG_TYPE_GPR },
+         { hot.gpr[7],  0, 0                                                                              , 7            , REG_TYPE_GPR },
+         { hot.gpr[8],  0, 0                                                                              , 8            , REG_TYPE_GPR },
+         { hot.gpr[9],  0, 0                                                                              , 9            , REG_TYPE_GPR },
+         { hot.gpr[10], 0, 0                                                                              , 10           , REG_TYPE_GPR },
+         { hot.gpr[11], 0, 0                                                                              , 11           , REG_TYPE_GPR },
+         { hot.gpr[12], 0, 0                                                                              , 12           , REG_TYPE_GPR },
+         { hot.gpr[13], 0, 0                                                                              , 13           , REG_TYPE_GPR },
+         { hot.gpr[14], 0, 0                                                                              , 14           , REG_TYPE_GPR },
+         { hot.gpr[15], 0, 0                                                                              , 15           , REG_TYPE_GPR },
+         { hot.gpr[16], 0, 0                                                                              , 16           , REG_TYPE_GPR },
+         { hot.gpr[17], 0, 0                                                                              , 17           , REG_TYPE_GPR },
+         { hot.gpr[18], 0, 0                                                                              , 18           , REG_TYPE_GPR },
+         { hot.gpr[19], 0, 0                                                                              , 19           , REG_TYPE_GPR },
+         { hot.gpr[20], 0, 0                                                                              , 20           , REG_TYPE_GPR },
+         { hot.gpr[21], 0, 0                                                                              , 21           , REG_TYPE_GPR },
+         { hot.gpr[22], 0, 0                                                                              , 22           , REG_TYPE_GPR },
+         { hot.gpr[23], 0, 0                                                                              , 23           , REG_TYPE_GPR },
+         { hot.gpr[24], 0, 0                                                                              , 24           , REG_TYPE_GPR },
+         { hot.gpr[25], 0, 0                                                                              , 25           , REG_TYPE_GPR },
+         { hot.gpr[26], 0, 0                                                                              , 26           , REG_TYPE_GPR },
+         { hot.gpr[27], 0, 0                                                                              , 27           , REG_TYPE_GPR },
+         { hot.gpr[28], 0, 0                                                                              , 28           , REG_TYPE_GPR },
+         { hot.gpr[29], 0, 0                                                                              , 29           , REG_TYPE_GPR },
+         { hot.gpr[30], 0, 0                                                                              , 30           , REG_TYPE_GPR },
+         { hot.gpr[31], 0, 0                                                                              , 31           , REG_TYPE_GPR },
        },
 
     atbl    (0, (REG_READ_SUP  | REG_WRITE_SUP   | REG_READ_USR                                  ), SPRN_ATBL    , REG_TYPE_SPR),
     atbu    (0, (REG_READ_SUP  | REG_WRITE_SUP   | REG_READ_USR                                  ), SPRN_ATBU    , REG_TYPE_SPR),
     csrr0   (0, (REG_READ_SUP  | REG_WRITE_SUP                                                   ), SPRN_CSRR0   , REG_TYPE_SPR),
     csrr1   (0, (REG_READ_SUP  | REG_WRITE_SUP                                                   ), SPRN_CSRR1   , REG_TYPE_SPR),
-    ctr     (0, (REG_READ_SUP  | REG_WRITE_SUP   | REG_READ_USR  | REG_WRITE_USR                 ), SPRN_CTR     , REG_TYPE_SPR),
+    ctr     (hot.ctr, 0, (REG_READ_SUP  | REG_WRITE_SUP   | REG_READ_USR  | REG_WRITE_USR                 ), SPRN_CTR     , REG_TYPE_SPR),
     dac1    (0, (REG_READ_SUP  | REG_WRITE_SUP                                                   ), SPRN_DAC1    , REG_TYPE_SPR),
     dac2    (0, (REG_READ_SUP  | REG_WRITE_SUP                                                   ), SPRN_DAC2    , REG_TYPE_SPR),
     dbcr0   (0, (REG_READ_SUP  | REG_WRITE_SUP   | REG_REQ_SYNC                                  ), SPRN_DBCR0   , REG_TYPE_SPR),
@@ -150,7 +181,7 @@ ppcsimbooke::ppc_regs::ppc_regs(bool c_m, uint64_t pc_):
     ivor14  (0, (REG_READ_SUP  | REG_WRITE_SUP                                                   ), SPRN_IVOR14  , REG_TYPE_SPR),
     ivor15  (0, (REG_READ_SUP  | REG_WRITE_SUP                                                   ), SPRN_IVOR15  , REG_TYPE_SPR),
     ivpr    (0, (REG_READ_SUP  | REG_WRITE_SUP                                                   ), SPRN_IVPR    , REG_TYPE_SPR),
-    lr      (0, (REG_READ_SUP  | REG_WRITE_SUP  | REG_READ_USR | REG_WRITE_USR                   ), SPRN_LR      , REG_TYPE_SPR),
+    lr      (hot.lr,  0, (REG_READ_SUP  | REG_WRITE_SUP  | REG_READ_USR | REG_WRITE_USR                   ), SPRN_LR      , REG_TYPE_SPR),
     pid0    (0, (REG_READ_SUP  | REG_WRITE_SUP                                                   ), SPRN_PID0    , REG_TYPE_SPR),
     pid1    (0, (REG_READ_SUP  | REG_WRITE_SUP                                                   ), SPRN_PID1    , REG_TYPE_SPR),
     pid2    (0, (REG_READ_SUP  | REG_WRITE_SUP                                                   ), SPRN_PID2    , REG_TYPE_SPR),
@@ -171,7 +202,7 @@ ppcsimbooke::ppc_regs::ppc_regs(bool c_m, uint64_t pc_):
     tcr     (0, (REG_READ_SUP  | REG_WRITE_SUP                                                   ), SPRN_TCR     , REG_TYPE_SPR),
     tsr     (0, (REG_READ_SUP  | REG_WRITE_SUP                                                   ), SPRN_TSR     , REG_TYPE_SPR),
     usprg0  (0, (REG_READ_SUP  | REG_WRITE_SUP  | REG_READ_USR  | REG_WRITE_USR                  ), SPRN_USPRG0  , REG_TYPE_SPR),
-    xer     (0, (REG_READ_SUP  | REG_WRITE_SUP  | REG_READ_USR  | REG_WRITE_USR                  ), SPRN_XER     , REG_TYPE_SPR),
+    xer     (hot.xer, 0, (REG_READ_SUP  | REG_WRITE_SUP  | REG_READ_USR  | REG_WRITE_USR                  ), SPRN_XER     , REG_TYPE_SPR),
 
     bbear   (0, (REG_READ_SUP  | REG_WRITE_SUP  | REG_READ_USR  | REG_WRITE_USR   | REG_REQ_SYNC ), SPRN_BBEAR   , REG_TYPE_SPR),
     bbtar   (0, (REG_READ_SUP  | REG_WRITE_SUP  | REG_READ_USR  | REG_WRITE_USR   | REG_REQ_SYNC ), SPRN_BBTAR   , REG_TYPE_SPR),
@@ -230,9 +261,10 @@ ppcsimbooke::ppc_regs::ppc_regs(bool c_m, uint64_t pc_):
     upmc0   (0, 0, PMRN_UPMC0   , REG_TYPE_PMR),
     upmc1   (0, 0, PMRN_UPMC1   , REG_TYPE_PMR),
     upmc2   (0, 0, PMRN_UPMC2   , REG_TYPE_PMR),
-    upmc3   (0, 0, PMRN_UPMC2   , REG_TYPE_PMR)
+    upmc3   (0, 0, PMRN_UPMC3   , REG_TYPE_PMR)
 {
     // Initialize value ptrs
+    std::fill(m_ireg, m_ireg + REG_N_IDS, static_cast<ppc_reg64*>(NULL));
     m_reg["msr"]        = &(msr     );      m_ireg[REG_MSR]         = m_reg["msr"];
     m_reg["cr"]         = &(cr      );      m_ireg[REG_CR]          = m_reg["cr"];
     m_reg["acc"]        = &(acc     );      m_ireg[REG_ACC]         = m_reg["acc"];
@@ -409,6 +441,7 @@ ppcsimbooke::ppc_regs::ppc_regs(bool c_m, uint64_t pc_):
 
 // Update CR0
 void ppcsimbooke::ppc_regs::update_cr0(uint64_t value){
+    sync_flags();
     int c;
 
     if unlikely(cm) {
@@ -434,6 +467,17 @@ void ppcsimbooke::ppc_regs::update_cr0(uint64_t value){
     cr |= ((uint32_t)c << 28);
 }
 
+// Compute all pending CR0/XER updates.
+// XER goes first, since CR0[SO] is a copy of XER[SO].
+void ppcsimbooke::ppc_regs::materialize_flags(){
+    uint8_t pending = lazy_pending;
+    lazy_pending = 0;
+
+    if(pending & LAZY_CA)   { update_xer_ca_host(lazy_ca_flags);       }
+    if(pending & LAZY_SO_OV){ update_xer_so_ov_host(lazy_so_ov_flags); }
+    if(pending & LAZY_CR0)  { update_cr0_host(lazy_cr0_flags);         }
+}
+
 // Update CR0 using host flags
 void ppcsimbooke::ppc_regs::update_cr0_host(x86_flags &hf){
     int c = 0;
@@ -452,6 +496,7 @@ void ppcsimbooke::ppc_regs::update_cr0_host(x86_flags &hf){
 // Updates CR[bf] with val i.e CR[bf] <- (val & 0xf)
 // bf may range from [0:7]
 void ppcsimbooke::ppc_regs::update_crF(unsigned bf, unsigned val){
+    sync_flags();
     bf &= 0x7;
     val &= 0xf;
     cr &= ~( 0xf << (7 - bf)*4 );
@@ -460,11 +505,13 @@ void ppcsimbooke::ppc_regs::update_crF(unsigned bf, unsigned val){
 
 // Get crF  ( F -> [0:7] )
 unsigned ppcsimbooke::ppc_regs::get_crF(unsigned bf){
+    sync_flags();
     return (cr >> (7 - bf)*4) & 0xf;
 }
 
 // Update CR by exact field value [0:31]
 void ppcsimbooke::ppc_regs::update_crf(unsigned field, bool value){
+    sync_flags();
     field &= 0x1f;
     value &= 0x1;
     cr &= ~(0x1 << (31 - field));
@@ -473,10 +520,12 @@ void ppcsimbooke::ppc_regs::update_crf(unsigned field, bool value){
 
 // Get CR bit at exact field
 bool ppcsimbooke::ppc_regs::get_crf(unsigned field){
+    sync_flags();
     return (cr >> (31 - field)) & 0x1;
 }
 
 void ppcsimbooke::ppc_regs::update_xerF(unsigned bf, unsigned val){
+    sync_flags();
     bf &= 0x7;
     val &= 0xf;
     xer &= ~( 0xf << (7 - bf)*4 );
@@ -484,10 +533,12 @@ void ppcsimbooke::ppc_regs::update_xerF(unsigned bf, unsigned val){
 }
 
 unsigned ppcsimbooke::ppc_regs::get_xerF(unsigned bf){
+    sync_flags();
     return (xer >> (7 - bf)*4) & 0xf;
 }
 
 void ppcsimbooke::ppc_regs::update_xerf(unsigned field, bool value){
+    sync_flags();
     field &= 0x1f;
     value &= 0x1;
     xer &= ~(0x1 << (31 - field));
@@ -495,6 +546,7 @@ void ppcsimbooke::ppc_regs::update_xerf(unsigned field, bool value){
 }
 
 bool ppcsimbooke::ppc_regs::get_xerf(unsigned field){
+    sync_flags();
     return (xer >> (31 - field)) & 0x1;
 }
 
@@ -502,6 +554,7 @@ bool ppcsimbooke::ppc_regs::get_xerf(unsigned field){
 // so_ov is a 2 bit value with ((XER[SO] << 1) | XER[OV])
 // NOTE : since XER[32:35] = { SO, OV, CA, RESERVED } , hence XER = XER | (so_ov << 30)
 void ppcsimbooke::ppc_regs::update_xer_so_ov(uint8_t so_ov){
+    sync_flags();
     xer &= ~((uint32_t)0x3 << 30);
     xer |= (static_cast<uint64_t>(so_ov) << 30);
 }
@@ -515,27 +568,31 @@ void ppcsimbooke::ppc_regs::update_xer_so_ov_host(x86_flags &hf){
 
 // Update XER[CA]
 void ppcsimbooke::ppc_regs::update_xer_ca(bool value){
+    sync_flags();
     uint32_t val = (value) ? 1:0;
-    xer &= XER_CA;                              // clear XER[CA]
+    xer &= ~XER_CA;                             // clear XER[CA]
     xer |= val << RSHIFT<XER_CA>::VAL;          // Insert value into XER[CA]
 }
 
 // Update XER[CA] using host flags
 void ppcsimbooke::ppc_regs::update_xer_ca_host(x86_flags &hf){
-    xer &= XER_CA;                                                  // clear XER[CA]
+    xer &= ~XER_CA;                                                 // clear XER[CA]
     xer |= static_cast<uint64_t>(hf.cf) << RSHIFT<XER_CA>::VAL;     // Insert value into XER[CA]
 }
 
 // Get XER[SO]
 bool ppcsimbooke::ppc_regs::get_xer_so(){
+    sync_flags();
     return (xer & XER_SO) ? 1:0;
 }
 
 bool ppcsimbooke::ppc_regs::get_xer_ca(){
+    sync_flags();
     return (xer & XER_CA) ? 1:0;
 }
 
 bool ppcsimbooke::ppc_regs::get_xer_ov(){
+    sync_flags();
     return (xer & XER_OV) ? 1:0;
 }
 
@@ -7,38 +7,79 @@
 
 namespace ppcsimbooke {
 
+    // forward declarations
+    namespace ppcsimbooke_cpu {
+        class cpu;
+    }
+    struct instr_call;
+
+    // function pointer type for opcode handlers ( one per ppc opcode, defined in cpu_ppc_instr.cc )
+    typedef void (*ppc_opc_fun_ptr)(ppcsimbooke_cpu::cpu *, instr_call *);
+
     ///////////////////////////////////////////////////////////////////////////////////////////////////////////
     // instruction call frame
     ///////////////////////////////////////////////////////////////////////////////////////////////////////////
     
     // instruction call frame
-    static const int N_IC_ARGS = 6;           // Max arguments supported
+    static const int N_IC_ARGS = 5;           // Max arguments supported ( no ppc opcode has more than 5 operands )
+
+    // Strings of call frames ( opcode names & display formats ).
+    // Interned for good, so that a call frame only needs a 16 bit id of each. Id 0 is "".
+    struct instr_strtab {
+        static uint16_t    intern(const char* s);
+        static const char* str(uint16_t id);
+    };
 
+    // Opcode name of a call frame.
+    // Keeps an interned id ( see instr_strtab ), so call frames stay small & trivially copyable.
+    // Compares by value, like a std::string.
+    struct instr_name {
+        uint16_t      id;
+
+        instr_name(const char* _s = "") : id(instr_strtab::intern(_s)) {}
+        const char* c_str() const                  { return instr_strtab::str(id);   }
+        operator std::string() const               { return std::string(c_str());    }
+        bool operator==(const char* o) const       { return strcmp(c_str(), o) == 0; }
+        bool operator!=(const char* o) const       { return strcmp(c_str(), o) != 0; }
+        bool operator==(const std::string& o) const { return o == c_str();           }
+        bool operator!=(const std::string& o) const { return o != c_str();           }
+    };
+    inline bool operator==(const std::string& a, const instr_name& b){ return b == a; }
+    inline bool operator!=(const std::string& a, const instr_name& b){ return b != a; }
+    inline std::string operator+(const std::string& a, const instr_name& b){ return a + b.c_str(); }
+    inline std::ostream& operator<<(std::ostream& ostr, const instr_name& n){ ostr << n.c_str(); return ostr; }
+
+    // Decoded instr. Used as is by all execution engines, so it's kept trivially copyable ( no strings )
+    // & within a cache line, with fields used by handlers first. Textual form ( get_instr_str() etc. ) is
+    // only produced when somebody asks for it ( disassembly, tracing, python ).
     struct instr_call {
         struct instr_arg {
             size_t  v;         // Actual argument
-            size_t  p;         // Indirect Pointer to the m_ireghash entry
-            bool    t;         // Argument type (1=register, 0=value)
         };
-        std::string   opcname;              // Opcode name
-        std::string   fmt;                  // Display format
-        uint32_t      opc;                  // opcode (full opcode apart from the operands)
-        uint64_t      hv;                   // opcode hash value (used for implementation function selection)
-        int           nargs;                // Number of arguments
+        // hot
+        ppc_opc_fun_ptr fptr;               // opcode handler (resolved once at decode time)
         instr_arg     arg[N_IC_ARGS];       // Argument array
+        uint64_t      hv;                   // opcode hash value (opcode << 32 | index in ppc opcode table)
+        // cold
+        instr_name    opcname;              // Opcode name
+        uint16_t      fmt;                  // Display format ( interned, see instr_strtab )
+        uint8_t       nargs;                // Number of arguments
+        uint8_t       argt;                 // Argument types ( bit n set if arg n is a register )
     
         instr_call();
+        // opcode (full opcode apart from the operands)
+        uint32_t opc() const { return static_cast<uint32_t>(hv >> 32); }
+        // If argument n is a register
+        bool is_reg(int n) const { return (argt >> n) & 1; }
         // Dump state
         void dump_state() const;
         // print instruction
         void print_instr() const;
         // Get instruction representation in string form ( Used for DEBUG logs )
         char* get_instr_str() const;
-        // Get function for boost::python. We don't really need these in our c++ library
-        template <int ARG_NUM> instr_arg& getarg(){
-            return arg[ARG_NUM];
-        }
     };
+    static_assert(std::is_trivially_copyable<instr_call>::value, "instr_call should be trivially copyable");
+    static_assert(sizeof(instr_call) <= 64, "instr_call should fit in a cache line");
     
     inline std::ostream& operator<<(std::ostream& ostr, const instr_call& i){
         ostr << i.get_instr_str() << " ";
@@ -72,30 +113,41 @@ namespace ppcsimbooke {
     static const size_t PPC_NSPRS   = 1024;
     static const size_t PPC_NPMRS   = 1024;
     
+    // PPC register value
+    union ppc_val64 {
+        int32_t          s32v[2];     // pair of signed 32 bit values
+        uint32_t         u32v[2];     // pair of unsigned 32 bit values
+        int64_t          s64v;        // singned 64bit value
+        uint64_t         u64v;        // unsigned 64bit value
+    };
+
     // PPC register (64 bit only)
     struct ppc_reg64 {
-        union u_reg64 {
-            int32_t          s32v[2];     // pair of signed 32 bit values
-            uint32_t         u32v[2];     // pair of unsigned 32 bit values
-            int64_t          s64v;        // singned 64bit value
-            uint64_t         u64v;        // unsigned 64bit value
-    
-            u_reg64(uint64_t v): u64v(v) {}
-        } value;
-    
+        typedef ppc_val64 u_reg64;
+
+        u_reg64&         value;     // register value ( in store, or in ppc_hot_regs for hot registers )
         const uint64_t   fvalue;    // fvalue is used in case register is read only
         const uint64_t   attr;      // attribute ( permissions etc. )
         const int        indx;      // register index no
         const int        type;      // register type
+        u_reg64          store;     // value of a register which isn't hot
     
         // Constructors
         ppc_reg64(uint64_t val, uint64_t attr_, int regno, int type_):
-            value(val),
+            value(store),
+            fvalue(val),
+            attr(attr_),
+            indx(regno),
+            type(type_)
+        { value.u64v = val; }
+        // Register whose value lives in slot
+        ppc_reg64(u_reg64& slot, uint64_t val, uint64_t attr_, int regno, int type_):
+            value(slot),
             fvalue(val),
             attr(attr_),
             indx(regno),
             type(type_)
-        {}
+        { value.u64v = val; }
     
         // value.u64v's getter/setter for boost::python
         const uint64_t get_v() const { return value.u64v; }
@@ -115,6 +167,9 @@ namespace ppcsimbooke {
     
         // This data type can't be copied directly
         ppc_reg64& operator=(const ppc_reg64& rreg){ return *this; }
+        private:
+        ppc_reg64(const ppc_reg64&);                 // value may refer to another register file
+        public:
     
         // Allow integers to be directly assigned
         ppc_reg64& operator=(uint64_t v){ value.u64v = v; return *this; }
@@ -132,14 +187,44 @@ namespace ppcsimbooke {
     };
     
     
+    // Registers used by almost every instr.
+    // Kept together as raw values at start of ppc_regs, so they take as few cache lines as possible. Their
+    // ppc_reg64 entries in ppc_regs ( attributes etc. ) refer to these.
+    // NOTE : Block isn't aligned to a cache line. cpus live inside machine, which is allocated by plain new
+    //        ( or by python ), and neither honors over aligned types under c++0x.
+    struct ppc_hot_regs {
+        ppc_val64         gpr[PPC_NGPRS];
+        ppc_val64         cr;
+        ppc_val64         xer;
+        ppc_val64         lr;
+        ppc_val64         ctr;
+        ppc_val64         msr;
+    };
+
     // BookE (e500v2 compliant) PPC register file (this is the file we are gonna use in our cpu)
     struct ppc_regs {
-        // mode
-        bool              cm;
+        // hot state ( hot registers, pc, nip & lazy flags, in that order )
+        ppc_hot_regs      hot;
 
         uint64_t          pc;          // program counter
         uint64_t          nip;         // next instruction pointer
+
+        // Lazy condition codes.
+        // Record forms & carrying/overflow forms only save host flags of the operation. CR0 & XER[SO, OV, CA]
+        // are computed from them when CR or XER is accessed next ( see sync_flags() ).
+        static const uint8_t LAZY_CR0   = 0x1;
+        static const uint8_t LAZY_SO_OV = 0x2;
+        static const uint8_t LAZY_CA    = 0x4;
+
+        x86_flags         lazy_cr0_flags;     // host flags for CR0
+        x86_flags         lazy_so_ov_flags;   // host flags for XER[SO, OV]
+        x86_flags         lazy_ca_flags;      // host flags for XER[CA]
+        uint8_t           lazy_pending;       // LAZY_XXX bits
+
+        // mode
+        bool              cm;
     
+        // cold state
         ppc_reg64         msr;
         ppc_reg64         cr;
         ppc_reg64         acc;
@@ -267,12 +352,39 @@ namespace ppcsimbooke {
         ppc_reg64         upmc3;
     
         // register ptrs
-        std::map<std::string, ppc_reg64*>  m_reg;
-        std::map<int,         ppc_reg64*>  m_ireg;
+        // Register IDs are small integers ( see cpu_ppc_regs.h ), so look up by ID is a plain array index.
+        // NOTE : Only look up is flat. Values still live in named members above ( or in hot ) & attributes
+        //        in each ppc_reg64, which is what RTL, JIT & python address. Nothing checks attributes yet,
+        //        so they aren't in a separate constant table.
+        static const int  REG_N_IDS = REG_PMR0 + PPC_NPMRS;                 // all register IDs are below this
+        std::unordered_map<std::string, ppc_reg64*>  m_reg;
+        ppc_reg64*                                   m_ireg[REG_N_IDS];     // NULL if no such register
+
+        // Register by ID ( NULL if no such register )
+        ppc_reg64* reg_by_id(int regid){
+            return (regid >= 0 && regid < REG_N_IDS) ? m_ireg[regid] : NULL;
+        }
     
         // Constructors
         ppc_regs(bool c_m=0, uint64_t pc_=0xfffffffc);
         
+        // lazy CR0/XER updates ( see lazy_pending )
+        void       set_lazy_cr0(x86_flags &hf){
+            lazy_cr0_flags = hf; lazy_pending |= LAZY_CR0;
+        }
+        void       set_lazy_so_ov(x86_flags &hf){
+            // pending CR0 has to see current XER[SO] & XER[SO] is sticky, so older updates can't be dropped
+            if unlikely(lazy_pending & (LAZY_CR0 | LAZY_SO_OV)){ materialize_flags(); }
+            lazy_so_ov_flags = hf; lazy_pending |= LAZY_SO_OV;
+        }
+        void       set_lazy_ca(x86_flags &hf){
+            lazy_ca_flags = hf; lazy_pending |= LAZY_CA;
+        }
+        void       sync_flags(){                                     // bring CR & XER up to date
+            if unlikely(lazy_pending){ materialize_flags(); }
+        }
+        void       materialize_flags();
+
         // functions operating on CR, XER
         void       update_cr0(uint64_t value=0);                     // Update CR0
         void       update_cr0_host(x86_flags &hf);                   // Update CR0 using host flags
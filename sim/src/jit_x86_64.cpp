@@ -0,0 +1,254 @@
+#include "jit_x86_64.h"
+#include "basic_block.h"
+#include "cpu_ppc.h"
+#include <sys/mman.h>
+#include <unistd.h>
+
+// C++ exception thrown inside a helper ( consumed by rethrow_pending() ).
+// Guest exceptions are left pending in cpu & aren't stored here.
+static thread_local std::exception_ptr  jit_pending_except;
+
+//////////////////////////////////////////////////////////////////////////////////////
+// x86-64 code emitter
+//////////////////////////////////////////////////////////////////////////////////////
+
+// Minimal x86-64 emitter. Only forms needed by block templates are supported.
+// All memory operands are [rbx + disp32] ( rbx holds cpu* inside generated code ).
+namespace {
+    struct x86_64_emitter {
+        std::vector<uint8_t>   buff;
+        std::vector<size_t>    exit_fixups;          // rel32 fields of jumps to epilogue
+
+        // ALU opcodes for "op eax, [rbx+disp32]" & "op eax, imm32"
+        enum { OP_ADD = 0x03, OP_OR = 0x0b, OP_AND = 0x23, OP_SUB = 0x2b, OP_XOR = 0x33 };
+
+        void b(uint8_t v)   { buff.push_back(v); }
+        void d(uint32_t v)  { for(int i=0; i<4; i++){ b((v >> (i*8)) & 0xff); } }
+        void q(uint64_t v)  { for(int i=0; i<8; i++){ b((v >> (i*8)) & 0xff); } }
+
+        void prologue()                          { b(0x53); b(0x48); b(0x89); b(0xfb); }                // push rbx; mov rbx, rdi
+        void epilogue()                          { b(0x5b); b(0xc3); }                                  // pop rbx; ret
+        void xor_eax_eax()                       { b(0x31); b(0xc0); }
+        void mov_eax_mem(int32_t off)            { b(0x8b); b(0x83); d(off); }                          // mov eax, [rbx+off]
+        void mov_mem_rax(int32_t off)            { b(0x48); b(0x89); b(0x83); d(off); }                 // mov [rbx+off], rax
+        void mov_rdx_mem(int32_t off)            { b(0x48); b(0x8b); b(0x93); d(off); }                 // mov rdx, [rbx+off]
+        void lea_rdx_mem(int32_t off)            { b(0x48); b(0x8d); b(0x93); d(off); }                 // lea rdx, [rbx+off]
+        void alu_eax_mem(uint8_t op, int32_t off){ b(op);   b(0x83); d(off); }                          // op eax, [rbx+off]
+        void alu_eax_imm(uint8_t op, uint32_t v) { b(op + 2); d(v); }                                   // op eax, imm32
+        void mov_eax_imm(uint32_t v)             { b(0xb8); d(v); }                                     // mov eax, imm32
+        void mov_rax_imm(uint64_t v)             { b(0x48); b(0xb8); q(v); }                            // mov rax, imm64
+        void rol_eax(uint8_t n)                  { b(0xc1); b(0xc0); b(n); }                            // rol eax, n
+        void movsxd_rax_eax()                    { b(0x48); b(0x63); b(0xc0); }
+        void mov_esi_eax()                       { b(0x89); b(0xc6); }
+        void mov_rdi_rbx()                       { b(0x48); b(0x89); b(0xdf); }
+        void mov_rsi_imm(uint64_t v)             { b(0x48); b(0xbe); q(v); }                            // mov rsi, imm64
+
+        // call absolute address & leave if it returned non zero
+        void call_checked(const void* fn){
+            b(0x49); b(0xbb); q(reinterpret_cast<uint64_t>(fn));      // mov r11, imm64
+            b(0x41); b(0xff); b(0xd3);                                // call r11
+            b(0x85); b(0xc0);                                         // test eax, eax
+            b(0x0f); b(0x85); exit_fixups.push_back(buff.size()); d(0); // jnz epilogue
+        }
+
+        void store_imm64(int32_t off, uint64_t v){ mov_rax_imm(v); mov_mem_rax(off); }
+
+        // success path & common epilogue
+        void finish(){
+            xor_eax_eax();
+            size_t epi = buff.size();
+            epilogue();
+            for(size_t i=0; i<exit_fixups.size(); i++){
+                uint32_t rel = static_cast<uint32_t>(epi - (exit_fixups[i] + 4));
+                for(int j=0; j<4; j++){ buff[exit_fixups[i] + j] = (rel >> (j*8)) & 0xff; }
+            }
+        }
+    };
+}
+
+//////////////////////////////////////////////////////////////////////////////////////
+// helpers ( called from generated code )
+//////////////////////////////////////////////////////////////////////////////////////
+
+int ppcsimbooke::ppcsimbooke_jit::x86_64_jit::call_handler(ppcsimbooke::ppcsimbooke_jit::context *pcpu, ppcsimbooke::instr_call *ic){
+    try {
+        ic->fptr(pcpu, ic);
+    }
+    catch(...){
+        jit_pending_except = std::current_exception();
+        return 1;
+    }
+    return pcpu->exception_pending();
+}
+
+int ppcsimbooke::ppcsimbooke_jit::x86_64_jit::load32(ppcsimbooke::ppcsimbooke_jit::context *pcpu, uint64_t ea, uint64_t *dst){
+    try {
+        uint32_t value = pcpu->rtl_read32(ea);
+        if unlikely(pcpu->exception_pending()){
+            return 1;                               // rD is left untouched on a faulting load
+        }
+        *dst = value;
+    }
+    catch(...){
+        jit_pending_except = std::current_exception();
+        return 1;
+    }
+    return 0;
+}
+
+int ppcsimbooke::ppcsimbooke_jit::x86_64_jit::store32(ppcsimbooke::ppcsimbooke_jit::context *pcpu, uint64_t ea, uint64_t value){
+    try {
+        pcpu->rtl_write32(ea, static_cast<uint32_t>(value));
+    }
+    catch(...){
+        jit_pending_except = std::current_exception();
+        return 1;
+    }
+    return pcpu->exception_pending();
+}
+
+void ppcsimbooke::ppcsimbooke_jit::x86_64_jit::rethrow_pending(){
+    std::exception_ptr e = jit_pending_except;
+    jit_pending_except = std::exception_ptr();
+    std::rethrow_exception(e);
+}
+
+//////////////////////////////////////////////////////////////////////////////////////
+// compiler
+//////////////////////////////////////////////////////////////////////////////////////
+
+bool ppcsimbooke::ppcsimbooke_jit::x86_64_jit::host_supported(){
+#if defined(__x86_64__)
+    return true;
+#else
+    return false;
+#endif
+}
+
+// Compile a basic block into native code.
+// Generated code embeds addresses of bb's call frames, so it's owned by bb.
+ppcsimbooke::ppcsimbooke_jit::jit_block_func_t
+ppcsimbooke::ppcsimbooke_jit::x86_64_jit::compile(ppcsimbooke::ppcsimbooke_jit::context& ctx,
+        ppcsimbooke::ppcsimbooke_basic_block::basic_block& bb, size_t& codesize){
+    LOG_DEBUG4(MSG_FUNC_START);
+
+    LASSERT_THROW_UNLIKELY(host_supported(), sim_except(SIM_EXCEPT_ENOEXEC, "JIT is only supported on x86-64 hosts"), DEBUG4);
+
+    using ppcsimbooke::ppcsimbooke_basic_block::OPCODE_SIZE;
+
+    x86_64_emitter  e;
+    uint8_t*        base    = reinterpret_cast<uint8_t*>(&ctx);
+    ppc_regs&       regs    = ctx.m_cpu_regs;
+    uint64_t        mask    = ctx.get_pc_mask();
+    int32_t         off_pc  = reinterpret_cast<uint8_t*>(&regs.pc)  - base;
+    int32_t         off_nip = reinterpret_cast<uint8_t*>(&regs.nip) - base;
+    bool            synced  = false;                 // if PC/NIP were moved past last instruction ( by it's handler )
+#define GPR_OFF(n)  static_cast<int32_t>(reinterpret_cast<uint8_t*>(&regs.hot.gpr[(n) & 0x1f].u64v) - base)
+
+    static const std::string ir_opc;                 // IR pseudo ops always take generic template
+
+    e.prologue();
+
+    for(size_t i=0; i<bb.transopscount; i++){
+        instr_call&        ic  = bb.transops[i];
+        const std::string  opc = (ppcsimbooke::ppcsimbooke_dis::ppcdis::is_ir_op(ic)) ? ir_opc : std::string(ic.opcname);
+        uint64_t           ip  = (bb.bip.ip + i*OPCODE_SIZE) & mask;
+        size_t             a0  = ic.arg[0].v, a1 = ic.arg[1].v, a2 = ic.arg[2].v;
+
+        synced = false;
+
+        // Integer templates. Results follow RTL semantics exactly ( arithmetic results are
+        // sign extended, logical ones zero extended to 64 bits ).
+        if(opc == "addi" || opc == "addis"){
+            uint32_t imm = (opc == "addi") ? static_cast<int32_t>(static_cast<int16_t>(a2))
+                                           : static_cast<int32_t>(static_cast<int16_t>(a2)) << 16;
+            if(a1){ e.mov_eax_mem(GPR_OFF(a1)); e.alu_eax_imm(x86_64_emitter::OP_ADD, imm); }
+            else  { e.mov_eax_imm(imm); }
+            e.movsxd_rax_eax();
+            e.mov_mem_rax(GPR_OFF(a0));
+        }else if(opc == "add" || opc == "subf"){
+            // subf rD, rA, rB = rB - rA
+            if(opc == "add"){ e.mov_eax_mem(GPR_OFF(a1)); e.alu_eax_mem(x86_64_emitter::OP_ADD, GPR_OFF(a2)); }
+            else            { e.mov_eax_mem(GPR_OFF(a2)); e.alu_eax_mem(x86_64_emitter::OP_SUB, GPR_OFF(a1)); }
+            e.movsxd_rax_eax();
+            e.mov_mem_rax(GPR_OFF(a0));
+        }else if(opc == "or" || opc == "and" || opc == "xor"){
+            uint8_t op = (opc == "or") ? x86_64_emitter::OP_OR : (opc == "and") ? x86_64_emitter::OP_AND : x86_64_emitter::OP_XOR;
+            e.mov_eax_mem(GPR_OFF(a1));
+            e.alu_eax_mem(op, GPR_OFF(a2));
+            e.mov_mem_rax(GPR_OFF(a0));              // upper half of rax is already zero
+        }else if(opc == "ori" || opc == "oris" || opc == "xori" || opc == "xoris"){
+            uint8_t  op  = (opc[0] == 'o') ? x86_64_emitter::OP_OR : x86_64_emitter::OP_XOR;
+            uint32_t imm = static_cast<uint16_t>(a2);
+            if(opc[opc.size()-1] == 's'){ imm <<= 16; }
+            e.mov_eax_mem(GPR_OFF(a1));
+            e.alu_eax_imm(op, imm);
+            e.mov_mem_rax(GPR_OFF(a0));
+        }else if(opc == "rlwinm"){
+            uint32_t m = static_cast<uint32_t>(gen_bmask_rng<uint64_t>(ic.arg[3].v + 32, ic.arg[4].v + 32));
+            e.mov_eax_mem(GPR_OFF(a1));
+            e.rol_eax(a2 & 0x1f);
+            e.alu_eax_imm(x86_64_emitter::OP_AND, m);
+            e.mov_mem_rax(GPR_OFF(a0));
+        }else if(opc == "lwz" || opc == "stw"){
+            // PC/NIP must be precise if access faults
+            e.store_imm64(off_pc,  ip);
+            e.store_imm64(off_nip, (ip + OPCODE_SIZE) & mask);
+
+            // ea = (rA|0) + EXTS(d) ( 32 bit wrap around )
+            uint32_t d = static_cast<int32_t>(static_cast<int16_t>(a1));
+            if(a2){ e.mov_eax_mem(GPR_OFF(a2)); e.alu_eax_imm(x86_64_emitter::OP_ADD, d); }
+            else  { e.mov_eax_imm(d); }
+            e.mov_esi_eax();
+            e.mov_rdi_rbx();
+            if(opc == "lwz"){
+                e.lea_rdx_mem(GPR_OFF(a0));
+                e.call_checked(reinterpret_cast<const void*>(&x86_64_jit::load32));
+            }else{
+                e.mov_rdx_mem(GPR_OFF(a0));
+                e.call_checked(reinterpret_cast<const void*>(&x86_64_jit::store32));
+            }
+            // PC still points at this instr. Fall through is set at block end, if it's the last one.
+        }else{
+            // Generic template : call opcode handler ( which moves PC/NIP on it's own )
+            if unlikely(ic.fptr == NULL){ ic.fptr = ctx.get_opc_impl(ic.hv); }
+            e.store_imm64(off_pc,  ip);
+            e.store_imm64(off_nip, ip);
+            e.mov_rdi_rbx();
+            e.mov_rsi_imm(reinterpret_cast<uint64_t>(&ic));
+            e.call_checked(reinterpret_cast<const void*>(&x86_64_jit::call_handler));
+            synced = (i == (bb.transopscount-1));
+        }
+    }
+#undef GPR_OFF
+
+    // Block ended with an inline template ( incl. lwz/stw ). Move to fall through address.
+    if(!synced){
+        uint64_t next = (bb.bip.ip + bb.transopscount*OPCODE_SIZE) & mask;
+        e.store_imm64(off_pc,  next);
+        e.store_imm64(off_nip, next);
+    }
+    e.finish();
+
+    // Copy to executable memory
+    long   pgsz  = sysconf(_SC_PAGESIZE);
+    size_t size  = ((e.buff.size() + pgsz - 1)/pgsz)*pgsz;
+    void*  code  = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    LASSERT_THROW_UNLIKELY(code != MAP_FAILED, sim_except(SIM_EXCEPT_ENOMEM, "Couldn't allocate JIT code buffer"), DEBUG4);
+
+    memcpy(code, e.buff.data(), e.buff.size());
+    if unlikely(mprotect(code, size, PROT_READ | PROT_EXEC) != 0){
+        munmap(code, size);
+        LTHROW(sim_except(SIM_EXCEPT_EACCES, "Couldn't make JIT code buffer executable"), DEBUG4);
+    }
+
+    codesize = size;
+
+    LOG_DEBUG4("Compiled ", bb.bip, " into ", e.buff.size(), " bytes of native code", std::endl);
+    LOG_DEBUG4(MSG_FUNC_END);
+    return reinterpret_cast<jit_block_func_t>(code);
+}
+
+void ppcsimbooke::ppcsimbooke_jit::x86_64_jit::free_code(ppcsimbooke::ppcsimbooke_jit::jit_block_func_t code, size_t codesize){
+    if(code){ munmap(reinterpret_cast<void*>(code), codesize); }
+}
@@ -0,0 +1,57 @@
+#ifndef JIT_X86_64_H_
+#define JIT_X86_64_H_
+
+#include "config.h"
+#include "globals.h"
+
+namespace ppcsimbooke {
+    // forward declarations
+    namespace ppcsimbooke_cpu {
+        class cpu;
+    }
+    namespace ppcsimbooke_basic_block {
+        struct basic_block;
+    }
+
+    namespace ppcsimbooke_jit {
+
+        typedef ppcsimbooke_cpu::cpu context;
+
+        // native code for a basic block.
+        // Returns 0 on success & non zero if a guest exception was raised ( see cpu::exception_pending() )
+        // or a C++ exception was thrown ( see x86_64_jit::rethrow_pending() ).
+        typedef int (*jit_block_func_t)(context *pcpu);
+
+        // no of hits after which a basic block is compiled
+        static const uint32_t JIT_HOT_THRESHOLD = 16;
+
+        //////////////////////////////////////////////////////////////////////////////////
+        // x86-64 template JIT
+        //////////////////////////////////////////////////////////////////////////////////
+        //
+        // Each instruction of a basic block is translated into a fixed x86-64 template.
+        // Simple integer instructions ( addi, add, subf, logical ops, rlwinm ) are emitted inline
+        // and act directly on guest GPRs through a base register ( rbx = cpu* ). lwz/stw compute
+        // their EA inline and call back into cpu::read32()/write32(). Everything else is a call to
+        // it's opcode handler.
+        //
+        // Exceptions can't be unwound through generated code, so all calls go through helpers
+        // which catch them. Generated code returns early on a pending guest exception or a caught
+        // C++ exception ( which is rethrown by caller ).
+        class x86_64_jit {
+            public:
+            static bool              host_supported();                      // if host can run generated code
+            static jit_block_func_t  compile(context& ctx, ppcsimbooke_basic_block::basic_block& bb, size_t& codesize);
+            static void              free_code(jit_block_func_t code, size_t codesize);
+            static void              rethrow_pending();                     // rethrow exception raised inside generated code
+
+            private:
+            // helpers called from generated code ( these never throw )
+            static int               call_handler(context *pcpu, instr_call *ic);
+            static int               load32(context *pcpu, uint64_t ea, uint64_t *dst);
+            static int               store32(context *pcpu, uint64_t ea, uint64_t value);
+        };
+    }
+}
+
+#endif
@@ -1,4 +1,7 @@
 #include "memory.h"
+#if defined CONFIG_MEM_FLAT
+#include <sys/mman.h>
+#endif
 
 // Member functions
 
@@ -121,26 +124,86 @@ uint8_t* ppcsimbooke::ppcsimbooke_memory::memory::paddr_to_hostpage(uint64_t pad
     LOG_DEBUG4(MSG_FUNC_START);
    
     uint64_t pageno = (paddr >> MIN_PGSZ_SHIFT);
-    // Search in cache first
-    if likely(mem_tgt_modified == 0){
-        if likely((page_hash_cache.find(pageno) != page_hash_cache.end()) && page_hash_cache[pageno] != NULL){
-            return page_hash_cache[pageno];
-        }
+    // DDR backed by flat region ( pages of spans shared with other targets are looked up below )
+    if likely(is_flat(paddr)){
+        return m_flat + (pageno << MIN_PGSZ_SHIFT);
     }
 
-    mem_tgt_iter iter_this = select_mem_tgt(paddr);
-    LASSERT_THROW_UNLIKELY(iter_this != mem_tgt.end(), sim_except(SIM_EXCEPT_EFAULT, "No valid target found for this address"), DEBUG4);
+    // Search page table next
+    LASSERT_THROW_UNLIKELY(pageno <= pn_max, sim_except(SIM_EXCEPT_EFAULT, "No valid target found for this address"), DEBUG4);
+    pt_l1_entry& l1 = m_pt[pageno >> PT_L2_BITS];
+    size_t       l2 = pageno & (PT_L2_SIZE - 1);
+    if likely(l1.pages && l1.pages[l2]){
+        return l1.pages[l2];
+    }
 
-    if(!iter_this->page_hash[pageno]){
-        iter_this->page_hash[pageno] = new uint8_t[MIN_PGSZ];
-        page_hash_cache[pageno] = iter_this->page_hash[pageno];   // Cache this newly created page
+    // First touch. Target owning whole span is already known, if there is one.
+    t_mem_tgt* tgt = l1.tgt;
+    if(!tgt){
+        mem_tgt_iter iter_this = select_mem_tgt(paddr);
+        LASSERT_THROW_UNLIKELY(iter_this != mem_tgt.end(), sim_except(SIM_EXCEPT_EFAULT, "No valid target found for this address"), DEBUG4);
+        tgt = &(*iter_this);
     }
 
-    // Clear mem_tgt_modified, just in case it was already set
-    mem_tgt_modified = 0;
+    if(!l1.pages){
+        l1.pages = new uint8_t*[PT_L2_SIZE]();
+    }
+
+    if(m_flat && tgt->tgt_type == TGT_DDR){
+        // DDR page in a span shared with ( or shadowing ) some other target
+        l1.pages[l2] = m_flat + (pageno << MIN_PGSZ_SHIFT);
+    }else{
+        uint8_t*& page = tgt->page_hash[pageno];
+        if(!page){
+            page = new uint8_t[MIN_PGSZ]();          // zero filled, like flat DDR
+        }
+        l1.pages[l2] = page;
+    }
+
+    LOG_DEBUG4(MSG_FUNC_END);
+    return l1.pages[l2];
+}
+
+/*
+ * @func : update_pt
+ * @args : newly registered memory target
+ *
+ * @brief: re-resolve owner ( & flatness ) of every page table span tgt overlaps & drop leaves of pages it covers
+ *         ( they may belong to tgt now ). Rest of the page table stays as it is.
+ */
+void ppcsimbooke::ppcsimbooke_memory::memory::update_pt(const t_mem_tgt &tgt){
+    LOG_DEBUG4(MSG_FUNC_START);
+
+    uint64_t pn_first = tgt.baseaddr >> MIN_PGSZ_SHIFT;
+    uint64_t pn_last  = min(tgt.endaddr, pa_max) >> MIN_PGSZ_SHIFT;
+
+    for(uint64_t i = (pn_first >> PT_L2_BITS); i <= (pn_last >> PT_L2_BITS) && i < m_pt.size(); i++){
+        uint64_t span_base = (i << PT_L2_BITS) << MIN_PGSZ_SHIFT;
+        uint64_t span_end  = span_base + (PT_L2_SIZE << MIN_PGSZ_SHIFT) - 1;
+
+        // Highest priority target overlapping the span owns it, if it covers all of it. Span is flat
+        // only if no other kind of target overlaps it.
+        t_mem_tgt* best = NULL;
+        bool       flat = (m_flat != NULL);
+        for(mem_tgt_iter iter_this = mem_tgt.begin(); iter_this != mem_tgt.end(); iter_this++){
+            if(iter_this->baseaddr > span_end || iter_this->endaddr < span_base){ continue; }
+            if(!best || iter_this->priority > best->priority){ best = &(*iter_this); }
+            if(iter_this->tgt_type != TGT_DDR){ flat = false; }
+        }
+        m_pt[i].tgt  = (best && best->baseaddr <= span_base && best->endaddr >= span_end) ? best : NULL;
+        m_pt[i].flat = flat;
+
+        // Drop leaves of pages covered by tgt
+        if(m_pt[i].pages){
+            uint64_t first = max(pn_first, (i << PT_L2_BITS));
+            uint64_t last  = min(pn_last, ((i + 1) << PT_L2_BITS) - 1);
+            for(uint64_t pn = first; pn <= last; pn++){
+                m_pt[i].pages[pn & (PT_L2_SIZE - 1)] = NULL;
+            }
+        }
+    }
 
     LOG_DEBUG4(MSG_FUNC_END);
-    return iter_this->page_hash[pageno];
 }
 
 /*
@@ -158,6 +221,77 @@ uint8_t* ppcsimbooke::ppcsimbooke_memory::memory::paddr_to_hostaddr(uint64_t pad
     return (paddr_to_hostpage(paddr) + offset);
 }
 
+/*
+ * @func : init_flat
+ * @args : none
+ *
+ * @brief: reserve flat backing for DDR targets ( see m_flat ). Falls back to page hash if it can't.
+ */
+void ppcsimbooke::ppcsimbooke_memory::memory::init_flat(){
+    LOG_DEBUG4(MSG_FUNC_START);
+    m_flat = NULL;
+#if defined CONFIG_MEM_FLAT
+    if(static_cast<uint64_t>(static_cast<size_t>(pa_max)) != pa_max){   // no room on 32 bit hosts
+        LOG_DEBUG4(MSG_FUNC_END);
+        return;
+    }
+    void* p = mmap(NULL, pa_max + 1, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+    if unlikely(p == MAP_FAILED){
+        std::cerr << "Warning !!! Couldn't reserve flat memory. Falling back to page hash." << std::endl;
+        LOG_DEBUG4(MSG_FUNC_END);
+        return;
+    }
+#if defined CONFIG_MEM_FLAT_HUGEPAGE && defined MADV_HUGEPAGE
+    madvise(p, pa_max + 1, MADV_HUGEPAGE);
+#endif
+    m_flat = static_cast<uint8_t*>(p);
+#endif
+    LOG_DEBUG4(MSG_FUNC_END);
+}
+
+/*
+ * @func : free_flat
+ * @args : none
+ *
+ * @brief: release flat backing
+ */
+void ppcsimbooke::ppcsimbooke_memory::memory::free_flat(){
+    LOG_DEBUG4(MSG_FUNC_START);
+#if defined CONFIG_MEM_FLAT
+    if(m_flat){ munmap(m_flat, pa_max + 1); }
+#endif
+    m_flat = NULL;
+    LOG_DEBUG4(MSG_FUNC_END);
+}
+
+/*
+ * @func : flat_pages
+ * @args : memory target
+ *
+ * @brief: pages of tgt in flat backing, which were ever touched ( host resident ). Used only for dumps.
+ * @return: map of page no to host page
+ */
+std::map<uint64_t, uint8_t*> ppcsimbooke::ppcsimbooke_memory::memory::flat_pages(const t_mem_tgt &tgt){
+    LOG_DEBUG4(MSG_FUNC_START);
+    std::map<uint64_t, uint8_t*> pages;
+#if defined CONFIG_MEM_FLAT
+    static const uint64_t chunk = (1ULL << 30);               // scan 1G at a time
+    std::vector<unsigned char> vec(chunk >> MIN_PGSZ_SHIFT);
+    uint64_t end = min(tgt.endaddr, pa_max) + 1;
+
+    for(uint64_t addr = rnd_pgsz_p(tgt.baseaddr); m_flat && addr < end; addr += chunk){
+        size_t len = min(chunk, end - addr);
+        if(mincore(m_flat + addr, len, &vec[0])){ continue; }
+        for(size_t i=0; i<(len >> MIN_PGSZ_SHIFT); i++){
+            uint64_t pa = addr + (i << MIN_PGSZ_SHIFT);
+            if((vec[i] & 1) && is_flat_page(pa)){ pages[pa >> MIN_PGSZ_SHIFT] = m_flat + pa; }
+        }
+    }
+#endif
+    LOG_DEBUG4(MSG_FUNC_END);
+    return pages;
+}
+
 /*
  * @func : register_memory_target
  * @args : base address, size, name, flags, memory target type
@@ -200,6 +334,12 @@ void ppcsimbooke::ppcsimbooke_memory::memory::register_memory_target(uint64_t ba
 
     n_tgts++;
     mem_tgt.push_back(l_tgt);
+    update_pt(mem_tgt.back());
+
+    // Only DDR is backed flat
+    if(tgt_type != TGT_DDR){
+        m_flat_holes.push_back(std::make_pair(l_tgt.baseaddr, l_tgt.endaddr));
+    }
 }
 
 /*
@@ -228,8 +368,8 @@ void ppcsimbooke::ppcsimbooke_memory::memory::dump_all_page_maps(){
     for(mem_tgt_iter iter_this = mem_tgt.begin(); iter_this != mem_tgt.end(); iter_this++){
         dump_mem_tgt2(*iter_this);
         std::cout << BAR0 << std::endl;
-        for(page_hash_iter iter_this_1 = iter_this->page_hash.begin();
-                iter_this_1 != iter_this->page_hash.end(); iter_this_1++){
+        std::map<uint64_t, uint8_t*> pages = (m_flat && iter_this->tgt_type == TGT_DDR) ? flat_pages(*iter_this) : iter_this->page_hash;
+        for(page_hash_iter iter_this_1 = pages.begin(); iter_this_1 != pages.end(); iter_this_1++){
             std::cout << std::hex << std::showbase << "pghsh[" << iter_this_1->first <<
                 "] = " << (uint64_t)iter_this_1->second << std::endl;
         }
@@ -256,8 +396,8 @@ void ppcsimbooke::ppcsimbooke_memory::memory::dump_all_pages(std::ostream &ostr)
     ostr << std::noshowbase;
 
     for(mem_tgt_iter iter_this = mem_tgt.begin(); iter_this != mem_tgt.end(); iter_this++){
-        for(page_hash_iter iter_this_1 = iter_this->page_hash.begin();
-                iter_this_1 != iter_this->page_hash.end(); iter_this_1++){
+        std::map<uint64_t, uint8_t*> pages = (m_flat && iter_this->tgt_type == TGT_DDR) ? flat_pages(*iter_this) : iter_this->page_hash;
+        for(page_hash_iter iter_this_1 = pages.begin(); iter_this_1 != pages.end(); iter_this_1++){
             // Print base address of this page
             ostr << BAR0 << std::endl;
             ostr << "ra:" << "0x" << std::hex << std::setfill('0') << std::setw(16) << (iter_this_1->first << MIN_PGSZ_SHIFT) << std::endl;
@@ -326,6 +466,35 @@ void ppcsimbooke::ppcsimbooke_memory::memory::dump_page(uint64_t addr, std::ostr
     LOG_DEBUG4(MSG_FUNC_END);
 }
 
+/*
+ * @func : write_gen
+ * @args : none
+ *
+ * @brief : returns write generation ( sum of host & all writers' write counts )
+ */
+uint64_t ppcsimbooke::ppcsimbooke_memory::memory::write_gen() const {
+    size_t   n   = m_nwriters.load(std::memory_order_acquire);
+    uint64_t gen = m_host_writes.load(std::memory_order_relaxed);
+    for(size_t i=0; i<n; i++){
+        gen += m_writers[i].n.load(std::memory_order_relaxed);
+    }
+    return gen;
+}
+
+/*
+ * @func : add_writer
+ * @args : none
+ *
+ * @brief : returns write counter for a new writer ( lives as long as memory )
+ */
+ppcsimbooke::ppcsimbooke_memory::write_counter* ppcsimbooke::ppcsimbooke_memory::memory::add_writer(){
+    boost::lock_guard<boost::mutex> lock(m_writers_lock);
+    size_t n = m_nwriters.load(std::memory_order_relaxed);
+    LASSERT_THROW(n < MAX_WRITERS, sim_except(SIM_EXCEPT_ENOMEM, "Too many writers"), DEBUG4);
+    m_nwriters.store(n + 1, std::memory_order_release);
+    return &m_writers[n];
+}
+
 /*
  * @func : write_from_buffer
  * @args : uint64_t address, char *, size_t
@@ -337,6 +506,7 @@ void ppcsimbooke::ppcsimbooke_memory::memory::write_from_buffer(uint64_t addr, u
     size_t offset;
     uint8_t *curr_page = NULL;
 
+    note_write();
     while(size > 0){
         curr_size = min(size, (rnd_pgsz_n_plus_1(addr)-addr));
         offset = addr - rnd_pgsz_p(addr);
@@ -481,6 +651,7 @@ uint8_t ppcsimbooke::ppcsimbooke_memory::memory::read8(uint64_t addr, int endian
 void ppcsimbooke::ppcsimbooke_memory::memory::write8(uint64_t addr, uint8_t value, int endianness){
     LOG_DEBUG4(MSG_FUNC_START);
     uint8_t *hostptr = paddr_to_hostaddr(addr);
+    note_write();
     *hostptr = value;
     LOG_DEBUG4(MSG_FUNC_END);
 }
@@ -506,6 +677,7 @@ uint16_t ppcsimbooke::ppcsimbooke_memory::memory::read16(uint64_t addr, int endi
 void ppcsimbooke::ppcsimbooke_memory::memory::write16(uint64_t addr, uint16_t value, int endianness){
     LOG_DEBUG4(MSG_FUNC_START);
     uint8_t *hostptr = paddr_to_hostaddr(addr);
+    note_write();
     write_buff<uint16_t>(hostptr, value, endianness);
     LOG_DEBUG4(MSG_FUNC_END);
 }
@@ -531,6 +703,7 @@ uint32_t ppcsimbooke::ppcsimbooke_memory::memory::read32(uint64_t addr, int endi
 void ppcsimbooke::ppcsimbooke_memory::memory::write32(uint64_t addr, uint32_t value, int endianness){
     LOG_DEBUG4(MSG_FUNC_START);
     uint8_t *hostptr = paddr_to_hostaddr(addr);
+    note_write();
     write_buff<uint32_t>(hostptr, value, endianness);
     LOG_DEBUG4(MSG_FUNC_END);
 }
@@ -553,6 +726,7 @@ uint64_t ppcsimbooke::ppcsimbooke_memory::memory::read64(uint64_t addr, int endi
 void ppcsimbooke::ppcsimbooke_memory::memory::write64(uint64_t addr, uint64_t value, int endianness){
     LOG_DEBUG4(MSG_FUNC_START);
     uint8_t *hostptr = paddr_to_hostaddr(addr);
+    note_write();
     write_buff<uint64_t>(hostptr, value, endianness);
     LOG_DEBUG4(MSG_FUNC_END);
 }
@@ -606,6 +780,10 @@ void ppcsimbooke::ppcsimbooke_memory::memory::load_elf(std::string filename){
     ELFIO::Elf_Xword         secsize;
     char                     *data = NULL;
 
+    m_code_secs.clear();
+    m_code_entries.clear();
+    m_code_entries.push_back(elfreader.get_entry());
+
     // Loading sections
     for(int i=0; i<sec_num; i++){
         psec     = elfreader.sections[i];
@@ -621,6 +799,26 @@ void ppcsimbooke::ppcsimbooke_memory::memory::load_elf(std::string filename){
             std::cout << "Loading section[" << secidx << "] " << secname << std::hex
                       <<" size=" << secsize << " at 0x" << secaddr << std::endl;
             write_from_buffer(secaddr, reinterpret_cast<uint8_t *>(data), secsize);
+            if(secflags & SHF_EXECINSTR){
+                m_code_secs.push_back(std::make_pair(secaddr, secsize));
+            }
+        }
+
+        // Function symbols are known block entries too
+        if(sectype == SHT_SYMTAB){
+            ELFIO::symbol_section_accessor symbols(elfreader, const_cast<ELFIO::section*>(psec));
+            std::string          symname;
+            ELFIO::Elf64_Addr    symvalue;
+            ELFIO::Elf_Xword     symsize;
+            unsigned char        symbind, symtype, symother;
+            ELFIO::Elf_Half      symsec;
+
+            for(ELFIO::Elf_Xword j=0; j<symbols.get_symbols_num(); j++){
+                symbols.get_symbol(j, symname, symvalue, symsize, symbind, symtype, symsec, symother);
+                if(symtype == STT_FUNC){
+                    m_code_entries.push_back(symvalue);
+                }
+            }
         }
     }
 }
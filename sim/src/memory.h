@@ -25,6 +25,7 @@
 #define    _MEMORY_HPP_
 
 #include <elfio/elfio.hpp>        // for elf loader
+#include <atomic>
 #include "config.h"
 #include "utils.h"
 
@@ -37,6 +38,16 @@ namespace ppcsimbooke {
         
         static const int PAGE_SIZE = 0x1000;
         
+        // Count of writes done by a single writer ( see memory::add_writer() ).
+        // Only it's owner bumps it, while others may read it. Padded so that no two writers' counters
+        // share a cache line.
+        struct write_counter {
+            std::atomic<uint64_t> n;
+            uint8_t               pad[64 - sizeof(std::atomic<uint64_t>)];
+            write_counter() : n(0) {}
+            void bump(){ n.store(n.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed); }
+        };
+
         //
         // Main memory class
         //
@@ -81,12 +92,43 @@ namespace ppcsimbooke {
             // Memory target attributes
             int                                     n_tgts;             /* Number of targets */
             std::list<t_mem_tgt>                    mem_tgt;            /* List of memory targets */
-            int                                     mem_tgt_modified;   // Flag to assert that memory targets were modified
         
-            // This cache will be searched unless mem_tgt_modified=1.
-            // If mem_tgt_modified=1, that means memory targets have been modified somehow and
-            // we need to re-locate host page for the effective number ( and also update this cache )
-            std::map<uint64_t, uint8_t*>            page_hash_cache;    // Cache of page_hash
+            // Physical page table.
+            // Two level radix table over physical page numbers, PT_L2_BITS of them at the bottom level.
+            // Leaves point at host pages ( which are owned by their target's page_hash or are in m_flat ).
+            // Top level entries also record the target owning their whole span & whether all of it is flat
+            // DDR, resolved whenever a target is registered, so neither a flat access nor the first touch
+            // of a page needs to walk any list. Registering a target only drops leaves of the pages it covers.
+            static const int                        PT_L2_BITS = 12;
+            static const size_t                     PT_L2_SIZE = (1 << PT_L2_BITS);
+            struct pt_l1_entry {
+                uint8_t**        pages;          // PT_L2_SIZE host pages ( NULL till some page in span is touched )
+                t_mem_tgt*       tgt;            // target owning whole span ( NULL if it's split among targets )
+                bool             flat;           // whole span is backed by m_flat ( no non DDR target overlaps it )
+            };
+            std::vector<pt_l1_entry>                m_pt;
+
+            // Write counts. Used by cpus to find out if memory changed while they were idling in a polling
+            // loop ( see write_gen() ). Every cpu bumps it's own counter ( see add_writer() ), so a guest store
+            // is a plain load & store instead of a locked read modify write on a shared line. Host side writes
+            // may come from any thread & go to m_host_writes. Only a change matters, so relaxed ordering is enough.
+            static const size_t                     MAX_WRITERS = 64;
+            std::atomic<uint64_t>                   m_host_writes;
+            write_counter                           m_writers[MAX_WRITERS];
+            std::atomic<size_t>                     m_nwriters;         // published after it's counter is ready
+            boost::mutex                            m_writers_lock;     // serializes add_writer()
+
+            // Code of last loaded elf file ( for ahead of time translation )
+            std::vector<std::pair<uint64_t, uint64_t> >  m_code_secs;     // executable sections ( address, size )
+            std::vector<uint64_t>                         m_code_entries;  // entry point & function symbols
+
+            // Flat DDR backing ( CONFIG_MEM_FLAT ).
+            // Whole physical address space is reserved as a single sparse anonymous mapping, so pages of DDR
+            // targets are just m_flat + paddr & are zero filled lazily by host kernel. Pages of other targets
+            // ( or whatever they shadow ) are still kept in their page hash. Overlapping DDR targets share the
+            // same backing.
+            uint8_t*                                      m_flat;          // NULL if not used ( or mmap failed )
+            std::vector<std::pair<uint64_t, uint64_t> >   m_flat_holes;    // ranges of non DDR targets ( base, end )
         
             public:
             typedef typename std::list<t_mem_tgt>::iterator           mem_tgt_iter;       /* Memory target iterator */
@@ -105,8 +147,23 @@ namespace ppcsimbooke {
             bool is_overlapping_tgt(const t_mem_tgt &mem_tgt_this);
             bool is_paddr_there(mem_tgt_iter iter_this, uint64_t paddr);
             mem_tgt_iter select_mem_tgt(uint64_t paddr) throw(sim_except);
+            void update_pt(const t_mem_tgt &tgt);                          // re-resolve page table entries covered by tgt
             uint8_t *paddr_to_hostpage(uint64_t paddr);
             uint8_t *paddr_to_hostaddr(uint64_t paddr);
+            void init_flat();
+            void free_flat();
+            bool is_flat(uint64_t paddr) const {                       // if paddr's page table span is backed by m_flat
+                uint64_t span = paddr >> (MIN_PGSZ_SHIFT + PT_L2_BITS);
+                return span < m_pt.size() && m_pt[span].flat;
+            }
+            bool is_flat_page(uint64_t paddr) const {                  // if paddr is backed by m_flat ( walks holes )
+                if(!m_flat || paddr > pa_max){ return false; }
+                for(size_t i=0; i<m_flat_holes.size(); i++){
+                    if(paddr >= m_flat_holes[i].first && paddr <= m_flat_holes[i].second){ return false; }
+                }
+                return true;
+            }
+            std::map<uint64_t, uint8_t*> flat_pages(const t_mem_tgt &tgt); // touched pages of tgt in m_flat
         
             public:
             //
@@ -117,7 +174,11 @@ namespace ppcsimbooke {
                 LOG_DEBUG4(MSG_FUNC_START);
                 this->pa_max = (1LL << m_bits) - 1 ;
                 this->pn_max = (this->pa_max) >> static_cast<int>(log2(PAGE_SIZE));
-                this->mem_tgt_modified = 0;
+                this->m_host_writes = 0;
+                this->m_nwriters = 0;
+                this->n_tgts = 0;
+                this->m_pt.resize((this->pn_max >> PT_L2_BITS) + 1);   // value initialized ( all empty )
+                init_flat();
         
                 // Register a default DDR of the whole supported address range
                 this->register_memory_target(0x0, (1LL << m_bits), "ddr0", 0, TGT_DDR, 0);
@@ -136,6 +197,10 @@ namespace ppcsimbooke {
                         delete[] iter1->second;
                     }
                 }
+                for(size_t i=0; i<m_pt.size(); i++){
+                    delete[] m_pt[i].pages;
+                }
+                free_flat();
                 LOG_DEBUG4(MSG_FUNC_END);
             }
         
@@ -145,6 +210,13 @@ namespace ppcsimbooke {
             void dump_all_pages(std::ostream &ostr = std::cout);
             void dump_page(uint64_t addr, std::ostream &ostr = std::cout);
         
+            // write generation ( sum of all write counts, see m_writers )
+            uint64_t       write_gen() const;
+            // write counter of a new writer ( a cpu ). Only that writer may bump it.
+            write_counter* add_writer();
+            // note a host side write ( or one done directly through a host pointer, see host_ptr() )
+            void           note_write() { m_host_writes.fetch_add(1, std::memory_order_relaxed); }
+
             // Memory I/O
             void write_from_buffer(uint64_t addr, uint8_t* buff, size_t size);
             uint8_t *read_to_buffer(uint64_t addr, uint8_t *buff, size_t size);
@@ -176,6 +248,9 @@ namespace ppcsimbooke {
         
             // Load an elf file
             void load_elf(std::string flename);
+            // executable sections & known code addresses of last loaded elf file
+            const std::vector<std::pair<uint64_t, uint64_t> >& code_sections() const { return m_code_secs;    }
+            const std::vector<uint64_t>&                        code_entries()  const { return m_code_entries; }
             
         };
     }
@@ -3,6 +3,52 @@
 // static members
 uint16_t ppcsimbooke::ppcsimbooke_dis::ppcdis::m_ppc_opcd_indices[ppcsimbooke::ppcsimbooke_dis::N_PPC_OPCODES];
 bool     ppcsimbooke::ppcsimbooke_dis::ppcdis::m_opcd_indices_done = 0;
+ppc_cpu_t                                                 ppcsimbooke::ppcsimbooke_dis::ppcdis::sm_dec_dialect = 0;
+uint32_t                                                  ppcsimbooke::ppcsimbooke_dis::ppcdis::sm_dec_pri[ppcsimbooke::ppcsimbooke_dis::N_PPC_OPCODES];
+uint32_t                                                  ppcsimbooke::ppcsimbooke_dis::ppcdis::sm_dec_xo_mask[ppcsimbooke::ppcsimbooke_dis::N_PPC_OPCODES];
+std::vector<ppcsimbooke::ppcsimbooke_dis::ppc_dec_node>   ppcsimbooke::ppcsimbooke_dis::ppcdis::sm_dec_nodes;
+std::vector<uint16_t>                                     ppcsimbooke::ppcsimbooke_dis::ppcdis::sm_dec_cands;
+std::vector<bool>                                         ppcsimbooke::ppcsimbooke_dis::ppcdis::sm_dec_chk;
+std::vector<uint32_t>                                     ppcsimbooke::ppcsimbooke_dis::ppcdis::sm_dec_field_first;
+std::vector<ppcsimbooke::ppcsimbooke_dis::ppc_dec_field>  ppcsimbooke::ppcsimbooke_dis::ppcdis::sm_dec_fields;
+
+// Operand specialized variants ( RTL for these is in OPERAND SPECIALIZED VARIANTS section of cpu_ppc_instr.cc )
+const ppcsimbooke::ppcsimbooke_dis::ppc_opc_variant ppcsimbooke::ppcsimbooke_dis::ppcdis::sm_opc_variants[] = {
+    { "addi:ra0",  "addi",  OPF_RA0,      1 },  { "addi:ra",  "addi",  OPF_RA, 1 },
+    { "addis:ra0", "addis", OPF_RA0,      1 },  { "addis:ra", "addis", OPF_RA, 1 },
+    { "lbz:ra0",   "lbz",   OPF_RA0,      2 },  { "lbz:ra",   "lbz",   OPF_RA, 2 },
+    { "lhz:ra0",   "lhz",   OPF_RA0,      2 },  { "lhz:ra",   "lhz",   OPF_RA, 2 },
+    { "lha:ra0",   "lha",   OPF_RA0,      2 },  { "lha:ra",   "lha",   OPF_RA, 2 },
+    { "lwz:ra0",   "lwz",   OPF_RA0,      2 },  { "lwz:ra",   "lwz",   OPF_RA, 2 },
+    { "lbzx:ra0",  "lbzx",  OPF_RA0,      1 },  { "lbzx:ra",  "lbzx",  OPF_RA, 1 },
+    { "lhzx:ra0",  "lhzx",  OPF_RA0,      1 },  { "lhzx:ra",  "lhzx",  OPF_RA, 1 },
+    { "lwzx:ra0",  "lwzx",  OPF_RA0,      1 },  { "lwzx:ra",  "lwzx",  OPF_RA, 1 },
+    { "lbzu:ok",   "lbzu",  OPF_UPD_LOAD, 2 },
+    { "lhzu:ok",   "lhzu",  OPF_UPD_LOAD, 2 },
+    { "lwzu:ok",   "lwzu",  OPF_UPD_LOAD, 2 },
+    { "stb:ra0",   "stb",   OPF_RA0,      2 },  { "stb:ra",   "stb",   OPF_RA, 2 },
+    { "sth:ra0",   "sth",   OPF_RA0,      2 },  { "sth:ra",   "sth",   OPF_RA, 2 },
+    { "stw:ra0",   "stw",   OPF_RA0,      2 },  { "stw:ra",   "stw",   OPF_RA, 2 },
+    { "stbx:ra0",  "stbx",  OPF_RA0,      1 },  { "stbx:ra",  "stbx",  OPF_RA, 1 },
+    { "sthx:ra0",  "sthx",  OPF_RA0,      1 },  { "sthx:ra",  "sthx",  OPF_RA, 1 },
+    { "stwx:ra0",  "stwx",  OPF_RA0,      1 },  { "stwx:ra",  "stwx",  OPF_RA, 1 },
+    { "stbu:ok",   "stbu",  OPF_RA,       2 },
+    { "sthu:ok",   "sthu",  OPF_RA,       2 },
+    { "stwu:ok",   "stwu",  OPF_RA,       2 },
+
+    // block IR pseudo ops. Constant operand is kept in last argument of call frame.
+    { "ir:nop",    NULL,    OPF_IR,      -1 },     // dropped instr
+    { "ir:li",     NULL,    OPF_IR,      -1 },     // rD = constant
+    { "lbz:abs",   NULL,    OPF_IR,      -1 },     // loads/stores from constant address
+    { "lhz:abs",   NULL,    OPF_IR,      -1 },
+    { "lha:abs",   NULL,    OPF_IR,      -1 },
+    { "lwz:abs",   NULL,    OPF_IR,      -1 },
+    { "stb:abs",   NULL,    OPF_IR,      -1 },
+    { "sth:abs",   NULL,    OPF_IR,      -1 },
+    { "stw:abs",   NULL,    OPF_IR,      -1 },
+};
+const int ppcsimbooke::ppcsimbooke_dis::ppcdis::sm_n_opc_variants =
+    sizeof(ppcsimbooke::ppcsimbooke_dis::ppcdis::sm_opc_variants)/sizeof(ppcsimbooke::ppcsimbooke_dis::ppc_opc_variant);
 
 // Member functions.
 //
@@ -31,6 +77,78 @@ void ppcsimbooke::ppcsimbooke_dis::ppcdis::init_opcd_indices(){
     }
 }
 
+// Build decode tree.
+// Every primary opcode gets a list of candidates ( opcodes valid for dialect, in table order ). Primary
+// opcodes with lots of instrs ( 4, 19, 31 etc. ) are split further on extended opcode field, with an opcode
+// going in every extended opcode slot it's mask & opcode agree with. First match in a candidate list is
+// therefore always same as lookup_powerpc()'s first match.
+void ppcsimbooke::ppcsimbooke_dis::ppcdis::init_decode_tree(ppc_cpu_t dialect){
+    sm_dec_dialect = dialect;
+    sm_dec_nodes.clear();
+    sm_dec_cands.clear();
+    sm_dec_chk.assign(powerpc_num_opcodes, false);
+
+    sm_dec_field_first.assign(powerpc_num_opcodes, 0);
+    sm_dec_fields.clear();
+
+    // operands having extract functions need a validity check. Fields of others are precomputed.
+    for(int i=0; i<powerpc_num_opcodes; i++){
+        sm_dec_field_first[i] = sm_dec_fields.size();
+        for(const unsigned char* opindex = powerpc_opcodes[i].operands; *opindex != 0; opindex++){
+            const struct powerpc_operand* operand = powerpc_operands + *opindex;
+            ppc_dec_field                 field   = { operand->bitm, 0, operand->shift, NULL };
+
+            if(operand->extract){
+                sm_dec_chk[i] = true;
+                field.operand = operand;
+            }else if(operand->flags & PPC_OPERAND_SIGNED){
+                // top bit of bitm ( see operand_value_powerpc() )
+                uint32_t top = operand->bitm;
+                top |= (top & -top) - 1;
+                top &= ~(top >> 1);
+                field.sign = top;
+            }
+            sm_dec_fields.push_back(field);
+        }
+    }
+
+    for(int op=0; op<N_PPC_OPCODES-1; op++){
+        std::vector<uint16_t> grp;
+        for(int i=m_ppc_opcd_indices[op]; i<m_ppc_opcd_indices[op+1]; i++){
+            const struct powerpc_opcode* opcode = powerpc_opcodes + i;
+            if((opcode->flags & dialect) == 0 || (opcode->deprecated & dialect) != 0)
+                continue;
+            grp.push_back(i);
+        }
+
+        sm_dec_pri[op]     = sm_dec_nodes.size();
+        sm_dec_xo_mask[op] = (grp.size() > static_cast<size_t>(DEC_SPLIT_THRESHOLD)) ? ext_opc_mask : 0;
+
+        if(sm_dec_xo_mask[op] == 0){
+            ppc_dec_node node = { static_cast<uint32_t>(sm_dec_cands.size()), static_cast<uint32_t>(grp.size()) };
+            sm_dec_cands.insert(sm_dec_cands.end(), grp.begin(), grp.end());
+            sm_dec_nodes.push_back(node);
+            continue;
+        }
+
+        for(uint32_t xo=0; xo<DEC_XO_ENTRIES; xo++){
+            ppc_dec_node node = { static_cast<uint32_t>(sm_dec_cands.size()), 0 };
+            for(size_t k=0; k<grp.size(); k++){
+                const struct powerpc_opcode* opcode = powerpc_opcodes + grp[k];
+                if((((xo << DEC_XO_SHIFT) ^ opcode->opcode) & opcode->mask & ext_opc_mask) == 0){
+                    sm_dec_cands.push_back(grp[k]);
+                    node.n++;
+                }
+            }
+            sm_dec_nodes.push_back(node);
+        }
+    }
+    // Last primary opcode slot is never looked up ( PPC_OP() is 6 bits )
+    sm_dec_pri[N_PPC_OPCODES-1]     = sm_dec_nodes.size();
+    sm_dec_xo_mask[N_PPC_OPCODES-1] = 0;
+    sm_dec_nodes.push_back(ppc_dec_node());
+}
+
 // Initialize dialect
 void ppcsimbooke::ppcsimbooke_dis::ppcdis::init_dialect(){
    m_dialect = ppc_parse_cpu (0, "e500x2");
@@ -143,6 +261,43 @@ std::pair<const struct powerpc_opcode*, uint32_t> ppcsimbooke::ppcsimbooke_dis::
     return std::make_pair(reinterpret_cast<const struct powerpc_opcode*>(NULL), 0);
 }
 
+// Find a match for INSN using decode tree. Tree is only valid for dialect it was built for.
+std::pair<const struct powerpc_opcode*, uint32_t> ppcsimbooke::ppcsimbooke_dis::ppcdis::lookup_decode_tree (unsigned long insn)
+{
+    if unlikely(m_dialect != sm_dec_dialect)
+        return lookup_powerpc(insn);
+
+    unsigned long       op   = PPC_OP (insn);
+    const ppc_dec_node& node = sm_dec_nodes[sm_dec_pri[op] + ((insn & sm_dec_xo_mask[op]) >> DEC_XO_SHIFT)];
+
+    for (uint32_t k = 0; k < node.n; k++)
+    {
+        uint16_t                      indx   = sm_dec_cands[node.first + k];
+        const struct powerpc_opcode*  opcode = powerpc_opcodes + indx;
+
+        if ((insn & opcode->mask) != opcode->opcode)
+            continue;
+
+        /* Check validity of operands.  */
+        if (sm_dec_chk[indx])
+        {
+            int invalid = 0;
+            for (const unsigned char* opindex = opcode->operands; *opindex != 0; opindex++)
+            {
+                const struct powerpc_operand* operand = powerpc_operands + *opindex;
+                if (operand->extract)
+                    (*operand->extract) (insn, m_dialect, &invalid);
+            }
+            if (invalid)
+                continue;
+        }
+
+        return std::make_pair(opcode, static_cast<uint32_t>(indx));
+    }
+
+    return std::make_pair(reinterpret_cast<const struct powerpc_opcode*>(NULL), 0);
+}
+
 int ppcsimbooke::ppcsimbooke_dis::ppcdis::if_std_delims_present(char *str)
 {
     char std_delims[] = " ,()";
@@ -172,12 +327,14 @@ int ppcsimbooke::ppcsimbooke_dis::ppcdis::get_num_operands(const struct powerpc_
 ppcsimbooke::instr_call ppcsimbooke::ppcsimbooke_dis::ppcdis::disasm(uint32_t opcd, uint64_t pc, int endianness)
 {
     instr_call  call_this;
+    std::string fmt;
     unsigned long insn;
     const struct powerpc_opcode *opcode;
     int i = 0;
     bool rad = 0;        // flag for relative addressing mode
     _dis_info  dinfo;    // extra disassembler info
     std::pair<const struct powerpc_opcode*, uint32_t> opc_pair;
+    const ppc_dec_field* fields;
 
     // We reverse endianness if LITTLE endian specified
     if (endianness == EMUL_LITTLE_ENDIAN)
@@ -205,7 +362,7 @@ ppcsimbooke::instr_call ppcsimbooke::ppcsimbooke_dis::ppcdis::disasm(uint32_t op
         return call_this;
 
     exit_0:
-    opc_pair = lookup_powerpc (insn);
+    opc_pair = lookup_decode_tree (insn);
     opcode   = opc_pair.first;
 
     if (opcode == NULL && (m_dialect & PPC_OPCODE_ANY) != 0)
@@ -224,14 +381,15 @@ ppcsimbooke::instr_call ppcsimbooke::ppcsimbooke_dis::ppcdis::disasm(uint32_t op
 
         /* If we are here, it means correct opcode was found in the table */
         /* Store opcode name in passed disassemble_info */
-        call_this.opcname = std::string(opcode->name);
+        call_this.opcname = opcode->name;
         call_this.hv      = (opcode->opcode << 32 | opc_pair.second);
-        call_this.opc     = opcode->opcode;
+        call_this.fptr    = (m_opc_impl_tbl) ? m_opc_impl_tbl[opc_pair.second] : NULL;
+        fields            = sm_dec_fields.data() + sm_dec_field_first[opc_pair.second];
 
         if (opcode->operands[0] != 0)
-            call_this.fmt = "%-7s ";
+            fmt = "%-7s ";
         else
-            call_this.fmt = "%s";
+            fmt = "%s";
 
         /* Now extract and print the operands.  */
         need_comma = 0;
@@ -254,71 +412,62 @@ ppcsimbooke::instr_call ppcsimbooke::ppcsimbooke_dis::ppcdis::disasm(uint32_t op
             //{
             //}
 
-            value = operand_value_powerpc (operand, insn);
+            value = dec_field_value (fields[i], insn);
 
             if (need_comma)
             {
-                call_this.fmt += ",";
+                fmt += ",";
                 need_comma = 0;
             }
 
             /* Print the operand as directed by the flags.  */
             if ((operand->flags & PPC_OPERAND_GPR) != 0 || ((operand->flags & PPC_OPERAND_GPR_0) != 0 && value != 0)){
-                call_this.fmt += "r%ld";
-                call_this.arg[i].p = (REG_GPR0 + value);
+                fmt += "r%ld";
                 call_this.arg[i].v = value;
-                call_this.arg[i].t = 1;
+                call_this.argt |= (1 << i);
             //} else if ((operand->flags & PPC_OPERAND_FPR) != 0){
-            //    call_this.fmt += "f%ld";
+            //    fmt += "f%ld";
             //    call_this.arg[i].p = (REG_FPR0 + value);
             //    call_this.arg[i].v = value;
-            //    call_this.arg[i].t = 1;
+            //    call_this.argt |= (1 << i);
             } else if ((operand->flags & PPC_OPERAND_VR) != 0){
-                call_this.fmt += "v%ld";
+                fmt += "v%ld";
                 // FIXME: VRs are not supported at this time.
             } else if ((operand->flags & PPC_OPERAND_VSR) != 0){
-                call_this.fmt += "vs%ld";
+                fmt += "vs%ld";
                 // FIXME : Booke cpus shouldn't come here
             } else if ((operand->flags & PPC_OPERAND_RELATIVE) != 0){
-                call_this.fmt += "0x%lx";
-                call_this.arg[i].p = (value + pc);
+                fmt += "0x%lx";
                 call_this.arg[i].v = (value + pc);
-                call_this.arg[i].t = 0;
                 rad = 1;
             } else if ((operand->flags & PPC_OPERAND_ABSOLUTE) != 0){
-                call_this.fmt += "0x%lx";
-                call_this.arg[i].p = value;
+                fmt += "0x%lx";
                 call_this.arg[i].v = value;
-                call_this.arg[i].t = 0;
             } else if ((operand->flags & PPC_OPERAND_FSL) != 0){
-                call_this.fmt += "fsl%ld";
+                fmt += "fsl%ld";
                 // FIXME: Booke cpus shouln't come here
             } else if ((operand->flags & PPC_OPERAND_FCR) != 0){
-                call_this.fmt += "fcr%ld";
+                fmt += "fcr%ld";
                 // FIXME : Booke cpus shouldn't come here
             } else if ((operand->flags & PPC_OPERAND_UDI) != 0){
-                call_this.fmt += "%ld";
+                fmt += "%ld";
                 // FIXME : Booke cpus shouldn't come here
             } else if ((operand->flags & PPC_OPERAND_CR) != 0 && (m_dialect & PPC_OPCODE_PPC) != 0){
             
                 if (operand->bitm == 7)
-                    call_this.fmt += "cr%ld";
+                    fmt += "cr%ld";
                 else
-                    call_this.fmt += "cr[%ld]";
-                call_this.arg[i].p = value;
+                    fmt += "cr[%ld]";
                 call_this.arg[i].v = value;
-                call_this.arg[i].t = 0;
             }
             else{
-                call_this.fmt += "0x%x";
-                call_this.arg[i].p = value;
+                fmt += "0x%x";
                 call_this.arg[i].v = value;
-                call_this.arg[i].t = 0;
             }
 
             if (need_paren)
             {
-                call_this.fmt += ")";
+                fmt += ")";
                 need_paren = 0;
             }
 
@@ -326,7 +475,7 @@ ppcsimbooke::instr_call ppcsimbooke::ppcsimbooke_dis::ppcdis::disasm(uint32_t op
                 need_comma = 1;
             else
             {
-                call_this.fmt += "(";
+                fmt += "(";
                 need_paren = 1;
             }
 
@@ -339,6 +488,8 @@ ppcsimbooke::instr_call ppcsimbooke::ppcsimbooke_dis::ppcdis::disasm(uint32_t op
         LTHROW(sim_except_ppc(PPC_EXCEPTION_PRG, PPC_EXCEPT_PRG_ILG, "Illegal Program Exception."), DEBUG4);
     }
 
+    call_this.fmt = instr_strtab::intern(fmt.c_str());
+
     // Update cache
     m_dis_cache.insert(insn, call_this, _dis_info(pc, rad));
 
@@ -359,6 +510,7 @@ ppcsimbooke::instr_call ppcsimbooke::ppcsimbooke_dis::ppcdis::disasm(std::string
     char *tmp_str = (char *)instr.c_str();
     char delim = ',';
     instr_call call_this;
+    std::string fmt;
     uint32_t indx = 0;
 
     int i=0;
@@ -385,14 +537,14 @@ ppcsimbooke::instr_call ppcsimbooke::ppcsimbooke_dis::ppcdis::disasm(std::string
     assert_and_throw(opcode != NULL, sim_except(SIM_EXCEPT_EINVAL, "Wrong opcode"));
 
     // Get opcode's name
-    call_this.opcname = std::string(opcode->name);
+    call_this.opcname = opcode->name;
     call_this.hv      = (opcode->opcode << 32 | indx);
-    call_this.opc     = opcode->opcode;
+    call_this.fptr    = (m_opc_impl_tbl) ? m_opc_impl_tbl[indx] : NULL;
 
     if (opcode->operands[0] != 0)
-        call_this.fmt = "%-7s ";
+        fmt = "%-7s ";
     else
-        call_this.fmt = "%s";
+        fmt = "%s";
 
     /* Get number of operands */
     noperands = get_num_operands(opcode);
@@ -435,62 +587,57 @@ ppcsimbooke::instr_call ppcsimbooke::ppcsimbooke_dis::ppcdis::disasm(std::string
         if ((operand->flags & PPC_OPERAND_GPR) != 0
             || ((operand->flags & PPC_OPERAND_GPR_0) != 0 && token != 0)){
             sscanf(token, "r%ld", &value);
-            call_this.fmt    += "r%ld";
-            call_this.arg[i].p = (REG_GPR0 + value);
+            fmt    += "r%ld";
             call_this.arg[i].v = value;
-            call_this.arg[i].t = 1;
+            call_this.argt |= (1 << i);
         }
         //else if ((operand->flags & PPC_OPERAND_FPR) != 0){
         //    sscanf(token, "f%ld", &value);
-        //    call_this.fmt    += "f%ld";
+        //    fmt    += "f%ld";
         //    call_this.arg[i].p = (REG_FPR0 + value);
         //    call_this.arg[i].v = value;
-        //    call_this.arg[i].t = 1;
+        //    call_this.argt |= (1 << i);
         //}
         else if ((operand->flags & PPC_OPERAND_VR) != 0){
             sscanf(token, "v%ld", &value);
-            call_this.fmt    += "v%ld";
+            fmt    += "v%ld";
             // FIXME: VRs not supported at this time. targ should be specified when supported
         }
         else if ((operand->flags & PPC_OPERAND_VSR) != 0){
             sscanf(token, "vs%ld", &value);
-            call_this.fmt    += "vs%ld";
+            fmt    += "vs%ld";
             // FIXME: Booke cpus shouldn't come here
         }
         else if ((operand->flags & PPC_OPERAND_RELATIVE) != 0){
 	        sscanf(token, "0x%llx", reinterpret_cast<unsigned long long *>(&value));
-            call_this.fmt += "0x%llx";
-            call_this.arg[i].p = value - pc;
+            fmt += "0x%llx";
             call_this.arg[i].v = value - pc;                       // Relative addressing mode
-            call_this.arg[i].t = 0;
         }
 	    else if ((operand->flags & PPC_OPERAND_ABSOLUTE) != 0){
 	        sscanf(token, "0x%llx", reinterpret_cast<unsigned long long *>(&value));
-            call_this.fmt += "0x%llx";
-            call_this.arg[i].p = value;
+            fmt += "0x%llx";
             call_this.arg[i].v = value;
-            call_this.arg[i].t = 0;
         }
         else if ((operand->flags & PPC_OPERAND_FSL) != 0){
             sscanf(token, "fsl%ld", &value);
-            call_this.fmt    += "fsl%ld";
+            fmt    += "fsl%ld";
             // FIXME: booke cpus shouldn't come here
         }
         else if ((operand->flags & PPC_OPERAND_FCR) != 0){
             sscanf(token, "fcr%ld", &value);
-            call_this.fmt    += "fcr%ld";
+            fmt    += "fcr%ld";
             // FIXME : booke cpus shouldn't come here
         }
         else if ((operand->flags & PPC_OPERAND_UDI) != 0){
             sscanf(token, "0x%lx", &value);
-            call_this.fmt    += "0x%lx";
+            fmt    += "0x%lx";
             // FIXME : booke cpus shouldn't come here
         }
         else if ((operand->flags & PPC_OPERAND_CR) != 0)
         {
             if (operand->bitm == 7){
                 sscanf(token, "cr%ld", &value);
-                call_this.fmt  += "cr%ld";
+                fmt  += "cr%ld";
             }
             else
             {
@@ -507,25 +654,22 @@ ppcsimbooke::instr_call ppcsimbooke::ppcsimbooke_dis::ppcdis::disasm(std::string
                     /* Error */
                 }
                 value = 4*cr + ind;
-                call_this.fmt  += "cr[%ld]";
+                fmt  += "cr[%ld]";
             }
-            call_this.arg[i].p = value;
             call_this.arg[i].v = value;
-            call_this.arg[i].t = 0;
         }
         else{
             sscanf(token, "0x%lx", &value);
-            call_this.fmt     += "0x%lx";
-            call_this.arg[i].p = value;
+            fmt     += "0x%lx";
             call_this.arg[i].v = value;
-            call_this.arg[i].t = 0;
         }
 
-        call_this.fmt += std::string(1, delim);    // Add delimiter to format string
+        fmt += std::string(1, delim);    // Add delimiter to format string
 
         call_this.arg[i].v = value;
         call_this.nargs++;
     }
+    call_this.fmt = instr_strtab::intern(fmt.c_str());
 
     return call_this;
 
@@ -544,6 +688,12 @@ int ppcsimbooke::ppcsimbooke_dis::ppcdis::get_opc_index(std::string opcname){
                 return indx;
         }
     }
+    // Operand specialized variants follow regular opcodes
+    for (int i = 0; i < sm_n_opc_variants; i++){
+        if(!strcmp(opcname.c_str(), sm_opc_variants[i].name)){
+            return powerpc_num_opcodes + i;
+        }
+    }
     // Throw a warning on undefined opcodes
     // NOTE : If an opcode was not found in the opcode table,
     //        this merely means that the extended opcode was not there.
@@ -571,6 +721,81 @@ uint64_t ppcsimbooke::ppcsimbooke_dis::ppcdis::get_opc_hash(std::string opcname)
     return 0x0;
 }
 
+// Register opcode handler table
+void ppcsimbooke::ppcsimbooke_dis::ppcdis::set_opc_impl_table(const ppc_opc_fun_ptr* tbl){
+    m_opc_impl_tbl = tbl;
+    // Cached call frames were resolved against the previous table
+    m_dis_cache.clear();
+    m_dis_cache2.clear();
+}
+
+// Switch to operand specialized variant.
+// Only handler changes. Name & opcode are still those of the real instr ( for logs, coverage & JIT ).
+bool ppcsimbooke::ppcsimbooke_dis::ppcdis::specialize(instr_call& ic){
+    for (int i = 0; i < sm_n_opc_variants; i++){
+        const ppc_opc_variant& v = sm_opc_variants[i];
+        if(v.form == OPF_IR || ic.opcname != v.base){
+            continue;
+        }
+
+        size_t ra = ic.arg[v.arg].v;
+        bool   ok = false;
+        switch(v.form){
+            case OPF_RA0      : ok = (ra == 0);                          break;
+            case OPF_RA       : ok = (ra != 0);                          break;
+            case OPF_UPD_LOAD : ok = (ra != 0 && ra != ic.arg[0].v);     break;
+        }
+        if(ok){
+            int indx  = powerpc_num_opcodes + i;
+            ic.hv     = ((ic.hv >> 32) << 32 | indx);
+            ic.fptr   = (m_opc_impl_tbl) ? m_opc_impl_tbl[indx] : NULL;
+            return true;
+        }
+    }
+    return false;
+}
+
+// Get variant
+const ppcsimbooke::ppcsimbooke_dis::ppc_opc_variant* ppcsimbooke::ppcsimbooke_dis::ppcdis::get_opc_variant(const instr_call& ic){
+    int indx = static_cast<int>(ic.hv & 0xffffffffULL) - powerpc_num_opcodes;
+    return (indx >= 0 && indx < sm_n_opc_variants) ? &sm_opc_variants[indx] : NULL;
+}
+
+// Change opcode of a decoded call frame ( operands are left alone )
+// If opcname is a variant, only handler changes ( see specialize() ).
+bool ppcsimbooke::ppcsimbooke_dis::ppcdis::retarget(instr_call& ic, std::string opcname){
+    int indx = get_opc_index(opcname);
+    if unlikely(indx < 0 || indx >= get_num_handlers()){
+        return false;
+    }
+    if(indx >= powerpc_num_opcodes){
+        ic.hv   = ((ic.hv >> 32) << 32 | indx);
+        ic.fptr = (m_opc_impl_tbl) ? m_opc_impl_tbl[indx] : NULL;
+        return true;
+    }
+    ic.opcname = powerpc_opcodes[indx].name;
+    ic.hv      = (powerpc_opcodes[indx].opcode << 32 | indx);
+    ic.fptr    = (m_opc_impl_tbl) ? m_opc_impl_tbl[indx] : NULL;
+    return true;
+}
+
+// Check that decode tree finds same opcode as a linear scan of opcode table
+bool ppcsimbooke::ppcsimbooke_dis::ppcdis::decode_tree_matches(uint32_t insn){
+    std::pair<const struct powerpc_opcode*, uint32_t> opc_pair = lookup_decode_tree(insn);
+    if(opc_pair != lookup_powerpc(insn))
+        return false;
+    if(opc_pair.first == NULL)
+        return true;
+
+    const ppc_dec_field* fields = sm_dec_fields.data() + sm_dec_field_first[opc_pair.second];
+    int                  i      = 0;
+    for(const unsigned char* opindex = opc_pair.first->operands; *opindex != 0; opindex++, i++){
+        if(dec_field_value(fields[i], insn) != operand_value_powerpc(powerpc_operands + *opindex, insn))
+            return false;
+    }
+    return true;
+}
+
 /////////////////////////////////////////////////////////////////////////////////////
 // private helpers ??
 /////////////////////////////////////////////////////////////////////////////////////
@@ -738,15 +963,30 @@ bool ppcsimbooke::ppcsimbooke_dis::ppcdis::is_branch(instr_call& ic){
     //                                       bc         b           bclr        bcctr
   
     for (size_t i=0; i<(sizeof(bm_lut)/sizeof(uint32_t)); i++){
-        if((ppcsimbooke::ppcsimbooke_dis::pri_ext_opc_mask & ic.opc) == bm_lut[i]) return true;
+        if((ppcsimbooke::ppcsimbooke_dis::pri_ext_opc_mask & ic.opc()) == bm_lut[i]) return true;
     }
     return false;
 }
 
+// check for branch with LK set ( bl, bcl, bclrl, bcctrl )
+bool ppcsimbooke::ppcsimbooke_dis::ppcdis::is_branch_link(instr_call& ic){
+    return is_branch(ic) && (ic.opc() & 0x1);
+}
+
+// check for branch to LR ( bclr, bclrl )
+bool ppcsimbooke::ppcsimbooke_dis::ppcdis::is_branch_lr(instr_call& ic){
+    return (ppcsimbooke::ppcsimbooke_dis::pri_ext_opc_mask & ic.opc()) == 0x4c000020;
+}
+
+// check for branch to CTR ( bcctr, bcctrl )
+bool ppcsimbooke::ppcsimbooke_dis::ppcdis::is_branch_ctr(instr_call& ic){
+    return (ppcsimbooke::ppcsimbooke_dis::pri_ext_opc_mask & ic.opc()) == 0x4c000420;
+}
+
 // check for system call
 bool ppcsimbooke::ppcsimbooke_dis::ppcdis::is_sc(instr_call& ic){
     static const uint32_t sc_mask = (0x17 << 26);
-    return ((ic.opc & ppcsimbooke::ppcsimbooke_dis::pri_opc_mask) == sc_mask) ? true:false;
+    return ((ic.opc() & ppcsimbooke::ppcsimbooke_dis::pri_opc_mask) == sc_mask) ? true:false;
 }
 
 // check for rfXi
@@ -755,7 +995,7 @@ bool ppcsimbooke::ppcsimbooke_dis::ppcdis::is_rfxi(instr_call& ic){
     //                                        rfmci      rfdi        rfi         rfci 
 
     for (size_t i=0; i<(sizeof(rfxim_lut)/sizeof(uint32_t)); i++){
-        if((ic.opc & ppcsimbooke::ppcsimbooke_dis::pri_ext_opc_mask) == rfxim_lut[i]) return true;
+        if((ic.opc() & ppcsimbooke::ppcsimbooke_dis::pri_ext_opc_mask) == rfxim_lut[i]) return true;
     }
     return false;
 }
@@ -765,4 +1005,51 @@ bool ppcsimbooke::ppcsimbooke_dis::ppcdis::is_control_xfer(instr_call& ic){
     return is_branch(ic) || is_sc(ic) || is_rfxi(ic);
 }
 
+// check for context altering/synchronizing instrs. Instrs after them may have to be fetched in a
+// new context ( MSR[IS], PID, tlb entries ) & they may need precise PC/NIP.
+// NOTE : mtspr is included as a whole ( PIDs, timers, debug regs ).
+bool ppcsimbooke::ppcsimbooke_dis::ppcdis::is_ctxt_alter(instr_call& ic){
+    static const uint32_t ca_lut[] = { 0x7c000124, 0x7c000106, 0x7c000146, 0x7c0003a6, 0x4c00012c, 0x7c0007a4, 0x7c000624 };
+    //                                     mtmsr      wrtee       wrteei      mtspr       isync       tlbwe       tlbivax
+
+    for (size_t i=0; i<(sizeof(ca_lut)/sizeof(uint32_t)); i++){
+        if((ic.opc() & ppcsimbooke::ppcsimbooke_dis::pri_ext_opc_mask) == ca_lut[i]) return true;
+    }
+    return false;
+}
+
+// check for instrs without any side effects outside of GPRs, CR, XER, CTR & LR
+// ( loads, integer arithmetic/logical, compares, CR logical & branches ).
+// Stores, cache/tlb ops, SPR/MSR writes, reservations & system calls are never side effect free.
+// NOTE : This list is conservative. Anything not listed here is assumed to have side effects.
+bool ppcsimbooke::ppcsimbooke_dis::ppcdis::is_side_effect_free(instr_call& ic){
+    static const uint32_t pri_lut[] = { 7,  8,  10, 11, 12, 13, 14, 15, 16, 18, 20, 21, 23, 24, 25, 26, 27, 28,
+                                        29, 32, 33, 34, 35, 40, 41, 42, 43 };
+    //                                  mulli .. addis, bc, b, rotates, logical immediates, lwz .. lhau
+
+    static const uint32_t ext_lut[] = {
+        0x4c000020, 0x4c000420, 0x4c000202, 0x4c000102, 0x4c000242, 0x4c0001c2, 0x4c000042, 0x4c000382,
+    //      bclr       bcctr       crand       crandc      creqv       crnand      crnor       cror
+        0x4c000342, 0x4c000182, 0x4c000000,
+    //      crorc      crxor       mcrf
+        0x7c000000, 0x7c000040, 0x7c00002e, 0x7c00006e, 0x7c0000ae, 0x7c0000ee, 0x7c00022e, 0x7c00026e,
+    //      cmp        cmpl        lwzx        lwzux       lbzx        lbzux       lhzx        lhzux
+        0x7c0002ae, 0x7c0002ee, 0x7c000214, 0x7c000050, 0x7c0000d0, 0x7c000038, 0x7c000078, 0x7c000378,
+    //      lhax       lhaux       add         subf        neg         and         andc        or
+        0x7c000338, 0x7c000278, 0x7c0000f8, 0x7c0003b8, 0x7c000238, 0x7c000030, 0x7c000430, 0x7c000630,
+    //      orc        xor         nor         nand        eqv         slw         srw         sraw
+        0x7c000670, 0x7c000034, 0x7c000774, 0x7c000734, 0x7c0001d6, 0x7c000096, 0x7c000016, 0x7c000026
+    //      srawi      cntlzw      extsb       extsh       mullw       mulhw       mulhwu      mfcr
+    };
+
+    uint32_t pri = (ic.opc() & ppcsimbooke::ppcsimbooke_dis::pri_opc_mask) >> 26;
+    for (size_t i=0; i<(sizeof(pri_lut)/sizeof(uint32_t)); i++){
+        if(pri == pri_lut[i]) return true;
+    }
+    for (size_t i=0; i<(sizeof(ext_lut)/sizeof(uint32_t)); i++){
+        if((ic.opc() & ppcsimbooke::ppcsimbooke_dis::pri_ext_opc_mask) == ext_lut[i]) return true;
+    }
+    return false;
+}
+
 
@@ -49,6 +49,43 @@ namespace ppcsimbooke {
         static const uint32_t pri_opc_mask       = 0xfc000000;
         static const uint32_t ext_opc_mask       = 0x000007fe;
         static const uint32_t pri_ext_opc_mask   = (pri_opc_mask | ext_opc_mask);
+
+        // operand forms of opcode variants ( see ppcdis::specialize() )
+        enum {
+            OPF_RA0,              // rA field is 0
+            OPF_RA,               // rA field is not 0
+            OPF_UPD_LOAD,         // load with update : rA != 0 & rA != rD
+            OPF_IR,               // pseudo op of block IR ( never picked by specialize(), see basic_block_ir )
+        };
+
+        // Operand specialized variant of an opcode.
+        // Variants have their own handlers, which follow regular opcodes in handler tables.
+        struct ppc_opc_variant {
+            const char*   name;           // <opcode>:<form>
+            const char*   base;           // opcode name ( NULL for IR pseudo ops )
+            int           form;           // OPF_XXX
+            int           arg;            // operand no of rA
+        };
+
+        // Node of decode tree ( see ppcdis::init_decode_tree() ). Points to candidate opcodes for
+        // one primary opcode ( & extended opcode for primary opcodes with lots of instrs ).
+        struct ppc_dec_node {
+            uint32_t      first;          // first candidate in ppcdis::sm_dec_cands
+            uint32_t      n;              // no of candidates
+        };
+
+        // Operand field of an opcode ( see ppcdis::init_decode_tree() ). Plain fields are extracted
+        // inline with precomputed shift, mask & sign bit. Others go through their extract function.
+        struct ppc_dec_field {
+            uint32_t                      mask;           // field mask ( after shifting )
+            uint32_t                      sign;           // sign bit of field ( 0 if unsigned )
+            int                           shift;
+            const struct powerpc_operand* operand;        // operand having an extract function ( NULL otherwise )
+        };
+
+        static const int      DEC_SPLIT_THRESHOLD = 8;        // primary opcodes with more instrs than this are split on extended opcode
+        static const uint32_t DEC_XO_SHIFT        = 1;
+        static const uint32_t DEC_XO_ENTRIES      = (ext_opc_mask >> DEC_XO_SHIFT) + 1;
         
         class ppcdis{
             private:
@@ -69,20 +106,43 @@ namespace ppcsimbooke {
             ppc_dis_cache2  m_dis_cache2;                        // Second cache for string based opcodes
             static uint16_t m_ppc_opcd_indices[N_PPC_OPCODES];
             static bool     m_opcd_indices_done;
+            static const ppc_opc_variant sm_opc_variants[];
+            static const int             sm_n_opc_variants;
+            // decode tree
+            static ppc_cpu_t                  sm_dec_dialect;                      // dialect tree was built for
+            static uint32_t                   sm_dec_pri[N_PPC_OPCODES];           // first node of each primary opcode
+            static uint32_t                   sm_dec_xo_mask[N_PPC_OPCODES];       // ext_opc_mask if primary opcode is split, 0 otherwise
+            static std::vector<ppc_dec_node>  sm_dec_nodes;
+            static std::vector<uint16_t>      sm_dec_cands;                        // candidate opcode indices ( in table order )
+            static std::vector<bool>          sm_dec_chk;                          // opcode has operands whose validity needs to be checked
+            static std::vector<uint32_t>      sm_dec_field_first;                  // first operand field of each opcode in sm_dec_fields
+            static std::vector<ppc_dec_field> sm_dec_fields;
+            const ppc_opc_fun_ptr* m_opc_impl_tbl;              // opcode handler table ( indexed by opcode index )
         
             private:
             // Initialize opcode indices for faster look up
             static void init_opcd_indices();
+            // Build decode tree for a dialect
+            static void init_decode_tree(ppc_cpu_t dialect);
             // Initialize dialect
             void init_dialect();
             // Return new dialect according to specified cpu name
             ppc_cpu_t ppc_parse_cpu (ppc_cpu_t ppc_cpu, const char *arg);
             // Extract operand value from instruction
             long operand_value_powerpc (const struct powerpc_operand *operand, unsigned long insn);
+            // Same, using precomputed field of operand
+            long dec_field_value (const ppc_dec_field& field, unsigned long insn){
+                if unlikely(field.operand != NULL)
+                    return operand_value_powerpc(field.operand, insn);
+                long value = (insn >> field.shift) & field.mask;
+                return (value ^ field.sign) - field.sign;
+            }
         
             /* Find a match for INSN in the opcode table, given machine DIALECT.
             A DIALECT of -1 is special, matching all machine opcode variations.  */
             std::pair<const struct powerpc_opcode*, uint32_t> lookup_powerpc (unsigned long insn);
+            // Same as lookup_powerpc(), but walks decode tree instead of whole primary opcode group
+            std::pair<const struct powerpc_opcode*, uint32_t> lookup_decode_tree (unsigned long insn);
         
             // Helper function : check if standard delimiters are present
             int if_std_delims_present(char *str);
@@ -95,10 +155,11 @@ namespace ppcsimbooke {
             
             public:
             // constructor
-            ppcdis(){
+            ppcdis(): m_opc_impl_tbl(NULL) {
                 init_dialect();
                 if(!m_opcd_indices_done){
                     init_opcd_indices();
+                    init_decode_tree(m_dialect);
                     m_opcd_indices_done = 1;
                 }
                 m_dis_cache.set_size(1024);   // 256 entry cache
@@ -126,6 +187,11 @@ namespace ppcsimbooke {
             bool is_sc(instr_call& ic);                    // is system call
             bool is_rfxi(instr_call& ic);                  // is rfi, rfci, rfmci etc.
             bool is_control_xfer(instr_call& ic);          // is this a control transfer instruction 
+            bool is_ctxt_alter(instr_call& ic);            // may change MSR, translations or timers ( mtmsr, isync etc. )
+            bool is_branch_link(instr_call& ic);           // is branch which sets LR ( call )
+            bool is_branch_lr(instr_call& ic);             // is branch to LR ( bclr, return )
+            bool is_branch_ctr(instr_call& ic);            // is branch to CTR ( bcctr )
+            bool is_side_effect_free(instr_call& ic);      // only affects GPRs, CR, XER, CTR & LR
 
             //////////////////////////////////////////////////////////////
             // misc.
@@ -135,11 +201,32 @@ namespace ppcsimbooke {
             int get_opc_index(std::string opcname);
             // Returns a hashed value of opcode
             uint64_t get_opc_hash(std::string opcname);
+            // Register opcode handler table. Decoded instrs carry their handler (instr_call::fptr)
+            // looked up from this table. Table should have get_num_handlers() entries.
+            void set_opc_impl_table(const ppc_opc_fun_ptr* tbl);
+            // Make an already decoded call frame execute as opcode opcname ( which must take same operands ).
+            // Used by block level optimizations to swap in cheaper variants of an instr.
+            bool retarget(instr_call& ic, std::string opcname);
+            // Switch a decoded call frame to operand specialized variant of it's opcode ( if there is one ).
+            bool specialize(instr_call& ic);
+            // Check that decode tree finds same opcode ( & operand values ) as a linear scan of opcode table ( for tests )
+            bool decode_tree_matches(uint32_t insn);
+            // Variant a call frame was switched to ( NULL if it still runs it's own opcode's handler )
+            static const ppc_opc_variant* get_opc_variant(const instr_call& ic);
+            // If call frame was lowered to a block IR pseudo op. Those don't follow semantics of their opcode anymore.
+            static bool is_ir_op(const instr_call& ic){
+                const ppc_opc_variant* v = get_opc_variant(ic);
+                return (v && v->form == OPF_IR);
+            }
         
             // static functions
             static int get_num_opcodes(){
                 return powerpc_num_opcodes;
             }
+            // opcodes + operand specialized variants
+            static int get_num_handlers(){
+                return powerpc_num_opcodes + sm_n_opc_variants;
+            }
         
         };
     }
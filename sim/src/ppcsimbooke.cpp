@@ -66,6 +66,25 @@ uint64_t (cpu_e500v2_t::*get_reg_ptr2_d0)(std::string)   = &cpu_e500v2_t::get_re
 instr_call (ppcdis_e500v2_t::*disasm_ptr)(uint32_t, uint64_t, int)  = &ppcdis_e500v2_t::disasm;
 instr_call (ppcdis_e500v2_t::*disasm_ptr2)(std::string, uint64_t)   = &ppcdis_e500v2_t::disasm;
 
+// instr_call keeps opcode ( in hash value ) & opcode name ( as an interned id ) in packed form
+uint32_t    instr_call_get_opc(const instr_call& ic){ return ic.opc(); }
+void        instr_call_set_opc(instr_call& ic, uint32_t opc){ ic.hv = (static_cast<uint64_t>(opc) << 32) | (ic.hv & 0xffffffffULL); }
+std::string instr_call_get_opcname(const instr_call& ic){ return ic.opcname; }
+void        instr_call_set_opcname(instr_call& ic, std::string name){ ic.opcname = instr_name(name.c_str()); }
+
+// Argument n of an instr_call. Arguments are plain values now, so type ( t ) comes from
+// instr_call::argt & there's no register pointer ( p ) any more. Both are kept read only for old scripts.
+struct instr_arg_ref {
+    instr_call*   ic;
+    int           n;
+
+    size_t get_v() const      { return ic->arg[n].v;                }
+    void   set_v(size_t v)    { ic->arg[n].v = v;                   }
+    size_t get_p() const      { return 0;                           }
+    bool   get_t() const      { return ic->is_reg(n);               }
+};
+template<int ARG_NUM> instr_arg_ref instr_call_getarg(instr_call& ic){ instr_arg_ref r = { &ic, ARG_NUM }; return r; }
+
 // Overloads for CPU_PPC::step()
 BOOST_PYTHON_MEMBER_FUNCTION_OVERLOADS(step_overloads, step, 0, 1);
 
@@ -244,34 +263,34 @@ BOOST_PYTHON_MODULE(ppcsim)
         {
             class_<instr_call> instr_call_py("instr_call");
             scope instr_call_scope = instr_call_py;
-            instr_call_py.def_readwrite("opcode",   &instr_call::opc)
-                .def_readwrite("opcode_name",       &instr_call::opcname)
+            instr_call_py.add_property("opcode",    &instr_call_get_opc, &instr_call_set_opc)
+                .add_property("opcode_name",        &instr_call_get_opcname, &instr_call_set_opcname)
                 .def_readwrite("nargs",             &instr_call::nargs)
+                .def("is_reg",                      &instr_call::is_reg)
                 .def("dump_state",                  &instr_call::dump_state)
                 .def("print_instr",                 &instr_call::print_instr)
                 ;
 
             // instr_arg type
             {
-                class_<instr_call::instr_arg> instr_arg_py("instr_arg");
-                instr_arg_py.def_readwrite("v", &instr_call::instr_arg::v)
-                    .def_readwrite("p",   &instr_call::instr_arg::p)
-                    .def_readwrite("t",   &instr_call::instr_arg::t)
+                class_<instr_arg_ref> instr_arg_py("instr_arg", no_init);
+                instr_arg_py.add_property("v", &instr_arg_ref::get_v, &instr_arg_ref::set_v)
+                    .add_property("p",   &instr_arg_ref::get_p)
+                    .add_property("t",   &instr_arg_ref::get_t)
                     ;
             }
 
-            // Add arguments
-            instr_call_py.add_property("arg0", make_function(&instr_call::getarg<0>, return_value_policy<reference_existing_object>()))
-                .add_property("arg1",          make_function(&instr_call::getarg<1>, return_value_policy<reference_existing_object>()))
-                .add_property("arg2",          make_function(&instr_call::getarg<2>, return_value_policy<reference_existing_object>()))
-                .add_property("arg3",          make_function(&instr_call::getarg<3>, return_value_policy<reference_existing_object>()))
-                .add_property("arg4",          make_function(&instr_call::getarg<4>, return_value_policy<reference_existing_object>()))
-                .add_property("arg5",          make_function(&instr_call::getarg<5>, return_value_policy<reference_existing_object>()))
+            // Add arguments ( each keeps it's instr_call alive )
+            instr_call_py.add_property("arg0", make_function(&instr_call_getarg<0>, with_custodian_and_ward_postcall<0, 1>()))
+                .add_property("arg1",          make_function(&instr_call_getarg<1>, with_custodian_and_ward_postcall<0, 1>()))
+                .add_property("arg2",          make_function(&instr_call_getarg<2>, with_custodian_and_ward_postcall<0, 1>()))
+                .add_property("arg3",          make_function(&instr_call_getarg<3>, with_custodian_and_ward_postcall<0, 1>()))
+                .add_property("arg4",          make_function(&instr_call_getarg<4>, with_custodian_and_ward_postcall<0, 1>()))
                 ;
         }
 
         // ppc register type ( 64 bit )
-        class_<ppc_reg64>("ppc_reg64", init<uint64_t, uint64_t, int, int>())
+        class_<ppc_reg64, boost::noncopyable>("ppc_reg64", init<uint64_t, uint64_t, int, int>())
             .add_property("value",  &ppc_reg64::get_v, &ppc_reg64::set_v)
             .def_readonly("fvalue", &ppc_reg64::fvalue)
             .def_readonly("attr",   &ppc_reg64::attr)
@@ -283,7 +302,7 @@ BOOST_PYTHON_MODULE(ppcsim)
 
         // PPC register file type ( contains all registers, GPRs, SPRs etc. )
         {
-            class_<ppc_regs> ppc_regs_py("ppc_regs");
+            class_<ppc_regs, boost::noncopyable> ppc_regs_py("ppc_regs");
             scope ppc_regs_scope = ppc_regs_py;
             ppc_regs_py.add_property("MSR", &ppc_regs::msr)
                 .add_property("CR",  &ppc_regs::cr)
@@ -301,7 +320,7 @@ BOOST_PYTHON_MODULE(ppcsim)
 
         // Memory namespace
         {
-            class_<memory_e500v2_t> memory_py("memory");
+            class_<memory_e500v2_t, boost::noncopyable> memory_py("memory");
             scope memory_scope = memory_py;
             memory_py.def("reg_tgt",       &memory_e500v2_t::register_memory_target, register_memory_target_overloads())
                 .def("dump_tgts",          &memory_e500v2_t::dump_all_memory_targets)
@@ -347,7 +366,7 @@ BOOST_PYTHON_MODULE(ppcsim)
             ;
 
         // The derived cpu_ppc_book class ( Our main cpu class )
-        class_<cpu_e500v2_t> cpu_ppc_py("cpu_ppc", init<uint64_t, std::string>());
+        class_<cpu_e500v2_t, boost::noncopyable> cpu_ppc_py("cpu_ppc", init<uint64_t, std::string>());
         cpu_ppc_py.def("run_instr",   run_instr_ptr_d0)
             .def("run_instr",         run_instr_ptr2_d0)
             .def("run",               &cpu_e500v2_t::run)
@@ -379,15 +398,26 @@ BOOST_PYTHON_MODULE(ppcsim)
             .def_readonly("bm",       &cpu_e500v2_t::m_bm)
             .def("set_exec_mode_interpretive",     &cpu_e500v2_t::set_exec_mode_interpretive)
             .def("set_exec_mode_threaded",         &cpu_e500v2_t::set_exec_mode_threaded)
+            .def("set_exec_mode_direct_threaded",  &cpu_e500v2_t::set_exec_mode_direct_threaded)
+            .def("set_exec_mode_jit",              &cpu_e500v2_t::set_exec_mode_jit)
+            .def("set_exec_mode_tiered",           &cpu_e500v2_t::set_exec_mode_tiered)
+            .def("set_exec_mode_aot",              &cpu_e500v2_t::set_exec_mode_aot)
+            .def("aot_translate",                  &cpu_e500v2_t::aot_translate)
+            .def("load_aot",                       &cpu_e500v2_t::load_aot)
+            .def("unload_aot",                     &cpu_e500v2_t::unload_aot)
+            .def("set_tier_threshold",             &cpu_e500v2_t::set_tier_threshold)
+            .def("get_tier_threshold",             &cpu_e500v2_t::get_tier_threshold)
+            .def("get_tier_ninstrs",               &cpu_e500v2_t::get_tier_ninstrs)
+            .def("get_spin_idles",                 &cpu_e500v2_t::get_spin_idles)
             ;
 
 
     }
 
     // Class machine ( Our top level machine class. This is the class we are going to use directly. )
-    class_<machine_e500v2_t> machine_py("machine");
+    class_<machine_e500v2_t, boost::noncopyable> machine_py("machine");
     machine_py.def_readonly("ncpus", &machine_e500v2_t::m_ncpus)
-        .def_readwrite("memory",     &machine_e500v2_t::m_memory)
+        .def_readonly("memory",      &machine_e500v2_t::m_memory)
         .add_property("cpu0",        make_function(&machine_e500v2_t::get_cpu<0>, return_value_policy<reference_existing_object>()))
         .add_property("cpu1",        make_function(&machine_e500v2_t::get_cpu<1>, return_value_policy<reference_existing_object>()))
         .def("load_elf",             &machine_e500v2_t::load_elf)
@@ -1813,6 +1813,18 @@ namespace superstl {
         static inline void free(W64 key) { }
     };
 
+    // uint64_t is unsigned long ( not W64 ) on LP64 hosts
+    template <int setcount>
+    struct HashtableKeyManager<unsigned long, setcount> {
+        static inline int hash(unsigned long key) {
+            return foldbits<superstl_log2(setcount)>(W64(key));
+        }
+
+        static inline bool equal(unsigned long a, unsigned long b) { return (a == b); }
+        static inline unsigned long dup(unsigned long key) { return key; }
+        static inline void free(unsigned long key) { }
+    };
+
     template <int setcount>
     struct HashtableKeyManager<const char*, setcount> {
         static inline int hash(const char* key) {
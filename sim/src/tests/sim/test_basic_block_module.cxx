@@ -1,6 +1,162 @@
 #include "basic_block.h"
+#include "basic_block_ir.h"
+#include "test_common.h"
+#include <vector>
+
+using namespace ppcsimbooke;
+using namespace ppcsimbooke::ppcsimbooke_basic_block;
+
+// Decode instrs into block
+static void build(basic_block& bb, ppcsimbooke_dis::ppcdis& dis, const std::vector<uint32_t>& code){
+    bb.transopscount = code.size();
+    for(size_t i=0; i<code.size(); i++){ bb.transops[i] = dis.disasm(code[i], i*4); }
+}
+
+// Decode instrs into block & build it's IR
+static void build(basic_block& bb, basic_block_ir& ir, ppcsimbooke_dis::ppcdis& dis, const std::vector<uint32_t>& code){
+    build(bb, dis, code);
+    ir.build(bb);
+}
+
+// Name of opcode ( or IR pseudo op ) a call frame runs
+static std::string opname(const instr_call& ic){
+    const ppcsimbooke_dis::ppc_opc_variant* v = ppcsimbooke_dis::ppcdis::get_opc_variant(ic);
+    return (v) ? std::string(v->name) : ic.opcname;
+}
+
+// Constants are folded & known base addresses become absolute
+static bool test_const_prop(ppcsimbooke_dis::ppcdis& dis){
+    begin_test("const_prop");
+    basic_block    bb;
+    basic_block_ir ir;
+    bool           ok = true;
+
+    std::vector<uint32_t> code;
+    code.push_back(addi(3, 0, 5));          // li r3,5
+    code.push_back(addi(4, 3, 7));          // r4 = 12
+    code.push_back(ori(5, 4, 0x10));        // r5 = 0x1c
+    code.push_back(stw(5, 8, 4));           // stw r5,8(r4) -> address 20
+    code.push_back(lwz(4, 0, 6));           // r4 unknown from here
+    code.push_back(addi(7, 4, 1));
+    build(bb, ir, dis, code);
+    ir.const_prop(dis);
+
+    ok &= check(1, opname(bb.transops[1]) == "ir:li" && bb.transops[1].arg[IR_ARG].v == 12);
+    ok &= check(2, opname(bb.transops[2]) == "ir:li" && bb.transops[2].arg[IR_ARG].v == 0x1c);
+    ok &= check(3, opname(bb.transops[3]) == "stw:abs" && bb.transops[3].arg[IR_ARG].v == 20);
+    ok &= check(4, opname(bb.transops[5]) == "addi");
+    ok &= check(5, ir.nchanged == 3);
+    return ok;
+}
+
+// Reads of a copy read the original, till either of them is written
+static bool test_copy_prop(ppcsimbooke_dis::ppcdis& dis){
+    begin_test("copy_prop");
+    basic_block    bb;
+    basic_block_ir ir;
+    bool           ok = true;
+
+    std::vector<uint32_t> code;
+    code.push_back(mr(4, 3));               // mr r4,r3
+    code.push_back(add(5, 4, 6));           // add r5,r4,r6 -> add r5,r3,r6
+    code.push_back(addi(3, 3, 1));          // r3 changed, r4 isn't a copy anymore
+    code.push_back(add(8, 4, 4));
+    code.push_back(mr(9, 0));               // r0 is never propagated
+    code.push_back(stw(9, 0, 9));
+    build(bb, ir, dis, code);
+    ir.copy_prop();
+
+    ok &= check(1, bb.transops[1].arg[1].v == 3 && bb.transops[1].arg[2].v == 6);
+    ok &= check(2, bb.transops[3].arg[1].v == 4 && bb.transops[3].arg[2].v == 4);
+    ok &= check(3, bb.transops[5].arg[0].v == 9 && bb.transops[5].arg[2].v == 9);
+    ok &= check(4, ir.nchanged == 1);
+    return ok;
+}
+
+// Pure instrs whose result is overwritten before being read are dropped. Everything is live
+// at block end & at loads/stores.
+static bool test_elim_dead_regs(ppcsimbooke_dis::ppcdis& dis){
+    begin_test("elim_dead_regs");
+    basic_block    bb;
+    basic_block_ir ir;
+    bool           ok = true;
+
+    std::vector<uint32_t> code;
+    code.push_back(addi(3, 0, 1));          // dead ( r3 overwritten next )
+    code.push_back(addi(3, 0, 2));
+    code.push_back(add(4, 3, 3));           // dead ( r4 overwritten next )
+    code.push_back(addi(4, 0, 9));
+    code.push_back(addi(5, 0, 1));          // live at load
+    code.push_back(lwz(6, 0, 7));
+    code.push_back(addi(5, 0, 2));          // live at block end
+    build(bb, ir, dis, code);
+    ir.elim_dead_regs(dis);
+
+    ok &= check(1, opname(bb.transops[0]) == "ir:nop");
+    ok &= check(2, opname(bb.transops[1]) == "addi");
+    ok &= check(3, opname(bb.transops[2]) == "ir:nop");
+    ok &= check(4, opname(bb.transops[3]) == "addi" && opname(bb.transops[4]) == "addi");
+    ok &= check(5, opname(bb.transops[6]) == "addi");
+    ok &= check(6, ir.nchanged == 2);
+    return ok;
+}
+
+// CR0 / XER[CA] updates overwritten before anybody reads them are dropped. mfcr, adde &
+// branches read them, & both are live at block end.
+static bool test_elim_dead_flags(){
+    begin_test("elim_dead_flags");
+    basic_block_decoder dec(basic_block_ip(0, basic_block_ip::MFN_INV, 0, 0, 0, 0, true));
+    bool                ok = true;
+
+    std::vector<uint32_t> code;
+    code.push_back(add_(3, 4, 5));          // dead CR0 ( andi. overwrites it )
+    code.push_back(andi_(6, 7, 1));         // read by mfcr
+    code.push_back(mfcr(8));
+    code.push_back(addc(9, 4, 5));          // dead CA ( subfc overwrites it )
+    code.push_back(subfc(10, 4, 5));        // read by adde
+    code.push_back(adde(11, 4, 5));
+    code.push_back(add_(12, 4, 5));         // read by bne
+    code.push_back(bne(8));
+    build(dec.bb, dec.decoder, code);
+    dec.elim_dead_flags();
+
+    ok &= check(1, dec.bb.transops[0].opcname == "add");
+    ok &= check(2, dec.bb.transops[1].opcname == "andi.");
+    ok &= check(3, dec.bb.transops[3].opcname == "add");
+    ok &= check(4, dec.bb.transops[4].opcname == "subfc" && dec.bb.transops[5].opcname == "adde");
+    ok &= check(5, dec.bb.transops[6].opcname == "add.");
+
+    // CR0 of addic. is dead, but it's CA is read by the branch ( as are CR0 & CA of everything
+    // ending a block )
+    code.clear();
+    code.push_back(subfc(3, 4, 5));         // dead CA ( addic. overwrites it )
+    code.push_back(addic_(6, 7, 1));
+    code.push_back(add_(8, 4, 5));
+    code.push_back(b(8));
+    build(dec.bb, dec.decoder, code);
+    dec.elim_dead_flags();
+
+    ok &= check(6, dec.bb.transops[0].opcname == "subf");
+    ok &= check(7, dec.bb.transops[1].opcname == "addic" && dec.bb.transops[2].opcname == "add.");
+
+    code.clear();
+    code.push_back(add_(3, 4, 5));
+    code.push_back(addc(6, 4, 5));
+    build(dec.bb, dec.decoder, code);
+    dec.elim_dead_flags();
+
+    ok &= check(8, dec.bb.transops[0].opcname == "add." && dec.bb.transops[1].opcname == "addc");
+    return ok;
+}
 
 int main(){
+    LOG_TO_FILE("test_basic_block_module.log");
+    ppcsimbooke_dis::ppcdis dis;
+    bool ok = true;
 
-    return 0;
+    ok &= test_const_prop(dis);
+    ok &= test_copy_prop(dis);
+    ok &= test_elim_dead_regs(dis);
+    ok &= test_elim_dead_flags();
+    return (ok) ? 0 : 1;
 }
@@ -0,0 +1,77 @@
+/*
+ * Helpers shared by sim tests.
+ */
+#ifndef TEST_COMMON_H_
+#define TEST_COMMON_H_
+
+#include <iostream>
+#include <stdint.h>
+
+// Name of test being run ( prefixes check results )
+static inline const char*& curr_test(){
+    static const char* name = NULL;
+    return name;
+}
+
+// Start a new test. Checks of each test are numbered from 1.
+static inline void begin_test(const char* name){
+    curr_test() = name;
+}
+
+// Print result of n'th check of current test ( Pass-<test>-<n> / Fail-<test>-<n> )
+static inline bool check(int n, bool cond){
+    std::cout << ((cond) ? "Pass-" : "Fail-");
+    if(curr_test()){ std::cout << curr_test() << "-"; }
+    std::cout << std::dec << n << std::endl;
+    return cond;
+}
+
+// Instr encoders
+static inline uint32_t addi(int rt, int ra, int16_t si)   { return (14 << 26) | (rt << 21) | (ra << 16) | static_cast<uint16_t>(si); }
+static inline uint32_t addis(int rt, int ra, int16_t si)  { return (15 << 26) | (rt << 21) | (ra << 16) | static_cast<uint16_t>(si); }
+static inline uint32_t addic_(int rt, int ra, int16_t si) { return (13 << 26) | (rt << 21) | (ra << 16) | static_cast<uint16_t>(si); }
+static inline uint32_t ori(int ra, int rs, uint16_t ui)   { return (24 << 26) | (rs << 21) | (ra << 16) | ui; }
+static inline uint32_t andi_(int ra, int rs, uint16_t ui) { return (28 << 26) | (rs << 21) | (ra << 16) | ui; }
+static inline uint32_t andis_(int ra, int rs, uint16_t ui){ return (29 << 26) | (rs << 21) | (ra << 16) | ui; }
+static inline uint32_t lwz(int rt, int16_t d, int ra)     { return (32 << 26) | (rt << 21) | (ra << 16) | static_cast<uint16_t>(d); }
+static inline uint32_t lwzx(int rt, int ra, int rb)       { return (31 << 26) | (rt << 21) | (ra << 16) | (rb << 11) | (23 << 1); }
+static inline uint32_t stw(int rs, int16_t d, int ra)     { return (36 << 26) | (rs << 21) | (ra << 16) | static_cast<uint16_t>(d); }
+static inline uint32_t add(int rt, int ra, int rb)        { return (31 << 26) | (rt << 21) | (ra << 16) | (rb << 11) | (266 << 1); }
+static inline uint32_t add_(int rt, int ra, int rb)       { return add(rt, ra, rb) | 1; }
+static inline uint32_t addc(int rt, int ra, int rb)       { return (31 << 26) | (rt << 21) | (ra << 16) | (rb << 11) | (10 << 1); }
+static inline uint32_t adde(int rt, int ra, int rb)       { return (31 << 26) | (rt << 21) | (ra << 16) | (rb << 11) | (138 << 1); }
+static inline uint32_t subfc(int rt, int ra, int rb)      { return (31 << 26) | (rt << 21) | (ra << 16) | (rb << 11) | (8 << 1); }
+static inline uint32_t cmpw(int bf, int ra, int rb)       { return (31 << 26) | (bf << 23) | (ra << 16) | (rb << 11); }
+static inline uint32_t cmplw(int bf, int ra, int rb)      { return cmpw(bf, ra, rb) | (32 << 1); }
+static inline uint32_t cmpwi(int bf, int ra, int16_t si)  { return (11 << 26) | (bf << 23) | (ra << 16) | static_cast<uint16_t>(si); }
+static inline uint32_t cmplwi(int bf, int ra, uint16_t ui){ return (10 << 26) | (bf << 23) | (ra << 16) | ui; }
+static inline uint32_t rlwinm(int ra, int rs, int sh, int mb, int me) { return (21 << 26) | (rs << 21) | (ra << 16) | (sh << 11) | (mb << 6) | (me << 1); }
+static inline uint32_t mr(int ra, int rs)                 { return (31 << 26) | (rs << 21) | (ra << 16) | (rs << 11) | (444 << 1); }
+static inline uint32_t nop()                              { return ori(0, 0, 0); }
+static inline uint32_t mtctr(int rs)                      { return 0x7c0903a6 | (rs << 21); }
+static inline uint32_t mflr(int rt)                       { return 0x7c0802a6 | (rt << 21); }
+static inline uint32_t mtlr(int rs)                       { return 0x7c0803a6 | (rs << 21); }
+static inline uint32_t mtspr(int spr, int rs)             { return 0x7c0003a6 | (rs << 21) | ((spr & 0x1f) << 16) | ((spr >> 5) << 11); }
+static inline uint32_t mfspr(int rt, int spr)             { return 0x7c0002a6 | (rt << 21) | ((spr & 0x1f) << 16) | ((spr >> 5) << 11); }
+// ( mtpmr/mfpmr are taken by macros of reg_fsl_emb.h )
+static inline uint32_t mtpmr_insn(int pmr, int rs)        { return 0x7c00039c | (rs << 21) | ((pmr & 0x1f) << 16) | ((pmr >> 5) << 11); }
+static inline uint32_t mfpmr_insn(int rt, int pmr)        { return 0x7c00029c | (rt << 21) | ((pmr & 0x1f) << 16) | ((pmr >> 5) << 11); }
+static inline uint32_t mtxer(int rs)                      { return mtspr(1, rs); }
+static inline uint32_t mfxer(int rt)                      { return mfspr(rt, 1); }
+static inline uint32_t mfcr(int rt)                       { return 0x7c000026 | (rt << 21); }
+static inline uint32_t mtmsr(int rs)                      { return 0x7c000124 | (rs << 21); }
+static inline uint32_t mfmsr(int rt)                      { return 0x7c0000a6 | (rt << 21); }
+static inline uint32_t tlbwe()                            { return 0x7c0007a4; }
+static inline uint32_t sc()                               { return 0x44000002; }
+static inline uint32_t b(int32_t rel)                     { return 0x48000000 | (rel & 0x3fffffc); }
+static inline uint32_t bl(int32_t rel)                    { return 0x48000001 | (rel & 0x3fffffc); }
+static inline uint32_t bdnz(int32_t rel)                  { return 0x42000000 | (rel & 0xfffc); }
+static inline uint32_t bne(int32_t rel)                   { return 0x40820000 | (rel & 0xfffc); }
+static inline uint32_t beq(int32_t rel)                   { return 0x41820000 | (rel & 0xfffc); }
+static inline uint32_t blt(int32_t rel)                   { return 0x41800000 | (rel & 0xfffc); }
+static inline uint32_t bc(int bo, int bi, int32_t rel)    { return (16 << 26) | (bo << 21) | (bi << 16) | (rel & 0xfffc); }
+static inline uint32_t blr()                              { return 0x4e800020; }
+static inline uint32_t bctr()                             { return 0x4e800420; }
+static inline uint32_t bctrl()                            { return 0x4e800421; }
+
+#endif
@@ -2,9 +2,1082 @@
  * Test to check if cpu_ppc's interface is working fine.
  */
 #include "cpu_ppc.h"
+#include "test_common.h"
 #include <string>
+#include <vector>
+#include <sstream>
+#include <fstream>
+#include <thread>
+#include <chrono>
 
 using std::string;
+using namespace ppcsimbooke;
+
+typedef void (ppcsimbooke_cpu::cpu::*exec_mode_fn)();
+
+// Guest code is placed at start of reset page ( mapped by reset tlb entry ) & is entered
+// from reset vector. It has to end with "b ." ( see run_guest() ).
+static const uint64_t CODE_BASE = 0xfffff000ULL;
+static const uint64_t DATA_BASE = 0xfffff800ULL;
+static const uint64_t RESET_VEC = 0xfffffffcULL;
+
+// rt = v
+static void li32(std::vector<uint32_t>& code, int rt, uint32_t v){
+    code.push_back(addis(rt, 0, static_cast<int16_t>(v >> 16)));
+    code.push_back(ori(rt, rt, v & 0xffff));
+}
+
+// Big endian image writers
+static void put8(std::vector<uint8_t>& img, uint32_t v)  { img.push_back(v & 0xff); }
+static void put16(std::vector<uint8_t>& img, uint32_t v) { put8(img, v >> 8); put8(img, v); }
+static void put32(std::vector<uint8_t>& img, uint32_t v) { put16(img, v >> 16); put16(img, v); }
+static void put_shdr(std::vector<uint8_t>& img, uint32_t name, uint32_t type, uint32_t flags, uint32_t addr, uint32_t off,
+        uint32_t size, uint32_t align){
+    uint32_t f[] = { name, type, flags, addr, off, size, 0, 0, align, 0 };
+    for(int i=0; i<10; i++){ put32(img, f[i]); }
+}
+
+// Write code as a minimal big endian ELF32 executable ( one .text section at addr, which is also the entry )
+static void write_elf(const string& file, uint64_t addr, const std::vector<uint32_t>& code){
+    static const char shstrtab[] = "\0.text\0.shstrtab";      // names at 1 & 7
+    std::vector<uint8_t> img;
+    uint32_t text_off = 0x40;
+    uint32_t text_sz  = code.size()*4;
+    uint32_t str_off  = text_off + text_sz;
+    uint32_t sh_off   = (str_off + sizeof(shstrtab) + 3) & ~3U;
+
+    // elf header
+    put8(img, 0x7f); put8(img, 'E'); put8(img, 'L'); put8(img, 'F');
+    put8(img, 1); put8(img, 2); put8(img, 1);                          // ELFCLASS32, ELFDATA2MSB, EV_CURRENT
+    while(img.size() < 16){ put8(img, 0); }
+    put16(img, 2); put16(img, 20); put32(img, 1);                      // ET_EXEC, EM_PPC
+    put32(img, addr); put32(img, 0); put32(img, sh_off); put32(img, 0); // entry, no program headers, section headers, flags
+    put16(img, 52); put16(img, 32); put16(img, 0); put16(img, 40); put16(img, 3); put16(img, 2);
+    while(img.size() < text_off){ put8(img, 0); }
+
+    for(size_t i=0; i<code.size(); i++){ put32(img, code[i]); }
+    for(size_t i=0; i<sizeof(shstrtab); i++){ put8(img, shstrtab[i]); }
+    while(img.size() < sh_off){ put8(img, 0); }
+
+    // section headers ( null, .text, .shstrtab )
+    put_shdr(img, 0, 0, 0, 0, 0, 0, 0);
+    put_shdr(img, 1, 1, 0x6, addr, text_off, text_sz, 4);             // SHT_PROGBITS, SHF_ALLOC | SHF_EXECINSTR
+    put_shdr(img, 7, 3, 0, 0, str_off, sizeof(shstrtab), 1);          // SHT_STRTAB
+
+    std::ofstream ofs(file.c_str(), std::ios::binary);
+    ofs.write(reinterpret_cast<const char*>(&img[0]), img.size());
+}
+
+// Place guest code at CODE_BASE ( with a branch to it at reset vector ) & register memory with cpu
+static void load_guest(ppcsimbooke_cpu::cpu& cpu0, ppcsimbooke_memory::memory& mem, const std::vector<uint32_t>& code){
+    for(size_t i=0; i<code.size(); i++){ mem.write32(CODE_BASE + i*4, code[i]); }
+    mem.write32(RESET_VEC, b(CODE_BASE - RESET_VEC));
+    cpu0.register_mem(mem);
+}
+
+// Run guest code in given exec mode on a fresh cpu. Returns false if it didn't reach end_pc
+// ( it's last instr by default ).
+static bool run_guest(ppcsimbooke_cpu::cpu& cpu0, ppcsimbooke_memory::memory& mem, const std::vector<uint32_t>& code, exec_mode_fn mode,
+        uint64_t end_pc = 0){
+    if(end_pc == 0){ end_pc = CODE_BASE + (code.size() - 1)*4; }
+
+    load_guest(cpu0, mem, code);
+    (cpu0.*mode)();
+    cpu0.run();
+
+    // Wait for guest to reach end & run loop to exit ( total instr count is updated on exit )
+    int ms = 0;
+    for(; cpu0.get_pc() != end_pc && ms < 10000; ms++){ std::this_thread::sleep_for(std::chrono::milliseconds(1)); }
+    cpu0.stop();
+    for(; cpu0.get_ninstrs() == 0 && ms < 20000; ms++){ std::this_thread::sleep_for(std::chrono::milliseconds(1)); }
+    return (cpu0.get_pc() == end_pc && cpu0.get_ninstrs() != 0);
+}
+
+// Architected state which must be same in all exec modes
+static string guest_state(ppcsimbooke_cpu::cpu& cpu0){
+    std::ostringstream ostr;
+    ostr << std::hex;
+    for(int i=0; i<32; i++){
+        std::ostringstream reg;
+        reg << "r" << i;
+        ostr << reg.str() << "=" << cpu0.get_reg(reg.str()) << " ";
+    }
+    ostr << "cr=" << cpu0.get_reg("cr") << " xer=" << cpu0.get_reg("xer") << " ctr=" << cpu0.get_reg("ctr") << " lr=" << cpu0.get_reg("lr");
+    return ostr.str();
+}
+
+// Write TLB1 entry esel mapping 4K page at ea to ra ( with all permissions by default )
+static void tlb1_map(std::vector<uint32_t>& code, int esel, uint32_t ea, uint32_t ra, int tid, int ts, uint32_t perms = 0x3f){
+    static const int SPR_MAS0 = 624, SPR_MAS1 = 625, SPR_MAS2 = 626, SPR_MAS3 = 627;
+    li32(code, 9, 0x10000000 | (esel << 16));                          // TLBSEL=1
+    code.push_back(mtspr(SPR_MAS0, 9));
+    li32(code, 9, 0x80000100 | (tid << 16) | (ts << 12));              // V, TSIZE=4K
+    code.push_back(mtspr(SPR_MAS1, 9));
+    li32(code, 9, ea);
+    code.push_back(mtspr(SPR_MAS2, 9));
+    li32(code, 9, ra | perms);
+    code.push_back(mtspr(SPR_MAS3, 9));
+    code.push_back(tlbwe());
+}
+
+// Step cpu till it's PC is pc ( at most n instrs ). Returns false if it didn't get there.
+static bool step_to(ppcsimbooke_cpu::cpu& cpu0, uint64_t pc, int n = 1000){
+    for(int i=0; i<n && cpu0.get_pc() != pc; i++){ cpu0.step(1); }
+    return (cpu0.get_pc() == pc);
+}
+
+// Instrs run through handlers resolved at decode time ( from flat handler table ) must give same
+// results as before. Handler table is shared, so every cpu has same handler for an opcode.
+static bool test_flat_dispatch(){
+    begin_test("flat_dispatch");
+    ppcsimbooke_cpu::cpu    cpu0(0x80101234, "e500v2");
+    ppcsimbooke_cpu::cpu    cpu1(0x80101235, "e500v2");
+    ppcsimbooke_dis::ppcdis dis;
+    bool                    ok = true;
+
+    cpu0.run_instr(addi(3, 0, 0x345));
+    cpu0.run_instr(addis(4, 0, 0x12));
+    cpu0.run_instr(add(5, 3, 4));
+    cpu0.run_instr(ori(6, 5, 0xf000));
+    cpu0.run_instr(rlwinm(7, 6, 8, 0, 23));
+    cpu0.run_instr(mtctr(7));
+    cpu0.run_instr(mfspr(8, 9));                           // mfctr r8
+    cpu0.run_instr(cmpw(1, 5, 7));
+    ok &= check(1, cpu0.get_reg("r5") == 0x120345 && cpu0.get_reg("r6") == 0x12f345);
+    ok &= check(2, cpu0.get_reg("r7") == 0x12f34500 && cpu0.get_reg("r8") == 0x12f34500);
+    ok &= check(3, (cpu0.get_reg("cr") & 0x0f000000) == 0x08000000);
+
+    instr_call ic_addi = dis.disasm(addi(3, 0, 1));
+    instr_call ic_add  = dis.disasm(add(3, 4, 5));
+    ok &= check(4, cpu0.get_opc_impl(ic_addi.hv) != NULL && cpu0.get_opc_impl(ic_addi.hv) == cpu1.get_opc_impl(ic_addi.hv));
+    ok &= check(5, cpu0.get_opc_impl(ic_add.hv) != NULL && cpu0.get_opc_impl(ic_add.hv) != cpu0.get_opc_impl(ic_addi.hv));
+    return ok;
+}
+
+// Direct threaded code must leave same state ( & memory ) as interpretive & threaded modes. Loop
+// has loads, stores, record forms, conditional branches & a call.
+static bool test_direct_threaded_vs_interpreter(){
+    begin_test("direct_threaded_vs_interpreter");
+    static const int NITERS = 50;
+
+    std::vector<uint32_t> code;
+    code.push_back(b(3*4));                                // skip func
+    size_t func = code.size();
+    code.push_back(add(7, 7, 5));
+    code.push_back(blr());
+    li32(code, 11, DATA_BASE);
+    code.push_back(addi(4, 0, NITERS));
+    code.push_back(mtctr(4));
+    size_t loop = code.size();
+    code.push_back(lwz(5, 0, 11));
+    code.push_back(addi(5, 5, 3));
+    code.push_back(stw(5, 0, 11));
+    code.push_back(bl((func - code.size())*4));
+    code.push_back(add_(6, 5, 7));
+    code.push_back(cmpwi(0, 5, 60));
+    code.push_back(blt(8));
+    code.push_back(addi(8, 8, 1));
+    code.push_back(bdnz((loop - code.size())*4));
+    code.push_back(b(0));
+
+    exec_mode_fn modes[] = { &ppcsimbooke_cpu::cpu::set_exec_mode_interpretive,
+                             &ppcsimbooke_cpu::cpu::set_exec_mode_threaded,
+                             &ppcsimbooke_cpu::cpu::set_exec_mode_direct_threaded };
+    string state[3];
+    bool   ok = true;
+
+    for(int i=0; i<3; i++){
+        ppcsimbooke_memory::memory mem;
+        ppcsimbooke_cpu::cpu       cpu0(0x80101234, "e500v2");
+        mem.write32(DATA_BASE, 0);
+        ok &= check(1 + i, run_guest(cpu0, mem, code, modes[i]));
+        ok &= check(4 + i, cpu0.get_reg("r5") == 3*NITERS && cpu0.get_reg("r7") == 3*NITERS*(NITERS + 1)/2 &&
+                           cpu0.get_reg("r8") == NITERS - 19 && mem.read32(DATA_BASE) == 3*NITERS);
+        std::ostringstream ostr;
+        ostr << std::hex << " " << mem.read32(DATA_BASE);
+        state[i] = guest_state(cpu0) + ostr.str();
+    }
+    ok &= check(7, state[0] == state[1]);
+    ok &= check(8, state[0] == state[2]);
+    return ok;
+}
+
+// Chained blocks must not outlive translation they were chained under. body() calls a function
+// at EA from same call site, first with EA mapped to RA1 & then ( after a tlbwe ) to RA2, which
+// has different code.
+static bool test_block_chaining(){
+    begin_test("block_chaining");
+    static const int      NITERS = 20;
+    static const uint32_t EA = 0xffffe000, RA1 = 0x00100000, RA2 = 0x00200000;
+
+    std::vector<uint32_t> code;
+    code.push_back(0);                                     // b main
+    size_t body = code.size();
+    code.push_back(mflr(31));
+    code.push_back(mtctr(4));
+    size_t loop = code.size();
+    code.push_back(bl(static_cast<int32_t>(EA - static_cast<uint32_t>(CODE_BASE + code.size()*4))));
+    code.push_back(bdnz((loop - code.size())*4));
+    code.push_back(mtlr(31));
+    code.push_back(blr());
+    code[0] = b(code.size()*4);
+    code.push_back(addi(4, 0, NITERS));
+    tlb1_map(code, 1, EA, RA1, 0, 0);
+    code.push_back(bl((body - code.size())*4));
+    tlb1_map(code, 1, EA, RA2, 0, 0);
+    code.push_back(bl((body - code.size())*4));
+    code.push_back(b(0));
+
+    exec_mode_fn modes[] = { &ppcsimbooke_cpu::cpu::set_exec_mode_interpretive,
+                             &ppcsimbooke_cpu::cpu::set_exec_mode_threaded,
+                             &ppcsimbooke_cpu::cpu::set_exec_mode_direct_threaded };
+    bool ok = true;
+
+    for(int i=0; i<3; i++){
+        ppcsimbooke_memory::memory mem;
+        ppcsimbooke_cpu::cpu       cpu0(0x80101234, "e500v2");
+        mem.write32(RA1, addi(5, 5, 1));
+        mem.write32(RA1 + 4, blr());
+        mem.write32(RA2, addi(6, 6, 1));
+        mem.write32(RA2 + 4, blr());
+        ok &= check(1 + i, run_guest(cpu0, mem, code, modes[i]));
+        ok &= check(4 + i, cpu0.get_reg("r5") == NITERS && cpu0.get_reg("r6") == NITERS);
+    }
+    return ok;
+}
+
+// A loop hot enough to be run as a trace must leave same state as interpreter, both when it
+// leaves trace through a side exit ( every 8th iteration ) & after one of it's branches starts
+// going the other way ( from 100th iteration ).
+static bool test_trace_formation(){
+    begin_test("trace_formation");
+    static const int NITERS = 200;
+
+    std::vector<uint32_t> code;
+    code.push_back(addi(4, 0, NITERS));
+    code.push_back(mtctr(4));
+    size_t loop = code.size();
+    code.push_back(addi(3, 3, 1));
+    code.push_back(andi_(5, 3, 7));
+    code.push_back(bne(8));
+    code.push_back(addi(6, 6, 1));                         // every 8th iteration
+    code.push_back(cmpwi(1, 3, 100));
+    code.push_back(bc(12, 4, 12));                         // blt cr1, low
+    code.push_back(addi(8, 8, 1));
+    code.push_back(b(8));
+    code.push_back(addi(7, 7, 1));                         // low
+    code.push_back(add(9, 9, 3));
+    code.push_back(bdnz((loop - code.size())*4));
+    code.push_back(b(0));
+
+    exec_mode_fn modes[] = { &ppcsimbooke_cpu::cpu::set_exec_mode_interpretive,
+                             &ppcsimbooke_cpu::cpu::set_exec_mode_direct_threaded };
+    string state[2];
+    bool   ok = true;
+
+    for(int i=0; i<2; i++){
+        ppcsimbooke_memory::memory mem;
+        ppcsimbooke_cpu::cpu       cpu0(0x80101234, "e500v2");
+        ok &= check(1 + i, run_guest(cpu0, mem, code, modes[i]));
+        ok &= check(3 + i, cpu0.get_reg("r3") == NITERS && cpu0.get_reg("r6") == NITERS/8 && cpu0.get_reg("r7") == 99 &&
+                           cpu0.get_reg("r8") == NITERS - 99 && cpu0.get_reg("r9") == NITERS*(NITERS + 1)/2);
+        state[i] = guest_state(cpu0);
+    }
+    ok &= check(5, state[0] == state[1]);
+    return ok;
+}
+
+// JIT must leave same state as interpreter. lwz is an inline JIT template & here it's the last instr
+// of a block cut at MAX_BB_INS, so block has to end by moving PC past it.
+static bool test_jit_vs_interpreter(){
+    begin_test("jit_vs_interpreter");
+    std::vector<uint32_t> code;
+    code.push_back(addis(3, 0, -1));
+    code.push_back(ori(3, 3, DATA_BASE & 0xffff));         // r3 = DATA_BASE
+    code.push_back(addi(4, 0, 40));
+    code.push_back(mtctr(4));
+    size_t loop = code.size();
+    code.push_back(addi(7, 7, 1));
+    code.push_back(ori(5, 3, 0));
+    while(code.size() < loop + ppcsimbooke_basic_block::MAX_BB_INS - 1){ code.push_back(nop()); }
+    code.push_back(lwz(5, 0, 5));                          // r5 = *r5 ( EA depends on r5 itself )
+    code.push_back(add(6, 6, 5));
+    code.push_back(bdnz((loop - code.size())*4));
+    code.push_back(b(0));
+
+    exec_mode_fn modes[] = { &ppcsimbooke_cpu::cpu::set_exec_mode_interpretive,
+                             &ppcsimbooke_cpu::cpu::set_exec_mode_direct_threaded,
+                             &ppcsimbooke_cpu::cpu::set_exec_mode_jit };
+    string state[3];
+    bool   ok = true;
+
+    for(int i=0; i<3; i++){
+        ppcsimbooke_memory::memory mem;
+        ppcsimbooke_cpu::cpu       cpu0(0x80101234, "e500v2");
+        mem.write32(DATA_BASE, DATA_BASE + 0x100);
+        mem.write32(DATA_BASE + 0x100, 0x12345678);
+        ok &= check(1 + i, run_guest(cpu0, mem, code, modes[i]));
+        ok &= check(4 + i, static_cast<uint32_t>(cpu0.get_reg("r5")) == DATA_BASE + 0x100 && cpu0.get_reg("r7") == 40);
+        state[i] = guest_state(cpu0);
+    }
+    ok &= check(7, state[0] == state[1]);
+    ok &= check(8, state[0] == state[2]);
+    return ok;
+}
+
+// Stores to code must drop blocks covering stored bytes, even the one doing the store.
+// Each iteration patches first instr of it's own block ( which was already run ) with next
+// immediate, so k'th iteration adds k-1. A store to data sharing page with code must leave
+// blocks alone.
+static bool test_self_modifying_code(){
+    begin_test("self_modifying_code");
+    std::vector<uint32_t> code;
+    code.push_back(addis(3, 0, -1));
+    code.push_back(ori(3, 3, DATA_BASE & 0xffff));         // r3 = DATA_BASE
+    code.push_back(addis(12, 0, -1));
+    size_t patch_at = code.size();
+    code.push_back(0);                                     // r12 = address of patched instr
+    code.push_back(lwz(10, 0, 12));                        // r10 = patched instr
+    code.push_back(addi(4, 0, 20));
+    code.push_back(mtctr(4));
+    size_t loop = code.size();
+    code.push_back(addi(8, 8, 0));                         // patched instr
+    code.push_back(addi(10, 10, 1));
+    code.push_back(stw(10, 0, 12));
+    code.push_back(stw(9, 8, 3));
+    code.push_back(add(9, 9, 8));
+    code.push_back(bdnz((loop - code.size())*4));
+    code.push_back(b(0));
+    code[patch_at] = ori(12, 12, (CODE_BASE + loop*4) & 0xffff);
+
+    exec_mode_fn modes[] = { &ppcsimbooke_cpu::cpu::set_exec_mode_direct_threaded,
+                             &ppcsimbooke_cpu::cpu::set_exec_mode_jit,
+                             &ppcsimbooke_cpu::cpu::set_exec_mode_tiered };
+    bool ok = true;
+
+    for(int i=0; i<3; i++){
+        ppcsimbooke_memory::memory mem;
+        ppcsimbooke_cpu::cpu       cpu0(0x80101234, "e500v2");
+        ok &= check(1 + i, run_guest(cpu0, mem, code, modes[i]));
+        ok &= check(4 + i, cpu0.get_reg("r8") == 19*20/2);
+    }
+    return ok;
+}
+
+// A store inside a hot trace may drop a member of it, including the one trace exits from ( which
+// then must not be used as chain source ). Loop is a two block trace ( head loads store address
+// from a table, second block stores to it ). Only 100th iteration's address is second block's first
+// instr, which it patches to add 1 ( for remaining 100 iterations ).
+static bool test_self_modifying_trace(){
+    begin_test("self_modifying_trace");
+    static const int      NITERS     = 200;
+    static const int      PATCH_ITER = 99;
+    static const uint64_t SCRATCH    = DATA_BASE + 0x400;
+
+    std::vector<uint32_t> code;
+    li32(code, 3, DATA_BASE);                              // r3 = store address table
+    li32(code, 10, addi(8, 8, 1));
+    code.push_back(addi(4, 0, NITERS));
+    code.push_back(mtctr(4));
+    size_t loop = code.size();
+    code.push_back(lwz(12, 0, 3));
+    code.push_back(addi(3, 3, 4));
+    size_t exit_at = code.size();
+    code.push_back(0);                                     // beq end ( never taken, ends head block )
+    size_t patched = code.size();
+    code.push_back(addi(8, 8, 0));                         // patched instr
+    code.push_back(stw(10, 0, 12));
+    code.push_back(bdnz((loop - code.size())*4));
+    code[exit_at] = beq((code.size() - exit_at)*4);
+    code.push_back(b(0));
+
+    exec_mode_fn modes[] = { &ppcsimbooke_cpu::cpu::set_exec_mode_interpretive,
+                             &ppcsimbooke_cpu::cpu::set_exec_mode_direct_threaded };
+    bool ok = true;
+
+    for(int i=0; i<2; i++){
+        ppcsimbooke_memory::memory mem;
+        ppcsimbooke_cpu::cpu       cpu0(0x80101234, "e500v2");
+        for(int j=0; j<NITERS; j++){
+            mem.write32(DATA_BASE + j*4, (j == PATCH_ITER) ? (CODE_BASE + patched*4) : SCRATCH);
+        }
+        ok &= check(1 + i, run_guest(cpu0, mem, code, modes[i]));
+        ok &= check(3 + i, cpu0.get_reg("r8") == NITERS - PATCH_ITER - 1);
+    }
+    return ok;
+}
+
+// Host accesses to unmapped addresses must throw, & not leave a fault behind for guest to take
+// on next run.
+static bool test_host_access_faults(){
+    begin_test("host_access_faults");
+    static const uint64_t UNMAPPED = 0x10000000;
+
+    ppcsimbooke_memory::memory mem;
+    ppcsimbooke_cpu::cpu       cpu0(0x80101234, "e500v2");
+    bool                       ok = true;
+    int                        nthrown = 0;
+
+    cpu0.register_mem(mem);
+    try { cpu0.read32(UNMAPPED);     } catch(sim_except_ppc& e){ nthrown++; }
+    try { cpu0.write32(UNMAPPED, 1); } catch(sim_except_ppc& e){ nthrown++; }
+    try { cpu0.read8(UNMAPPED + 3);  } catch(sim_except_ppc& e){ nthrown++; }
+    ok &= check(1, nthrown == 3);
+
+    cpu0.write32(DATA_BASE, 0x12345678);
+    ok &= check(2, cpu0.read32(DATA_BASE) == 0x12345678 && mem.read32(DATA_BASE) == 0x12345678);
+
+    std::vector<uint32_t> code;
+    code.push_back(addi(3, 0, 1));
+    code.push_back(b(0));
+    ok &= check(3, run_guest(cpu0, mem, code, &ppcsimbooke_cpu::cpu::set_exec_mode_interpretive) && cpu0.get_reg("r3") == 1);
+    return ok;
+}
+
+// DSI & ISI must be delivered with SRR0 at faulting instr & sc with SRR0 after it. PC & NIP must
+// both be at vector, so that handler starts there. Handlers save SRR0 ( & DEAR ) & branch back.
+static bool test_exception_delivery(){
+    begin_test("exception_delivery");
+    static const int      SPR_SRR0 = 26, SPR_DEAR = 61, SPR_IVPR = 63, SPR_IVOR2 = 402, SPR_IVOR3 = 403, SPR_IVOR8 = 408;
+    static const uint32_t EA_RO = 0x10000000, EA_NX = 0x10001000, RA_RO = 0x00100000, RA_NX = 0x00101000;
+
+    // Vector is IVPR[48:63] || IVOR[52:63] || 0b0000 ( see ppc_exception() )
+    std::vector<uint32_t> code;
+    li32(code, 9, CODE_BASE >> 16);
+    code.push_back(mtspr(SPR_IVPR, 9));
+    size_t ivor_at = code.size();
+    code.push_back(0);                                     // li r9, dsi handler
+    code.push_back(mtspr(SPR_IVOR2, 9));
+    code.push_back(0);                                     // li r9, isi handler
+    code.push_back(mtspr(SPR_IVOR3, 9));
+    code.push_back(0);                                     // li r9, sc handler
+    code.push_back(mtspr(SPR_IVOR8, 9));
+    tlb1_map(code, 1, EA_RO, RA_RO, 0, 0, 0x33);           // read & execute only
+    tlb1_map(code, 2, EA_NX, RA_NX, 0, 0, 0x0f);           // read & write only
+    li32(code, 20, EA_RO);
+    li32(code, 21, EA_NX);
+    code.push_back(addi(3, 0, 0x55));
+    size_t dsi_at = code.size();
+    code.push_back(stw(3, 0, 20));                         // DSI
+    code.push_back(addi(10, 10, 1));
+    size_t sc_at = code.size();
+    code.push_back(sc());
+    code.push_back(addi(11, 11, 1));
+    code.push_back(mtctr(21));
+    code.push_back(bctr());                                // ISI
+    size_t isi_ret = code.size();
+    code.push_back(addi(12, 12, 1));
+    size_t end = code.size();
+    code.push_back(b(0));
+
+    while(code.size() % 4){ code.push_back(nop()); }
+    size_t dsi_h = code.size();
+    code.push_back(mfspr(22, SPR_SRR0));
+    code.push_back(mfspr(23, SPR_DEAR));
+    code.push_back(b((dsi_at + 1 - code.size())*4));
+    while(code.size() % 4){ code.push_back(nop()); }
+    size_t isi_h = code.size();
+    code.push_back(mfspr(24, SPR_SRR0));
+    code.push_back(b((isi_ret - code.size())*4));
+    while(code.size() % 4){ code.push_back(nop()); }
+    size_t sc_h = code.size();
+    code.push_back(mfspr(25, SPR_SRR0));
+    code.push_back(b((sc_at + 1 - code.size())*4));
+    code[ivor_at]     = addi(9, 0, ((CODE_BASE + dsi_h*4) & 0xffff) >> 4);
+    code[ivor_at + 2] = addi(9, 0, ((CODE_BASE + isi_h*4) & 0xffff) >> 4);
+    code[ivor_at + 4] = addi(9, 0, ((CODE_BASE + sc_h*4) & 0xffff) >> 4);
+
+    uint64_t vec[] = { CODE_BASE + dsi_h*4, CODE_BASE + sc_h*4, CODE_BASE + isi_h*4 };
+    bool     ok    = true;
+
+    // Step through all three
+    {
+        ppcsimbooke_memory::memory mem;
+        ppcsimbooke_cpu::cpu       cpu0(0x80101234, "e500v2");
+        load_guest(cpu0, mem, code);
+        for(int i=0; i<3; i++){
+            ok &= check(1 + i, step_to(cpu0, vec[i]) && cpu0.get_nip() == vec[i]);
+            cpu0.step(1);
+            ok &= check(4 + i, cpu0.get_pc() == vec[i] + 4);
+        }
+        ok &= check(7, step_to(cpu0, CODE_BASE + end*4));
+    }
+
+    exec_mode_fn modes[] = { &ppcsimbooke_cpu::cpu::set_exec_mode_interpretive,
+                             &ppcsimbooke_cpu::cpu::set_exec_mode_threaded,
+                             &ppcsimbooke_cpu::cpu::set_exec_mode_direct_threaded,
+                             &ppcsimbooke_cpu::cpu::set_exec_mode_jit,
+                             &ppcsimbooke_cpu::cpu::set_exec_mode_tiered };
+    for(int i=0; i<5; i++){
+        ppcsimbooke_memory::memory mem;
+        ppcsimbooke_cpu::cpu       cpu0(0x80101234, "e500v2");
+        mem.write32(RA_RO, 0);                             // DSI must leave it as is
+        ok &= check(8 + i, run_guest(cpu0, mem, code, modes[i], CODE_BASE + end*4));
+        ok &= check(13 + i, cpu0.get_reg("r22") == CODE_BASE + dsi_at*4 && cpu0.get_reg("r23") == EA_RO &&
+                            cpu0.get_reg("r24") == EA_NX && cpu0.get_reg("r25") == CODE_BASE + (sc_at + 1)*4 &&
+                            cpu0.get_reg("r10") == 1 && cpu0.get_reg("r11") == 1 && cpu0.get_reg("r12") == 1 &&
+                            mem.read32(RA_RO) == 0);
+    }
+    return ok;
+}
+
+// Instrs after a context altering one must run in new context, in every mode. mtmsr sets MSR[IS], which
+// maps code page to another real page ( TS=1 entry ). Old page has different instrs at same offsets.
+static bool test_ctxt_alter_ends_block(){
+    begin_test("ctxt_alter_ends_block");
+    static const uint32_t ALT_RA = 0x00102000;
+
+    std::vector<uint32_t> code;
+    tlb1_map(code, 1, CODE_BASE, ALT_RA, 0, 1);
+    li32(code, 3, MSR_IS);
+    code.push_back(addi(10, 10, 1));
+    code.push_back(mtmsr(3));
+    size_t next = code.size();
+    code.push_back(addi(10, 10, 1));                       // old page, mustn't run
+    code.push_back(addi(10, 10, 1));
+    code.push_back(b(0));
+
+    exec_mode_fn modes[] = { &ppcsimbooke_cpu::cpu::set_exec_mode_interpretive,
+                             &ppcsimbooke_cpu::cpu::set_exec_mode_threaded,
+                             &ppcsimbooke_cpu::cpu::set_exec_mode_direct_threaded,
+                             &ppcsimbooke_cpu::cpu::set_exec_mode_jit,
+                             &ppcsimbooke_cpu::cpu::set_exec_mode_tiered };
+    bool ok = true;
+
+    for(int i=0; i<5; i++){
+        ppcsimbooke_memory::memory mem;
+        ppcsimbooke_cpu::cpu       cpu0(0x80101234, "e500v2");
+        mem.write32(ALT_RA + next*4,       addi(11, 11, 1));
+        mem.write32(ALT_RA + (next + 1)*4, addi(11, 11, 1));
+        mem.write32(ALT_RA + (next + 2)*4, b(0));
+        ok &= check(1 + i, run_guest(cpu0, mem, code, modes[i]));
+        ok &= check(6 + i, cpu0.get_reg("r10") == 1 && cpu0.get_reg("r11") == 2 && (cpu0.get_reg("msr") & MSR_IS));
+    }
+    return ok;
+}
+
+// Breakpoints added while cpu is stopped must take effect on next step, & cpu must step past the
+// one it stopped at once breakpoints are gone.
+static bool test_instrumentation_mask(){
+    begin_test("instrumentation_mask");
+    std::vector<uint32_t> code;
+    for(int r=3; r<8; r++){ code.push_back(addi(r, r, 1)); }
+    code.push_back(b(0));
+
+    ppcsimbooke_memory::memory mem;
+    ppcsimbooke_cpu::cpu       cpu0(0x80101234, "e500v2");
+    bool                       ok = true;
+    int                        err = 0;
+
+    load_guest(cpu0, mem, code);
+    cpu0.step(2);                                          // branch at reset vector & first addi
+    ok &= check(1, cpu0.get_pc() == CODE_BASE + 4 && cpu0.get_reg("r3") == 1);
+
+    cpu0.m_bm.add_breakpoint(CODE_BASE + 12);
+    try { cpu0.step(10); } catch(sim_except& e){ err = e.err_code(); }
+    ok &= check(2, err == SIM_EXCEPT_SBKPT && cpu0.get_pc() == CODE_BASE + 12);
+    ok &= check(3, cpu0.get_reg("r4") == 1 && cpu0.get_reg("r5") == 1 && cpu0.get_reg("r6") == 0);
+
+    cpu0.m_bm.delete_all();
+    cpu0.step(2);
+    ok &= check(4, cpu0.get_pc() == CODE_BASE + 20 && cpu0.get_reg("r6") == 1 && cpu0.get_reg("r7") == 1);
+    return ok;
+}
+
+// Instrs counted once per block must add up to same count as interpreter's, with a branch
+// skipping an instr every so often & a call in the loop. Guest ends by branching to an unmapped
+// page, whose instr tlb miss vector is unmapped too, so no more instrs complete after that.
+static bool test_instr_accounting(){
+    begin_test("instr_accounting");
+    static const int      NITERS   = 100;
+    static const int      SPR_IVPR = 63, SPR_IVOR14 = 414;
+    static const uint64_t ITLB_VEC = 0xffff0100;
+    static const uint32_t UNMAPPED = 0xffffe000;
+
+    std::vector<uint32_t> code;
+    li32(code, 9, ITLB_VEC >> 16);
+    code.push_back(mtspr(SPR_IVPR, 9));
+    code.push_back(addi(9, 0, (ITLB_VEC & 0xffff) >> 4));
+    code.push_back(mtspr(SPR_IVOR14, 9));
+    code.push_back(addi(4, 0, NITERS));
+    code.push_back(mtctr(4));
+    size_t loop = code.size();
+    code.push_back(addi(3, 3, 1));
+    code.push_back(andi_(5, 3, 3));
+    code.push_back(bne(8));
+    code.push_back(addi(6, 6, 1));                         // every 4th iteration
+    code.push_back(bl(3*4));
+    code.push_back(bdnz((loop - code.size())*4));
+    code.push_back(b(static_cast<int32_t>(UNMAPPED - static_cast<uint32_t>(CODE_BASE + code.size()*4))));
+    code.push_back(addi(7, 7, 1));                         // func
+    code.push_back(blr());
+
+    // branch at reset vector, setup, loop & branch to unmapped page
+    size_t ninstrs = 1 + loop + NITERS*7 + NITERS/4 + 1;
+
+    exec_mode_fn modes[] = { &ppcsimbooke_cpu::cpu::set_exec_mode_interpretive,
+                             &ppcsimbooke_cpu::cpu::set_exec_mode_threaded,
+                             &ppcsimbooke_cpu::cpu::set_exec_mode_direct_threaded,
+                             &ppcsimbooke_cpu::cpu::set_exec_mode_jit,
+                             &ppcsimbooke_cpu::cpu::set_exec_mode_tiered };
+    bool ok = true;
+
+    for(int i=0; i<5; i++){
+        ppcsimbooke_memory::memory mem;
+        ppcsimbooke_cpu::cpu       cpu0(0x80101234, "e500v2");
+        ok &= check(1 + i, run_guest(cpu0, mem, code, modes[i], ITLB_VEC));
+        ok &= check(6 + i, cpu0.get_ninstrs() == ninstrs && cpu0.get_reg("r6") == NITERS/4 && cpu0.get_reg("r7") == NITERS);
+    }
+    return ok;
+}
+
+// A cpu polling a memory word idles till somebody else ( host or another cpu ) writes memory, & then
+// goes on. An armed decrementer bounds each idle period.
+static void polling_loop(std::vector<uint32_t>& code, uint32_t dec){
+    if(dec){
+        li32(code, 3, dec);
+        code.push_back(mtspr(SPRN_DEC, 3));
+        li32(code, 3, TCR_DIE);
+        code.push_back(mtspr(SPRN_TCR, 3));
+    }
+    li32(code, 11, DATA_BASE);
+    size_t loop = code.size();
+    code.push_back(lwz(3, 0, 11));
+    code.push_back(cmpwi(0, 3, 0));
+    code.push_back(beq((loop - code.size())*4));
+    code.push_back(b(0));
+}
+
+static bool test_polling_loop_wakeup(){
+    begin_test("polling_loop_wakeup");
+    bool ok = true;
+
+    // host writer, second cpu writer ( through it's own write count ), host writer with DEC armed
+    for(int i=0; i<3; i++){
+        std::vector<uint32_t> code;
+        polling_loop(code, (i == 2) ? 1000 : 0);
+
+        ppcsimbooke_memory::memory mem;
+        ppcsimbooke_cpu::cpu       cpu0(0x80101234, "e500v2");
+        ppcsimbooke_cpu::cpu       cpu1(0x80101235, "e500v2");
+        uint64_t                   idles = 0;
+        cpu1.register_mem(mem);
+
+        // Writes once cpu has gone idle ( with DEC armed, after giving it time to wake up a few times )
+        std::thread writer([&](){
+            int ms = 0;
+            for(; cpu0.get_spin_idles() == 0 && ms < 10000; ms++){ std::this_thread::sleep_for(std::chrono::milliseconds(1)); }
+            if(i == 2){
+                for(; cpu0.get_spin_idles() < 4 && ms < 10000; ms++){ std::this_thread::sleep_for(std::chrono::milliseconds(1)); }
+            }else{
+                std::this_thread::sleep_for(std::chrono::milliseconds(20));
+            }
+            idles = cpu0.get_spin_idles();
+            if(i == 1){ cpu1.write32(DATA_BASE, 1); }
+            else      { mem.write32(DATA_BASE, 1); }
+        });
+        ok &= check(1 + i*2, run_guest(cpu0, mem, code, &ppcsimbooke_cpu::cpu::set_exec_mode_direct_threaded));
+        writer.join();
+        ok &= check(2 + i*2, ((i == 2) ? (idles >= 4) : (idles == 1)) && cpu0.get_reg("r3") == 1);
+    }
+    return ok;
+}
+
+// CR0 & XER[SO, OV, CA] updated lazily ( & dropped where dead ) must read back same in all modes.
+// Loop mixes record & carrying forms, cmpw on cr1 & mtxer, reads flags with mfcr/mfxer & branches
+// on both CR0 & cr1. Values keep changing, so every flag goes both ways.
+static bool test_lazy_flags(){
+    begin_test("lazy_flags");
+    static const int NITERS = 32;
+
+    std::vector<uint32_t> code;
+    li32(code, 3, 0x7ffffff0);
+    code.push_back(addi(4, 0, 0x18));
+    code.push_back(addi(5, 0, NITERS));
+    code.push_back(mtctr(5));
+    size_t loop = code.size();
+    code.push_back(add_(6, 3, 4));                         // CR0 ( & SO ), overflows once in a while
+    code.push_back(addic_(7, 6, -0x20));                   // CA & CR0
+    code.push_back(subfc(8, 4, 7));                        // CA ( r7 >= r4 unsigned )
+    code.push_back(andi_(9, 6, 0x3));                      // CR0 ( zero every 4th iteration or so )
+    code.push_back(cmpw(1, 6, 3));                         // cr1
+    code.push_back(mfcr(10));
+    code.push_back(mfxer(11));
+    code.push_back(add(20, 20, 10));
+    code.push_back(add(21, 21, 11));
+    size_t beq_at = code.size();
+    code.push_back(0);                                     // beq skip ( on andi. )
+    code.push_back(addi(22, 22, 1));
+    code[beq_at] = beq((code.size() - beq_at)*4);
+    size_t blt_at = code.size();
+    code.push_back(0);                                     // blt cr1, skip
+    code.push_back(addi(23, 23, 1));
+    code[blt_at] = bc(12, 4, (code.size() - blt_at)*4);
+    code.push_back(andis_(12, 10, 0xe000));                // CR0 of andi. -> SO, OV & CA
+    code.push_back(mtxer(12));
+    code.push_back(addis(3, 3, 0x1235));
+    code.push_back(addi(4, 4, 7));
+    code.push_back(bdnz((loop - code.size())*4));
+    code.push_back(mfcr(24));
+    code.push_back(mfxer(25));
+    code.push_back(b(0));
+
+    exec_mode_fn modes[] = { &ppcsimbooke_cpu::cpu::set_exec_mode_interpretive,
+                             &ppcsimbooke_cpu::cpu::set_exec_mode_direct_threaded,
+                             &ppcsimbooke_cpu::cpu::set_exec_mode_jit };
+    string state[3];
+    bool   ok = true;
+
+    for(int i=0; i<3; i++){
+        ppcsimbooke_memory::memory mem;
+        ppcsimbooke_cpu::cpu       cpu0(0x80101234, "e500v2");
+        ok &= check(1 + i, run_guest(cpu0, mem, code, modes[i]));
+        state[i] = guest_state(cpu0);
+        if(i == 0){
+            // Both branches went both ways & XER was seen with bits set
+            ok &= check(4, cpu0.get_reg("r22") > 0 && cpu0.get_reg("r22") < NITERS &&
+                           cpu0.get_reg("r23") > 0 && cpu0.get_reg("r23") < NITERS && cpu0.get_reg("r21") != 0);
+        }
+    }
+    ok &= check(5, state[0] == state[1]);
+    ok &= check(6, state[0] == state[2]);
+    return ok;
+}
+
+// Every fused pair ( see RTL_FUSED_BEGIN in cpu_ppc_instr.cc ) must leave same state in direct
+// threaded mode as in interpretive one. Fused addis + lwz whose lwz faults on an unmapped address
+// must report lwz's PC & count only addis. Exception handler saves SRR0 & DEAR & jumps to an
+// unmapped page, where instr tlb misses keep cpu from completing any more instrs.
+static bool test_fused_pairs(){
+    begin_test("fused_pairs");
+    static const int      NITERS   = 8;
+    static const uint32_t UNMAPPED = 0x10000000;
+    static const int      SPR_SRR0 = 26, SPR_DEAR = 61, SPR_IVPR = 63, SPR_IVOR13 = 413, SPR_IVOR14 = 414;
+    static const uint64_t ITLB_VEC = 0xffff0100;
+
+    // Vector is IVPR[48:63] || IVOR[52:63] || 0b0000 ( see ppc_exception() )
+    std::vector<uint32_t> code;
+    li32(code, 11, DATA_BASE);
+    li32(code, 12, UNMAPPED);
+    code.push_back(addi(10, 0, 3));
+    code.push_back(addi(4, 0, NITERS));
+    code.push_back(mtctr(4));
+    li32(code, 9, ITLB_VEC >> 16);
+    code.push_back(mtspr(SPR_IVPR, 9));
+    code.push_back(addi(9, 0, (ITLB_VEC & 0xffff) >> 4));
+    code.push_back(mtspr(SPR_IVOR14, 9));
+    size_t ivor13_at = code.size();
+    code.push_back(0);                                     // li r9, handler
+    code.push_back(mtspr(SPR_IVOR13, 9));
+    code.push_back(addi(9, 0, 0x100));
+    code.push_back(b(4));                                  // registers set above aren't constants in blocks below
+    size_t loop = code.size();
+    code.push_back(addis(3, 9, 0x1234));
+    code.push_back(ori(3, 3, 0x5678));
+    code.push_back(addis(4, 9, -1));
+    code.push_back(addi(4, 4, 0x40));
+    code.push_back(addis(5, 11, 0));
+    code.push_back(lwz(6, 4, 5));                          // r3 of last iteration
+    code.push_back(rlwinm(7, 10, 2, 0, 29));
+    code.push_back(add(7, 7, 11));
+    code.push_back(rlwinm(8, 10, 2, 0, 29));
+    code.push_back(lwzx(13, 8, 11));
+    code.push_back(stw(3, 4, 11));
+    code.push_back(add(20, 20, 6));
+    code.push_back(add(21, 21, 13));
+    code.push_back(addi(9, 9, 0x111));
+    code.push_back(cmpw(0, 3, 4));
+    code.push_back(bne(4));
+    code.push_back(cmpwi(0, 6, 0));
+    code.push_back(beq(8));                                // taken on first iteration only
+    code.push_back(addi(22, 22, 1));
+    code.push_back(cmplw(1, 3, 4));
+    code.push_back(bc(12, 4, 4));                          // blt cr1
+    code.push_back(cmplwi(0, 7, 5));
+    code.push_back(bdnz((loop - code.size())*4));
+    code.push_back(b(4));
+    size_t fault_at = code.size() + 1;
+    code.push_back(addis(14, 12, 0));
+    code.push_back(lwz(15, 0, 14));                        // faults
+    code.push_back(addi(16, 0, 1));
+    code.push_back(b(0));
+    while(code.size() % 4){ code.push_back(nop()); }
+    size_t handler = code.size();
+    code[ivor13_at] = addi(9, 0, ((CODE_BASE + handler*4) & 0xffff) >> 4);
+    code.push_back(mfspr(30, SPR_SRR0));
+    code.push_back(mfspr(31, SPR_DEAR));
+    code.push_back(b(-0x1000 - handler*4));               // to unmapped page below CODE_BASE
+
+    // branch at reset vector, everything before loop, loop ( addi is skipped once ), b & addis,
+    // then the handler
+    size_t body    = fault_at - 2 - loop;
+    size_t ninstrs = 1 + loop + NITERS*body - 1 + 2 + 3;
+
+    exec_mode_fn modes[] = { &ppcsimbooke_cpu::cpu::set_exec_mode_interpretive,
+                             &ppcsimbooke_cpu::cpu::set_exec_mode_direct_threaded };
+    string state[2];
+    bool   ok = true;
+
+    for(int i=0; i<2; i++){
+        ppcsimbooke_memory::memory mem;
+        ppcsimbooke_cpu::cpu       cpu0(0x80101234, "e500v2");
+        mem.write32(DATA_BASE + 12, 0x89abcdef);
+        ok &= check(1 + i, run_guest(cpu0, mem, code, modes[i], ITLB_VEC));
+        ok &= check(3 + i, cpu0.get_reg("r30") == CODE_BASE + fault_at*4 && cpu0.get_reg("r31") == UNMAPPED &&
+                           cpu0.get_reg("r14") == UNMAPPED && cpu0.get_reg("r15") == 0 && cpu0.get_reg("r16") == 0);
+        ok &= check(5 + i, cpu0.get_ninstrs() == ninstrs);
+        ok &= check(7 + i, cpu0.get_reg("r21") == NITERS*0x89abcdefULL % 0x100000000ULL && cpu0.get_reg("r22") == NITERS - 1);
+        state[i] = guest_state(cpu0);
+    }
+    ok &= check(9, state[0] == state[1]);
+    return ok;
+}
+
+// Loads, stores & adds have handlers specialized for rA=0 & rA!=0 ( see ppcdis::specialize() ).
+// All of them, & a load whose rA is also it's rD, must leave same state in all modes.
+static bool test_specialized_variants(){
+    begin_test("specialized_variants");
+    static const int     NITERS = 40;
+    static const int16_t ABS_D  = static_cast<int16_t>((DATA_BASE + 4) & 0xffff);    // sign extends to DATA_BASE + 4
+
+    std::vector<uint32_t> code;
+    li32(code, 11, DATA_BASE);
+    code.push_back(addi(4, 0, NITERS));
+    code.push_back(mtctr(4));
+    code.push_back(b(4));
+    size_t loop = code.size();
+    code.push_back(lwz(5, 0, 11));                         // rA != 0 ( r5 = DATA_BASE + 0x20 )
+    code.push_back(lwz(5, 0, 5));                          // rA == rD
+    code.push_back(lwz(6, ABS_D, 0));                      // rA = 0
+    code.push_back(addi(7, 5, 3));
+    code.push_back(addi(8, 0, -2));
+    code.push_back(addis(9, 6, 1));
+    code.push_back(addis(10, 0, 0x1234));
+    code.push_back(add(7, 7, 8));
+    code.push_back(add(9, 9, 10));
+    code.push_back(stw(7, 0x20, 11));                      // next r5
+    code.push_back(stw(9, ABS_D, 0));                      // next r6
+    code.push_back(add(20, 20, 5));
+    code.push_back(add(21, 21, 6));
+    code.push_back(bdnz((loop - code.size())*4));
+    code.push_back(b(0));
+
+    exec_mode_fn modes[] = { &ppcsimbooke_cpu::cpu::set_exec_mode_interpretive,
+                             &ppcsimbooke_cpu::cpu::set_exec_mode_direct_threaded,
+                             &ppcsimbooke_cpu::cpu::set_exec_mode_jit };
+    string state[3];
+    bool   ok = true;
+
+    for(int i=0; i<3; i++){
+        ppcsimbooke_memory::memory mem;
+        ppcsimbooke_cpu::cpu       cpu0(0x80101234, "e500v2");
+        mem.write32(DATA_BASE, DATA_BASE + 0x20);
+        mem.write32(DATA_BASE + 4, 0x100);
+        mem.write32(DATA_BASE + 0x20, 0x55);
+        ok &= check(1 + i, run_guest(cpu0, mem, code, modes[i]));
+        ok &= check(4 + i, static_cast<uint32_t>(cpu0.get_reg("r5")) == 0x55 + NITERS - 1 &&
+                           static_cast<uint32_t>(cpu0.get_reg("r6")) == 0x100 + (NITERS - 1)*0x12350000U);
+        std::ostringstream ostr;
+        ostr << std::hex << " " << mem.read32(DATA_BASE + 4) << " " << mem.read32(DATA_BASE + 0x20);
+        state[i] = guest_state(cpu0) + ostr.str();
+    }
+    ok &= check(7, state[0] == state[1]);
+    ok &= check(8, state[0] == state[2]);
+    return ok;
+}
+
+// Every register looked up by ID ( through flat pointer table ) must be the one looked up by name.
+// It's ID follows from it's type & number. SPRs & PMRs written by guest must read back.
+static bool test_register_lookup(){
+    begin_test("register_lookup");
+    static const int sprs[] = { 26, 27, 256, 272, 273, 274, 275, 276, 277, 278, 279 };  // srr0/1, usprg0, sprg0-7
+    static const int PMR_PMC0 = 16;
+
+    ppcsimbooke_cpu::cpu cpu0(0x80101234, "e500v2");
+    ppc_regs&            regs = cpu0.___get_regs();
+    size_t               nmismatch = 0;
+    bool                 ok = true;
+
+    uint64_t v = 0x1000;
+    for(auto it = regs.m_reg.begin(); it != regs.m_reg.end(); ++it){ it->second->value.u64v = v++; }
+    for(auto it = regs.m_reg.begin(); it != regs.m_reg.end(); ++it){
+        const ppc_reg64* r  = it->second;
+        int              id = -1;
+        switch(r->type){
+            case REG_TYPE_GPR : id = REG_GPR0 + r->indx; break;
+            case REG_TYPE_SPR : id = REG_SPR0 + r->indx; break;
+            case REG_TYPE_PMR : id = REG_PMR0 + r->indx; break;
+            case REG_TYPE_MSR : id = REG_MSR;            break;
+            case REG_TYPE_CR  : id = REG_CR;             break;
+            case REG_TYPE_ACC : id = REG_ACC;            break;
+        }
+        if(regs.reg_by_id(id) != r || cpu0.get_reg(id) != cpu0.get_reg(it->first)){
+            if(nmismatch++ < 8){ std::cout << "mismatch for " << it->first << std::endl; }
+        }
+    }
+    ok &= check(1, nmismatch == 0);
+    ok &= check(2, regs.reg_by_id(-1) == NULL && regs.reg_by_id(ppc_regs::REG_N_IDS) == NULL);
+
+    nmismatch = 0;
+    for(size_t i=0; i<sizeof(sprs)/sizeof(sprs[0]); i++){
+        cpu0.run_instr(addi(3, 0, 0x100 + i));
+        cpu0.run_instr(mtspr(sprs[i], 3));
+        cpu0.run_instr(mfspr(4, sprs[i]));
+        if(cpu0.get_reg("r4") != 0x100 + i || cpu0.get_reg(REG_SPR0 + sprs[i]) != 0x100 + i){ nmismatch++; }
+    }
+    ok &= check(3, nmismatch == 0);
+
+    cpu0.run_instr(addi(3, 0, 0x77));
+    cpu0.run_instr(mtpmr_insn(PMR_PMC0, 3));
+    cpu0.run_instr(mfpmr_insn(5, PMR_PMC0));
+    ok &= check(4, cpu0.get_reg("r5") == 0x77 && cpu0.get_reg("pmc0") == 0x77);
+    return ok;
+}
+
+// Code translated ahead of time from an elf file must leave same state as direct threaded code.
+static bool test_aot_vs_direct_threaded(){
+    begin_test("aot_vs_direct_threaded");
+    static const char* elf_file = "test_cpu_ppc_interface_aot.elf";
+    static const char* so_file  = "test_cpu_ppc_interface_aot.so";
+
+    std::vector<uint32_t> code;
+    code.push_back(b(4*4));                                // skip func
+    size_t func = code.size();
+    code.push_back(addi(5, 5, 3));
+    code.push_back(addis(7, 5, -1));
+    code.push_back(blr());
+    code.push_back(addi(3, 0, 7));
+    code.push_back(addi(4, 0, 100));
+    code.push_back(mtctr(4));
+    size_t loop = code.size();
+    code.push_back(bl((func - loop)*4));
+    code.push_back(add(3, 3, 5));
+    code.push_back(add_(6, 3, 3));                         // CR0
+    code.push_back(bdnz((loop - code.size())*4));
+    code.push_back(b(0));
+    write_elf(elf_file, CODE_BASE, code);
+
+    exec_mode_fn modes[] = { &ppcsimbooke_cpu::cpu::set_exec_mode_direct_threaded,
+                             &ppcsimbooke_cpu::cpu::set_exec_mode_aot };
+    string state[2];
+    bool   ok = true;
+
+    for(int i=0; i<2; i++){
+        ppcsimbooke_memory::memory mem;
+        ppcsimbooke_cpu::cpu       cpu0(0x80101234, "e500v2");
+        mem.load_elf(elf_file);
+        cpu0.register_mem(mem);
+        if(modes[i] == &ppcsimbooke_cpu::cpu::set_exec_mode_aot){
+            ok &= check(1, cpu0.aot_translate(so_file) > 0);
+            cpu0.load_aot(so_file);
+        }
+        ok &= check(2 + i, run_guest(cpu0, mem, code, modes[i]));
+        state[i] = guest_state(cpu0);
+    }
+    ok &= check(4, state[0] == state[1]);
+    return ok;
+}
+
+// Returns & indirect branches predicted by return address stack & indirect target cache must
+// follow the guest, even after the code they lead to is patched.
+// body() calls func from two sites & bctrl's to tgta/tgtb alternately. It's run three times,
+// with func patched before 2nd run & both targets before 3rd ( so that their retranslated
+// blocks don't simply reuse their old ones ). Last, patcher() patches the instr it returns to
+// ( k'th call makes it add k ), & rewrites tgta as is, while it's call is in flight.
+static bool test_return_and_indirect_prediction(){
+    begin_test("return_and_indirect_prediction");
+    std::vector<uint32_t> code;
+    code.push_back(0);                                     // b main
+    size_t func = code.size();
+    code.push_back(addi(5, 5, 1));                         // patched to add 5
+    code.push_back(blr());
+    size_t tgta = code.size();
+    code.push_back(addi(20, 20, 1));                       // patched to add 3
+    code.push_back(blr());
+    size_t tgtb = code.size();
+    code.push_back(addi(21, 21, 2));                       // patched to add 7
+    code.push_back(blr());
+    size_t patcher = code.size();
+    code.push_back(addi(10, 10, 1));
+    code.push_back(stw(10, 0, 16));
+    code.push_back(lwz(17, 0, 14));
+    code.push_back(stw(17, 0, 14));
+    code.push_back(blr());
+
+    size_t body = code.size();
+    code.push_back(mflr(31));
+    size_t loop = code.size();
+    code.push_back(bl((func - code.size())*4));
+    code.push_back(add(6, 6, 5));
+    code.push_back(bl((func - code.size())*4));
+    code.push_back(add(7, 7, 5));
+    code.push_back(andi_(11, 30, 1));
+    code.push_back(add(11, 11, 11));
+    code.push_back(add(11, 11, 11));
+    code.push_back(add(11, 11, 11));                       // r11 = 0 or tgtb - tgta
+    code.push_back(add(13, 14, 11));
+    code.push_back(mtctr(13));
+    code.push_back(bctrl());
+    code.push_back(addic_(30, 30, -1));
+    code.push_back(bne((loop - code.size())*4));
+    code.push_back(mtlr(31));
+    code.push_back(blr());
+
+    code[0] = b(code.size()*4);
+    code.push_back(addis(14, 0, -1));
+    code.push_back(ori(14, 14, (CODE_BASE + tgta*4) & 0xffff));
+    code.push_back(addis(12, 0, -1));
+    code.push_back(ori(12, 12, (CODE_BASE + func*4) & 0xffff));
+    code.push_back(addi(30, 0, 30));
+    code.push_back(bl((body - code.size())*4));
+    code.push_back(addis(10, 0, addi(5, 5, 5) >> 16));
+    code.push_back(ori(10, 10, addi(5, 5, 5) & 0xffff));
+    code.push_back(stw(10, 0, 12));
+    code.push_back(addi(30, 0, 30));
+    code.push_back(bl((body - code.size())*4));
+    code.push_back(addis(10, 0, addi(20, 20, 3) >> 16));
+    code.push_back(ori(10, 10, addi(20, 20, 3) & 0xffff));
+    code.push_back(stw(10, 0, 14));
+    code.push_back(addis(10, 0, addi(21, 21, 7) >> 16));
+    code.push_back(ori(10, 10, addi(21, 21, 7) & 0xffff));
+    code.push_back(stw(10, (tgtb - tgta)*4, 14));
+    code.push_back(addi(30, 0, 30));
+    code.push_back(bl((body - code.size())*4));
+
+    code.push_back(addis(16, 0, -1));
+    size_t retsite_at = code.size();
+    code.push_back(0);                                     // r16 = address of retsite
+    code.push_back(lwz(10, 0, 16));
+    code.push_back(addi(4, 0, 10));
+    code.push_back(mtctr(4));
+    size_t loop4 = code.size();
+    code.push_back(bl((patcher - code.size())*4));
+    size_t retsite = code.size();
+    code.push_back(addi(22, 22, 0));                       // patched
+    code.push_back(bdnz((loop4 - code.size())*4));
+    code.push_back(b(0));
+    code[retsite_at] = ori(16, 16, (CODE_BASE + retsite*4) & 0xffff);
+
+    exec_mode_fn modes[] = { &ppcsimbooke_cpu::cpu::set_exec_mode_interpretive,
+                             &ppcsimbooke_cpu::cpu::set_exec_mode_direct_threaded,
+                             &ppcsimbooke_cpu::cpu::set_exec_mode_jit,
+                             &ppcsimbooke_cpu::cpu::set_exec_mode_tiered };
+    string state[4];
+    bool   ok = true;
+
+    for(int i=0; i<4; i++){
+        ppcsimbooke_memory::memory mem;
+        ppcsimbooke_cpu::cpu       cpu0(0x80101234, "e500v2");
+        ok &= check(1 + i, run_guest(cpu0, mem, code, modes[i]));
+        ok &= check(5 + i, cpu0.get_reg("r5") == 60*1 + 60*5 + 60*5 && cpu0.get_reg("r20") == 2*15*1 + 15*3 &&
+                           cpu0.get_reg("r21") == 2*15*2 + 15*7 && cpu0.get_reg("r22") == 10*11/2);
+        state[i] = guest_state(cpu0);
+    }
+    ok &= check(9, state[0] == state[1]);
+    ok &= check(10, state[0] == state[2]);
+    ok &= check(11, state[0] == state[3]);
+    return ok;
+}
 
 int main(){
     LOG_TO_FILE("test_cpu_ppc_interface.log");
@@ -20,5 +1093,26 @@ int main(){
     cpu0.run_instr("cmpi 0x0, 0x0, r0, 0x68a");
     cpu0.dump_state();
     cpu0.get_reg("r0");
-    return 0;
+
+    bool ok = true;
+    ok &= test_flat_dispatch();
+    ok &= test_direct_threaded_vs_interpreter();
+    ok &= test_block_chaining();
+    ok &= test_trace_formation();
+    ok &= test_jit_vs_interpreter();
+    ok &= test_self_modifying_code();
+    ok &= test_self_modifying_trace();
+    ok &= test_host_access_faults();
+    ok &= test_exception_delivery();
+    ok &= test_ctxt_alter_ends_block();
+    ok &= test_instrumentation_mask();
+    ok &= test_instr_accounting();
+    ok &= test_polling_loop_wakeup();
+    ok &= test_lazy_flags();
+    ok &= test_fused_pairs();
+    ok &= test_specialized_variants();
+    ok &= test_register_lookup();
+    ok &= test_aot_vs_direct_threaded();
+    ok &= test_return_and_indirect_prediction();
+    return (ok) ? 0 : 1;
 }
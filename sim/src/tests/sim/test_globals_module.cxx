@@ -1,10 +1,171 @@
 #include <iostream>
+#include <vector>
 #include "globals.h"
+#include "test_common.h"
 
-// NOTE : Only purpose of this test, is to capture syntax errors in misc.hpp 
+// Hot registers must be at start of ppc_regs, followed by pc, nip & lazy flags, all within a few
+// cache lines. Their ppc_reg64 entries must refer to the hot slots.
+static bool test_hot_register_layout(){
+    begin_test("hot_register_layout");
+    ppcsimbooke::ppc_regs regs;
+    const char*           base   = reinterpret_cast<const char*>(&regs);
+    size_t                nalias = 0;
+    bool                  ok     = true;
+
+    ok &= check(1, reinterpret_cast<const char*>(&regs.hot) == base);
+    ok &= check(2, reinterpret_cast<const char*>(&regs.pc) - base == sizeof(ppcsimbooke::ppc_hot_regs) &&
+                   reinterpret_cast<const char*>(&regs.lazy_pending + 1) - base <= 6*64);
+
+    for(int i=0; i<32; i++){ if(&regs.gpr[i].value != &regs.hot.gpr[i]){ nalias++; } }
+    ok &= check(3, nalias == 0 && &regs.cr.value == &regs.hot.cr && &regs.xer.value == &regs.hot.xer &&
+                   &regs.lr.value == &regs.hot.lr && &regs.ctr.value == &regs.hot.ctr && &regs.msr.value == &regs.hot.msr);
+
+    regs.m_reg["r5"]->value.u64v  = 0x1234;
+    regs.m_reg["ctr"]->value.u64v = 0x55;
+    ok &= check(4, regs.hot.gpr[5].u64v == 0x1234 && regs.hot.ctr.u64v == 0x55);
+    return ok;
+}
+
+// Flags both ALU backends compute. mul/imul leave ZF & SF undefined on host.
+static const uint32_t ALU_FLAGS = X86_EFLAGS_CF | X86_EFLAGS_ZF | X86_EFLAGS_SF | X86_EFLAGS_OF;
+static const uint32_t MUL_FLAGS = X86_EFLAGS_CF | X86_EFLAGS_OF;
+
+// Edge cases & a fixed sequence of pseudo random values
+template<typename T>
+static std::vector<T> alu_operands(){
+    typedef typename std::make_unsigned<T>::type U;
+    std::vector<T> v;
+    U edges[] = { 0, 1, 2, 3, 0x7f, 0x80, 0xff, 0x7fff, 0x8000, 0xffff,
+                  U(~U(0) >> 1), U(~(~U(0) >> 1)), U((~(~U(0) >> 1)) + 1), U(~U(0)), U(~U(0) - 1) };
+    for(size_t i=0; i<sizeof(edges)/sizeof(edges[0]); i++){ v.push_back(static_cast<T>(edges[i])); }
+    uint64_t x = 0x2545f4914f6cdd1dULL;
+    for(int i=0; i<300; i++){
+        x = x * 6364136223846793005ULL + 1442695040888963407ULL;     // LCG
+        v.push_back(static_cast<T>(x >> (64 - sizeof(T)*8)));
+    }
+    return v;
+}
+
+// Compare asm & builtin backends on every pair of operands
+template<typename T>
+static size_t alu_mismatches(){
+    typedef typename std::make_signed<T>::type   S;
+    typedef typename std::make_unsigned<T>::type U;
+    const S        smin = static_cast<S>(~(~U(0) >> 1));
+    std::vector<T> ops  = alu_operands<T>();
+    size_t         n    = 0;
+
+    // call writes flags to f
+#define CMP_ALU(call, mask)                                                                     \
+    {                                                                                           \
+        x86_flags f;                                                                            \
+        T         ra_ = x86_alu_asm::call;                                                      \
+        x86_flags fa  = f;                                                                      \
+        f.v = 0;                                                                                \
+        T         rb_ = x86_alu_builtin::call;                                                  \
+        if(ra_ != rb_ || ((fa.v ^ f.v) & (mask))){                                              \
+            if(n++ < 8){                                                                        \
+                std::cout << #call << " " << std::hex << static_cast<uint64_t>(a) << ", "       \
+                          << static_cast<uint64_t>(b) << std::endl;                             \
+            }                                                                                   \
+        }                                                                                       \
+    }
+
+    for(size_t i=0; i<ops.size(); i++){
+        T a = ops[i];
+        for(size_t j=0; j<ops.size(); j++){
+            T b = ops[j];
+            CMP_ALU(x86_add<T>(a, b, f), ALU_FLAGS);
+            CMP_ALU(x86_sub<T>(a, b, f), ALU_FLAGS);
+            CMP_ALU(x86_and<T>(a, b, f), ALU_FLAGS);
+            CMP_ALU(x86_or<T>(a, b, f), ALU_FLAGS);
+            CMP_ALU(x86_xor<T>(a, b, f), ALU_FLAGS);
+            CMP_ALU(x86_mul<T>(a, b, f, 0), MUL_FLAGS);
+            CMP_ALU(x86_mul<T>(a, b, f, 1), MUL_FLAGS);
+            CMP_ALU(x86_imul<T>(a, b, f, 0), MUL_FLAGS);
+            CMP_ALU(x86_imul<T>(a, b, f, 1), MUL_FLAGS);
+            // Host traps if quotient doesn't fit, so div is only used on unsigned types & idiv on
+            // signed ones ( like RTL does ). min/-1 traps too.
+            if(b != 0){
+                if(!std::is_signed<T>::value){
+                    CMP_ALU(x86_div<T>(a, b, 0), 0);
+                    CMP_ALU(x86_div<T>(a, b, 1), 0);
+                }
+                if(std::is_signed<T>::value && !(static_cast<S>(b) == S(-1) && static_cast<S>(a) == smin)){
+                    CMP_ALU(x86_idiv<T>(a, b, 0), 0);
+                    CMP_ALU(x86_idiv<T>(a, b, 1), 0);
+                }
+            }
+        }
+        T b = 0;
+        CMP_ALU(x86_neg<T>(a, f), ALU_FLAGS);
+    }
+#undef CMP_ALU
+
+    return n;
+}
+
+// Compare full products
+template<typename D, typename S>
+static size_t mulf_mismatches(){
+    std::vector<S> ops = alu_operands<S>();
+    size_t n = 0;
+
+    for(size_t i=0; i<ops.size(); i++){
+        for(size_t j=0; j<ops.size(); j++){
+            x86_flags fa, fb, fsa, fsb;
+            D ra = x86_alu_asm::x86_mulf<D, S>(ops[i], ops[j], fa),   rb = x86_alu_builtin::x86_mulf<D, S>(ops[i], ops[j], fb);
+            D sa = x86_alu_asm::x86_imulf<D, S>(ops[i], ops[j], fsa), sb = x86_alu_builtin::x86_imulf<D, S>(ops[i], ops[j], fsb);
+            if(ra != rb || sa != sb || ((fa.v ^ fb.v) & MUL_FLAGS) || ((fsa.v ^ fsb.v) & MUL_FLAGS)){
+                if(n++ < 8){ std::cout << "mulf " << std::hex << static_cast<int64_t>(ops[i]) << ", " << static_cast<int64_t>(ops[j]) << std::endl; }
+            }
+        }
+    }
+    return n;
+}
+
+// Both ALU backends must give same results & flags
+static bool test_alu_backends(){
+    begin_test("alu_backends");
+    bool ok = true;
+    // ( 8 bit host mul/div work on AX instead of DX:AX, so asm ops don't support them )
+    ok &= check(1, alu_mismatches<uint16_t>() == 0);
+    ok &= check(2, alu_mismatches<uint32_t>() == 0);
+    ok &= check(3, alu_mismatches<uint64_t>() == 0);
+    ok &= check(4, alu_mismatches<int32_t>() == 0);
+    ok &= check(5, alu_mismatches<int64_t>() == 0);
+    ok &= check(6, mulf_mismatches<uint64_t, uint32_t>() == 0);
+    ok &= check(7, mulf_mismatches<int64_t, int32_t>() == 0);
+    return ok;
+}
+
+// Call frame must fit a cache line, with names & formats interned once & comparing by value
+static bool test_instr_call_packing(){
+    begin_test("instr_call_packing");
+    ppcsimbooke::instr_call ic;
+    std::string             name("addi");
+    bool                    ok = true;
+
+    ic.opcname = name.c_str();
+    ic.hv      = (0x38000000ULL << 32) | 14;
+    ic.fmt     = ppcsimbooke::instr_strtab::intern("%-7s r%ld,r%ld,0x%lx");
+    ok &= check(1, sizeof(ic) <= 64 && ic.opc() == 0x38000000);
+    ok &= check(2, ic.opcname == "addi" && ic.opcname.id == ppcsimbooke::instr_name("addi").id &&
+                   ppcsimbooke::instr_name().id == 0 && ic.opcname != "add");
+    ok &= check(3, ic.fmt == ppcsimbooke::instr_strtab::intern("%-7s r%ld,r%ld,0x%lx") &&
+                   std::string(ppcsimbooke::instr_strtab::str(ic.fmt)) == "%-7s r%ld,r%ld,0x%lx");
+    return ok;
+}
+
+// NOTE : Captures syntax errors in misc.hpp, & checks that both ALU backends ( utils.h ) agree
 int main(){
     std::cout << "Compiled correctly." << std::endl;
     ppcsimbooke::instr_call ic[5];
     ic[0].dump_state();
-    return 0;
+
+    bool ok = true;
+    ok &= test_hot_register_layout();
+    ok &= test_alu_backends();
+    ok &= test_instr_call_packing();
+    return (ok) ? 0 : 1;
 }
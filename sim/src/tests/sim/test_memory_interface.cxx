@@ -2,9 +2,47 @@
  * Test to check if tlb_booke's interface is working fine.
  */
 #include "memory.h"
+#include "test_common.h"
 #include <string>
+#include <algorithm>
 
 using std::string;
+using namespace ppcsimbooke::ppcsimbooke_memory;
+
+// DDR must read back what was written anywhere in physical space ( & across pages ), whichever way
+// it's backed. A CCSR window inside it mustn't alias DDR. With flat backing ( CONFIG_MEM_FLAT ),
+// DDR pages are at fixed offsets from one host base.
+static bool test_ddr_backing(){
+    begin_test("ddr_backing");
+    static const uint64_t LO = 0x1000, HI = 0xffffff000ULL, WIN = 0x40000000;
+    memory  mem;
+    uint8_t out[0x2100], in[0x2100];
+    bool    ok = true;
+
+    mem.write32(LO, 0x11223344);
+    mem.write32(HI + 0xffc, 0x55667788);
+    mem.write32(0x1ffe, 0xaabbccdd);                        // crosses a page
+    ok &= check(1, mem.read32(LO) == 0x11223344 && mem.read32(HI + 0xffc) == 0x55667788 && mem.read32(0x1ffe) == 0xaabbccdd);
+
+    for(size_t i=0; i<sizeof(out); i++){ out[i] = static_cast<uint8_t>(i*7); }
+    mem.write_from_buffer(0x5f80, out, sizeof(out));
+    mem.read_to_buffer(0x5f80, in, sizeof(in));
+    ok &= check(2, std::equal(out, out + sizeof(out), in));
+
+    mem.write32(WIN, 0x5);
+    mem.write32(WIN + 0x1000, 0x6);
+    mem.register_memory_target(WIN, 0x1000, "ccsr", 0, TGT_CCSR, 50);
+    ok &= check(3, mem.read32(WIN) == 0);
+    mem.write32(WIN, 0x7);
+    ok &= check(4, mem.read32(WIN) == 0x7 && mem.read32(WIN + 0x1000) == 0x6 && mem.read32(WIN - 4) == 0);
+
+#ifdef CONFIG_MEM_FLAT
+    const uint8_t* base = mem.host_ptr(LO);
+    ok &= check(5, mem.host_ptr(LO + 0x1000) == base + 0x1000 && mem.host_ptr(HI) == base + (HI - LO));
+    ok &= check(6, mem.host_ptr(WIN) != base + (WIN - LO) && mem.host_ptr(WIN + 0x1000) == base + (WIN + 0x1000 - LO));
+#endif
+    return ok;
+}
 
 int main(){
     LOG_TO_FILE("test_memory_interface.log");
@@ -25,5 +63,8 @@ int main(){
     for(int i=0; i<80; i++)
         std::cout << (int)data[i] << " ";
     std::cout << std::endl;
-    return 0;
+
+    bool ok = true;
+    ok &= test_ddr_backing();
+    return (ok) ? 0 : 1;
 }
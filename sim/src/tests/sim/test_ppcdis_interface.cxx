@@ -1,4 +1,38 @@
 #include "ppc_dis.h"
+#include "test_common.h"
+
+// Decode tree must pick same opcode as a linear scan of opcode table.
+// Every primary & extended opcode is tried with a few operand patterns, followed by a fixed
+// sequence of pseudo random words ( same on every run ).
+static bool test_decode_tree(ppcsimbooke::ppcsimbooke_dis::ppcdis& dis){
+    begin_test("decode_tree");
+    static const uint32_t opr_pats[] = { 0x00000000, 0x03fff800, 0x02a95000, 0x01568800 };
+    size_t nmismatch = 0;
+    bool   ok        = true;
+
+    for(uint32_t op=0; op<64; op++){
+        for(uint32_t xo=0; xo<0x800; xo++){
+            for(size_t k=0; k<sizeof(opr_pats)/sizeof(opr_pats[0]); k++){
+                uint32_t insn = (op << 26) | opr_pats[k] | xo;
+                if(!dis.decode_tree_matches(insn)){
+                    if(nmismatch++ < 8){ std::cout << "mismatch at " << std::hex << insn << std::endl; }
+                }
+            }
+        }
+    }
+    ok &= check(1, nmismatch == 0);
+
+    nmismatch = 0;
+    uint32_t x = 0x12345678;
+    for(size_t i=0; i<2000000; i++){
+        x = x * 1664525 + 1013904223;               // LCG
+        if(!dis.decode_tree_matches(x)){
+            if(nmismatch++ < 8){ std::cout << "mismatch at " << std::hex << x << std::endl; }
+        }
+    }
+    ok &= check(2, nmismatch == 0);
+    return ok;
+}
 
 int main(int argc, char* argv[])
 {
@@ -7,5 +41,8 @@ int main(int argc, char* argv[])
     ppcsimbooke::instr_call c0 = dis0.disasm(0x7c4033cc, 0xffffffc, EMUL_BIG_ENDIAN);
     c0.dump_state();
     c0.print_instr();
-    return 0;
+
+    bool ok = true;
+    ok &= test_decode_tree(dis0);
+    return (ok) ? 0 : 1;
 }
@@ -498,7 +498,9 @@ void ppcsimbooke::ppcsimbooke_tlb::tlb::tlbive(uint64_t ea){
 //            search in main tlb arrays.
 //            
 //  @NOTE :
-//          If a TLB miss is encountered, the miss type as well as the offending address is returned as part of exception class
+//          If a TLB miss is encountered, XLATE_MISS is returned as xlated address.
+//          If entry is found but access isn't permitted, XLATE_PERM_FAULT is returned. It's upto the
+//          caller to raise ISI/DSI exceptions.
 std::tuple<uint64_t, uint8_t, uint64_t> ppcsimbooke::ppcsimbooke_tlb::tlb::xlate(uint64_t ea, bool as, uint8_t pid, uint8_t rwx, bool pr){
     LOG_DEBUG4(MSG_FUNC_START);
 
@@ -515,12 +517,14 @@ std::tuple<uint64_t, uint8_t, uint64_t> ppcsimbooke::ppcsimbooke_tlb::tlb::xlate
 
     uint16_t perm = (rwx << (pr*3));
 
-    static int size_pgm = sizeof(sm_pgmask_list);
+    static int size_pgm = sizeof(sm_pgmask_list)/sizeof(sm_pgmask_list[0]);
 
     // start searching for the tlb entry in cache first
+    // Cached translations are tagged with TSIZE ( in low bits of page aligned va ), so that a page of
+    // one size doesn't hit for some other page inside a bigger page at the same address.
     for(int indx=0; indx < size_pgm; indx++){
         // get va & offset
-        va     = to_virt(pr, rwx, as, pid, (ea & sm_pgmask_list[indx]));
+        va     = to_virt(pr, rwx, as, pid, (ea & sm_pgmask_list[indx])) | (indx + 1);
         
         ra    = m_tlb_cache[va];
         offset = ea & ~sm_pgmask_list[indx];
@@ -545,14 +549,14 @@ std::tuple<uint64_t, uint8_t, uint64_t> ppcsimbooke::ppcsimbooke_tlb::tlb::xlate
                     goto exit_loop_1;                                                                                 \
                 }else{                                                                                                \
                     if(rwx & 0x1){                                                                                    \
-                        std::cout << "Got ISI exception" <<std::endl;                                                 \
-                        throw sim_except_ppc(PPC_EXCEPTION_ISI, PPC_EXCEPT_ISI_ACS, "ISI exception.", ea);            \
+                        LOG_DEBUG4("Got ISI exception", std::endl);                                                   \
+                        return std::make_tuple(uint64_t(XLATE_PERM_FAULT), 0, 0);                                     \
                     }else if(rwx & 0x2){                                                                              \
-                        std::cout << "Got DSI write exception" << std::endl;                                          \
-                        throw sim_except_ppc(PPC_EXCEPTION_DSI, PPC_EXCEPT_DSI_ACS_W, "DSI write exception.", ea);    \
+                        LOG_DEBUG4("Got DSI write exception", std::endl);                                             \
+                        return std::make_tuple(uint64_t(XLATE_PERM_FAULT), 0, 0);                                     \
                     }else if(rwx & 0x4){                                                                              \
-                        std::cout << "Got DSI read exception" << std::endl;                                           \
-                        throw sim_except_ppc(PPC_EXCEPTION_DSI, PPC_EXCEPT_DSI_ACS_R, "DSI read exception.", ea);     \
+                        LOG_DEBUG4("Got DSI read exception", std::endl);                                              \
+                        return std::make_tuple(uint64_t(XLATE_PERM_FAULT), 0, 0);                                     \
                     }                                                                                                 \
                 }                                                                                                     \
             }                                                                                                         \
@@ -564,7 +568,7 @@ std::tuple<uint64_t, uint8_t, uint64_t> ppcsimbooke::ppcsimbooke_tlb::tlb::xlate
 
     LOG_DEBUG4(MSG_FUNC_END);
     // Instead of throwing TLB miss exception from here itself we are returning a value of -1
-    // The TLB miss exception will be thrown in the caller after it tries to get a hit with
+    // The TLB miss exception will be raised by the caller after it tries to get a hit with
     // three different PID registers ( viz. PID0, PID1 and PID2 ) and still fails.
     return std::make_tuple(-1, -1, -1);
 
@@ -575,7 +579,7 @@ std::tuple<uint64_t, uint8_t, uint64_t> ppcsimbooke::ppcsimbooke_tlb::tlb::xlate
     wimge  = entry->wimge;
 
     // Update the cache
-    m_tlb_cache.insert(to_virt(pr, rwx, as, pid, (ea & ~(entry->ps - 1))), entry->ra, entry->wimge); 
+    m_tlb_cache.insert(to_virt(pr, rwx, as, pid, (ea & ~(entry->ps - 1))) | entry->tflags.tsize, entry->ra, entry->wimge);
 
     LOG_DEBUG4(MSG_FUNC_END);
     return std::make_tuple((entry->ra + offset), wimge, entry->ps);
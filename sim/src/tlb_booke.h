@@ -124,6 +124,10 @@ namespace ppcsimbooke {
             t_tlb_entry& get_entry2(size_t tlbsel, size_t setno, size_t wayno);
         
             public:
+            // special xlated addresses returned by xlate()
+            static const uint64_t XLATE_MISS       = static_cast<uint64_t>(-1);  // no matching entry
+            static const uint64_t XLATE_PERM_FAULT = static_cast<uint64_t>(-2);  // access not permitted
+
             tlb();
             ~tlb();
         
@@ -421,27 +421,38 @@ inline std::ostream& operator<<(std::ostream& ostr, x86_flags f){
     return ostr;
 }
 
+// ALU ops.
+// There are two backends with same interface. RTL uses the one selected by CONFIG_ALU_BUILTIN ( see below ),
+// other one is still compiled, so both can be compared.
+
+// ALU ops as inline asm. Every op saves complete EFLAGS of the host ( lower 32 bits of RFLAGS ).
+namespace x86_alu_asm {
+
 #define def_x86_alu_op1(name, x86_op)                                    \
 template<typename T>                                                     \
 inline T name(T ra, x86_flags& f){                                       \
+    uint64_t fl;                          /* pop writes 64 bits */       \
     asm(                                                                 \
             #x86_op " %[ra]; pushf; pop %[f];"                           \
-            : [ra] "+a" (ra), [f] "=m" (f.v)                             \
+            : [ra] "+a" (ra), [f] "=r" (fl)                              \
             :                                                            \
             :                                                            \
        );                                                                \
+    f.v = fl;                                                            \
     return ra;                                                           \
 }
 
 #define def_x86_alu_op2(name, x86_op)                                    \
 template<typename T>                                                     \
 inline T name(T ra, T rb, x86_flags& f){                                 \
+    uint64_t fl;                          /* pop writes 64 bits */       \
     asm(                                                                 \
             #x86_op " %[rb], %[ra]; pushf; pop %[f];"                    \
-            : [ra] "+q" (ra), [f] "=m" (f.v)                             \
+            : [ra] "+q" (ra), [f] "=r" (fl)                              \
             : [rb] "q" (rb)                                              \
             :                                                            \
        );                                                                \
+    f.v = fl;                                                            \
     return ra;                                                           \
 }
 
@@ -459,12 +470,14 @@ def_x86_alu_op2(x86_xor, xor)
 template<typename T>                                                    \
 inline T name(T ra, T rb, x86_flags& f, bool high=0){                   \
     register T rd = 0;                                                  \
+    uint64_t fl;                          /* pop writes 64 bits */      \
     asm(                                                                \
             #x86_op " %[rb]; pushf; pop %[f];"                          \
-            : "+a" (ra), "=d" (rd), [f] "=m" (f.v)                      \
+            : "+a" (ra), "=d" (rd), [f] "=r" (fl)                       \
             : [rb] "q" (rb)                                             \
             :                                                           \
        );                                                               \
+    f.v = fl;                                                           \
     return (high) ? rd:ra;                                              \
 }
 
@@ -475,13 +488,15 @@ def_x86_mul_op(x86_imul, imul)
 template<typename D, typename S>                                        \
 inline D name(S ra, S rb, x86_flags& f){                                \
     register S rd = 0;                                                  \
+    uint64_t fl;                          /* pop writes 64 bits */      \
     asm(                                                                \
             #x86_op " %[rb]; pushf; pop %[f];"                          \
-            : "+a" (ra), "=d" (rd), [f] "=m" (f.v)                      \
+            : "+a" (ra), "=d" (rd), [f] "=r" (fl)                       \
             : [rb] "q" (rb)                                             \
             :                                                           \
        );                                                               \
-    return (D(rd) << sizeof(S)*8) | D(ra);                              \
+    f.v = fl;                                                           \
+    return (D(rd) << sizeof(S)*8) | D(typename std::make_unsigned<S>::type(ra));    \
 }
 
 def_x86_mulf_op(x86_mulf, mul)
@@ -490,10 +505,10 @@ def_x86_mulf_op(x86_imulf, imul)
 #define def_x86_div_op(name, x86_op)                                    \
 template<typename T>                                                    \
 inline T name(T ra, T rb, bool rem=0){                                  \
-    register T rd = 0;                                                  \
+    register T rd = (ra < T(0)) ? T(-1) : T(0);     /* upper half */    \
     asm(                                                                \
             #x86_op " %[rb];"                                           \
-            : "+a" (ra), "=d" (rd)                                      \
+            : "+a" (ra), "+d" (rd)                                      \
             : [rb] "q" (rb)                                             \
             :                                                           \
        );                                                               \
@@ -509,6 +524,136 @@ def_x86_div_op(x86_idiv, idiv)
 #undef def_x86_mul_op
 #undef def_x86_mulf_op
 #undef def_x86_div_op
+}
+
+// ALU ops in plain C++ ( CONFIG_ALU_BUILTIN ).
+// Same interface & same flags ( CF, ZF, SF & OF ) as asm versions, but compiler can see through them. So they
+// get inlined & folded into RTL bodies, and flags nobody reads are never computed.
+// NOTE : PF & AF are not computed. Nobody uses them.
+namespace x86_alu_builtin {
+
+// Double width type
+template<typename T> struct x86_wide;
+template<> struct x86_wide<int8_t>   { typedef int16_t           type; };
+template<> struct x86_wide<uint8_t>  { typedef uint16_t          type; };
+template<> struct x86_wide<int16_t>  { typedef int32_t           type; };
+template<> struct x86_wide<uint16_t> { typedef uint32_t          type; };
+template<> struct x86_wide<int32_t>  { typedef int64_t           type; };
+template<> struct x86_wide<uint32_t> { typedef uint64_t          type; };
+template<> struct x86_wide<int64_t>  { typedef __int128          type; };
+template<> struct x86_wide<uint64_t> { typedef unsigned __int128 type; };
+
+// ZF & SF for a result
+template<typename T>
+inline uint32_t x86_zs_flags(T r){
+    typedef typename std::make_signed<T>::type S;
+    return ((r == 0) ? X86_EFLAGS_ZF : 0) | ((static_cast<S>(r) < 0) ? X86_EFLAGS_SF : 0);
+}
+
+template<typename T>
+inline T x86_add(T ra, T rb, x86_flags& f){
+    typedef typename std::make_unsigned<T>::type U;
+    typedef typename std::make_signed<T>::type   S;
+    U r; S s;
+    bool c = __builtin_add_overflow(static_cast<U>(ra), static_cast<U>(rb), &r);
+    bool o = __builtin_add_overflow(static_cast<S>(ra), static_cast<S>(rb), &s);
+    f.v = (c ? X86_EFLAGS_CF : 0) | (o ? X86_EFLAGS_OF : 0) | x86_zs_flags(r);
+    return static_cast<T>(r);
+}
+
+template<typename T>
+inline T x86_sub(T ra, T rb, x86_flags& f){
+    typedef typename std::make_unsigned<T>::type U;
+    typedef typename std::make_signed<T>::type   S;
+    U r; S s;
+    bool c = __builtin_sub_overflow(static_cast<U>(ra), static_cast<U>(rb), &r);     // borrow
+    bool o = __builtin_sub_overflow(static_cast<S>(ra), static_cast<S>(rb), &s);
+    f.v = (c ? X86_EFLAGS_CF : 0) | (o ? X86_EFLAGS_OF : 0) | x86_zs_flags(r);
+    return static_cast<T>(r);
+}
+
+// neg sets flags same as 0 - ra ( x86_sub is qualified, since ADL on x86_flags finds selected backend's one too )
+template<typename T>
+inline T x86_neg(T ra, x86_flags& f){ return x86_alu_builtin::x86_sub<T>(T(0), ra, f); }
+
+// logical ops clear CF & OF
+template<typename T>
+inline T x86_and(T ra, T rb, x86_flags& f){ T r = ra & rb; f.v = x86_zs_flags(r); return r; }
+template<typename T>
+inline T x86_or(T ra, T rb, x86_flags& f) { T r = ra | rb; f.v = x86_zs_flags(r); return r; }
+template<typename T>
+inline T x86_xor(T ra, T rb, x86_flags& f){ T r = ra ^ rb; f.v = x86_zs_flags(r); return r; }
+
+// mul/imul : CF = OF = product doesn't fit in T. Returns low or high half of product.
+template<typename T>
+inline T x86_mul_common(T ra, T rb, x86_flags& f, bool high){
+    typedef typename x86_wide<T>::type W;
+    W    p = static_cast<W>(ra) * static_cast<W>(rb);
+    T    l;
+    bool o = __builtin_mul_overflow(ra, rb, &l);
+    T    r = (high) ? static_cast<T>(p >> (sizeof(T)*8)) : l;
+    f.v = (o ? (X86_EFLAGS_CF | X86_EFLAGS_OF) : 0) | x86_zs_flags(r);
+    return r;
+}
+template<typename T>
+inline T x86_mul(T ra, T rb, x86_flags& f, bool high=0){
+    typedef typename std::make_unsigned<T>::type U;
+    return static_cast<T>(x86_mul_common<U>(static_cast<U>(ra), static_cast<U>(rb), f, high));
+}
+template<typename T>
+inline T x86_imul(T ra, T rb, x86_flags& f, bool high=0){
+    typedef typename std::make_signed<T>::type S;
+    return static_cast<T>(x86_mul_common<S>(static_cast<S>(ra), static_cast<S>(rb), f, high));
+}
+
+// Full product
+template<typename D, typename S>
+inline D x86_mulf(S ra, S rb, x86_flags& f){
+    typedef typename std::make_unsigned<S>::type U;
+    x86_mul_common<U>(static_cast<U>(ra), static_cast<U>(rb), f, 0);
+    return static_cast<D>(static_cast<typename x86_wide<U>::type>(static_cast<U>(ra)) * static_cast<U>(rb));
+}
+template<typename D, typename S>
+inline D x86_imulf(S ra, S rb, x86_flags& f){
+    typedef typename std::make_signed<S>::type SS;
+    x86_mul_common<SS>(static_cast<SS>(ra), static_cast<SS>(rb), f, 0);
+    return static_cast<D>(static_cast<typename x86_wide<SS>::type>(static_cast<SS>(ra)) * static_cast<SS>(rb));
+}
+
+// div/idiv. Quotient or remainder. Unlike the host instr, min/-1 doesn't trap ( quotient wraps to min, rem is 0 ).
+template<typename T>
+inline T x86_div(T ra, T rb, bool rem=0){
+    typedef typename std::make_unsigned<T>::type U;
+    return static_cast<T>((rem) ? static_cast<U>(ra) % static_cast<U>(rb) : static_cast<U>(ra) / static_cast<U>(rb));
+}
+template<typename T>
+inline T x86_idiv(T ra, T rb, bool rem=0){
+    typedef typename std::make_signed<T>::type S;
+    if unlikely(static_cast<S>(rb) == S(-1)){
+        return (rem) ? T(0) : static_cast<T>(-static_cast<typename std::make_unsigned<T>::type>(ra));
+    }
+    return static_cast<T>((rem) ? static_cast<S>(ra) % static_cast<S>(rb) : static_cast<S>(ra) / static_cast<S>(rb));
+}
+}
+
+#ifdef CONFIG_ALU_BUILTIN
+namespace x86_alu = x86_alu_builtin;
+#else
+namespace x86_alu = x86_alu_asm;
+#endif
+
+using x86_alu::x86_neg;
+using x86_alu::x86_add;
+using x86_alu::x86_sub;
+using x86_alu::x86_and;
+using x86_alu::x86_or;
+using x86_alu::x86_xor;
+using x86_alu::x86_mul;
+using x86_alu::x86_imul;
+using x86_alu::x86_mulf;
+using x86_alu::x86_imulf;
+using x86_alu::x86_div;
+using x86_alu::x86_idiv;
 
 // vector extensions (SSE)
 // forward declarations